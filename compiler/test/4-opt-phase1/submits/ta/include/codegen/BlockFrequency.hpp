@@ -0,0 +1,21 @@
+#pragma once
+
+#include <unordered_map>
+
+#include "MachineIR.hpp"
+
+/**
+ * 机器基本块执行频率的静态估计：循环每嵌套一层乘 10
+ *
+ * 循环深度取自 lightir 上的 LoopDetection；拆分边等没有对应 lightir 基本块的机器基本块取前驱的深度
+ */
+class BlockFrequency {
+  public:
+    explicit BlockFrequency(MachineFunction* func);
+
+    unsigned get_loop_depth(MachineBasicBlock* bb) const;
+    double get_frequency(MachineBasicBlock* bb) const;
+
+  private:
+    std::unordered_map<MachineBasicBlock*, unsigned> depth_;
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <list>
+
+#include "MachineIR.hpp"
+
+/**
+ * 基本块布局：让可能执行的后继尽量落入，减少跳转
+ *
+ * 按 Pettis-Hansen 的链式方法：边权为源块的估计执行频率（BlockFrequency）按后继的频率分配，
+ * 从大到小合并首尾相接的链；入口链放在最前，其余链依次选择与已放置的块连接最紧密的。
+ * 布局确定后删除跳到下一个块的 b，条件跳转的目标是下一个块时取反条件，改为跳到另一个后继。
+ * 出口块保持在最后。
+ *
+ * 统计布局前后的 b 的条数，以及按块频率静态估计的跳转次数（每个块的频率按后继的频率分配给各条出边）。
+ */
+class BlockPlacement {
+  public:
+    explicit BlockPlacement(std::list<MachineFunction*>& funcs) : funcs_(funcs) {}
+
+    void run();
+
+  private:
+    std::list<MachineFunction*>& funcs_;
+
+    int branches_before_{0};
+    int branches_after_{0};
+    int inverted_branches_{0};
+    double taken_before_{0};
+    double taken_after_{0};
+
+    void run_on_function(MachineFunction* func);
+    // 落入下一个块的地方补上 b，使布局可以任意调整
+    void make_branches_explicit(MachineFunction* func);
+    // 按新布局删除多余的 b，必要时取反条件跳转
+    void remove_fallthrough_branches(MachineFunction* func);
+};
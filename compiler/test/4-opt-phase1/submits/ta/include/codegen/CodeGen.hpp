@@ -1,37 +1,65 @@
 #pragma once
 
-#include "ASMInstruction.hpp"
+#include "MachineIR.hpp"
 #include "Module.hpp"
 #include "Register.hpp"
+#include <map>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
+// 后端优化选项
+struct CodeGenOptions {
+    bool peephole{false};        // 机器 IR 上的窥孔优化
+    bool stack_coloring{false};  // 生命期不重叠的栈上值共用栈槽
+    bool block_placement{false}; // 调整基本块布局，让可能的后继落入
+    bool schedule{false};        // 基本块内的表调度，栈帧布局前后各一次
+    bool const_hoist{false};     // 常量提升到序言、浮点常量池、块内缓存全局变量地址
+};
+
+/**
+ * 指令选择把 lightir 翻译为机器 IR（MachineIR.hpp），栈上的值用栈帧对象表示；
+ * 随后确定栈帧布局，插入序言和尾声，把栈帧对象替换为 $sp 加偏移，最后由 print() 输出汇编
+ */
 class CodeGen {
   public:
-    explicit CodeGen(Module *module) : m(module) {}
+    explicit CodeGen(Module *module, CodeGenOptions options = {})
+        : m(module), options(options) {}
+    ~CodeGen();
+    CodeGen(const CodeGen &other) = delete;
+    CodeGen &operator=(const CodeGen &other) = delete;
 
     std::string print() const;
 
     void run();
 
-    template <class... Args> void append_inst(Args... arg) {
-        output.emplace_back(arg...);
-    }
+    // 在当前插入点之前插入指令
+    MachineInstr *append_inst(MachineInstr::Opcode op,
+                              std::vector<MachineOperand> operands);
+    void append_comment(const std::string &text);
 
-    void
-    append_inst(const char *inst, std::initializer_list<std::string> args,
-                ASMInstruction::InstType ty = ASMInstruction::Instruction) {
-        auto content = std::string(inst) + " ";
-        for (const auto &arg : args) {
-            content += arg + ", ";
-        }
-        content.pop_back();
-        content.pop_back();
-        output.emplace_back(content, ty);
-    }
+    // 在 bb 末尾生成除以常量 d 的指令序列，供 tests/4-opt/div_magic_test 直接检查
+    bool gen_div_by_const(MachineBasicBlock *bb, int32_t d);
 
   private:
+    // 为参数和指令结果创建栈帧对象
     void allocate();
-    void copy_stmt(); // for phi copy
+    // 插入点设为 bb 中的 pos 之前，默认为末尾
+    void set_insert_point(MachineBasicBlock *bb);
+    void set_insert_point(MachineBasicBlock *bb,
+                          std::list<MachineInstr *>::iterator pos);
+    // 常量提升：按循环深度加权统计函数中大常量、浮点常量和全局变量地址的使用，
+    // 收益足够的放入被调用者保存的 $s0-$s8/$fs0-$fs7，在序言中装入一次
+    void hoist_constants();
+    // 浮点常量在常量池中的偏移，超出 12 位立即数时返回 -1
+    int get_float_pool_offset(float val);
+    // 栈帧布局，序言、尾声和栈帧对象的消除
+    void lower_frame();
+    void eliminate_frame_index(MachineInstr *instr);
+    // for phi copy：按并行复制的语义生成当前基本块到 succ 的边上的复制
+    void copy_stmt(BasicBlock* succ);
+    // 当前基本块到 succ 的边上是否需要复制
+    bool has_phi_copy(BasicBlock* succ) const;
 
     // 向寄存器中装载数据
     void load_to_greg(Value *, const Reg &);
@@ -47,21 +75,38 @@ class CodeGen {
     void store_from_greg(Value *, const Reg &);
     void store_from_freg(Value *, const FReg &);
 
+    // 累加当前基本块对 flags[idx] 的增量，由 gen_lab4_flags() 一次写回
+    void gen_add_lab4_flag(int idx, int val);
+    // 在插入点直接更新运行时的 flags 数组，不调用 add_lab4_flag；
+    // force 时即使增量为 0 也更新 flags[0]
+    void gen_lab4_flags(bool force = false);
+
+    // 序言中保存参数等，设置栈帧的指令在 lower_frame() 中插入
     void gen_prologue();
     void gen_ret();
     void gen_br();
+    // 条件为真时跳转到 target
+    void gen_cond_branch(BranchInst* br, MachineBasicBlock* target);
+    // 条件跳转可以直接使用的比较（可能经过 zext 和与 0 的比较），negate 表示条件取反
+    Instruction* find_fused_cmp(BranchInst* br, bool& negate) const;
     void gen_binary();
+    // 被除数在 $t0 中，商存入 $t2，返回是否用了乘法（按乘法计代价）
+    bool gen_div_by_const(int32_t d);
     void gen_float_binary();
     void gen_alloca();
     void gen_load();
     void gen_store();
     void gen_icmp();
     void gen_fcmp();
+    // 比较 $ft0 与 $ft1，结果存入 $fcc0
+    void gen_fcmp_flag(Instruction::OpID op);
     void gen_zext();
     void gen_call();
     void gen_gep();
     void gen_sitofp();
     void gen_fptosi();
+    void gen_select();
+    // 在插入点恢复栈帧并返回
     void gen_epilogue();
 
     struct {
@@ -69,20 +114,52 @@ class CodeGen {
         Function *func{nullptr};    // 当前函数
         BasicBlock *bb{nullptr};    // 当前基本块
         Instruction *inst{nullptr}; // 当前指令
+        MachineFunction *mfunc{nullptr}; // 当前机器函数
+        MachineBasicBlock *mbb{nullptr};  // 插入点所在的机器基本块
+        std::list<MachineInstr *>::iterator insert_pos{};
+        std::unordered_map<BasicBlock *, MachineBasicBlock *> mbb_map{};
         /* 在allocate()中设置 */
-        unsigned frame_size{0}; // 当前函数的栈帧大小
-        std::unordered_map<Value *, int> offset_map{}; // 指针相对 fp 的偏移
+        std::unordered_map<Value *, int> frame_index_map{}; // 值所在的栈帧对象
+        std::unordered_map<AllocaInst *, int> alloca_map{}; // alloca 分配的栈帧对象
+        std::unordered_set<Instruction *> fused_insts{}; // 与条件跳转融合、不单独生成的指令
+        int lab4_flags[2]{}; // 当前基本块累计的代价
+        /* 在hoist_constants()中设置 */
+        std::map<int32_t, Reg> hoisted_ints{};
+        std::map<uint32_t, FReg> hoisted_floats{}; // 以位模式为键
+        std::unordered_map<GlobalVariable *, Reg> hoisted_globals{};
+        /* 当前机器基本块中缓存在 $t3-$t7 的全局变量地址，切换基本块和调用后失效 */
+        std::unordered_map<GlobalVariable *, Reg> global_cache{};
+        std::unordered_set<GlobalVariable *> reused_globals{}; // 当前基本块中值得缓存地址的全局变量
+        unsigned next_cache_reg{0};
+        /* 在lower_frame()中设置 */
+        std::vector<std::pair<MachineOperand, int>> callee_saved{}; // 保存的寄存器及其栈帧对象
 
         void clear() {
             func = nullptr;
             bb = nullptr;
             inst = nullptr;
-            frame_size = 0;
-            offset_map.clear();
+            mfunc = nullptr;
+            mbb = nullptr;
+            insert_pos = {};
+            mbb_map.clear();
+            frame_index_map.clear();
+            alloca_map.clear();
+            fused_insts.clear();
+            lab4_flags[0] = lab4_flags[1] = 0;
+            hoisted_ints.clear();
+            hoisted_floats.clear();
+            hoisted_globals.clear();
+            global_cache.clear();
+            reused_globals.clear();
+            next_cache_reg = 0;
+            callee_saved.clear();
         }
 
     } context;
 
     Module *m;
-    std::list<ASMInstruction> output;
+    CodeGenOptions options;
+    std::list<MachineFunction *> mfuncs;
+    // 浮点常量池（位模式），输出到 .rodata
+    std::vector<uint32_t> float_pool;
 };
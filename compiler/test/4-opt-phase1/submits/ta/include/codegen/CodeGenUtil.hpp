@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <stdexcept>
 
 /* 关于位宽 */
@@ -16,50 +17,56 @@ inline unsigned ALIGN(unsigned x, unsigned alignment) {
 
 inline bool IS_IMM_12(int x) { return x <= IMM_12_MAX and x >= IMM_12_MIN; }
 
-/* 栈帧相关 */
-#define PROLOGUE_OFFSET_BASE 16 // $ra $fp
-#define PROLOGUE_ALIGN 16
-
-/* 龙芯指令 */
-// Arithmetic
-#define ADD "add"
-#define SUB "sub"
-#define MUL "mul"
-#define DIV "div"
-
-#define ADDI "addi"
-
-#define FADD "fadd"
-#define FSUB "fsub"
-#define FMUL "fmul"
-#define FDIV "fdiv"
-
-#define ORI "ori"
-
-#define LU12I_W "lu12i.w"
-#define LU32I_D "lu32i.d"
-#define LU52I_D "lu52i.d"
-
-// Data transfer (greg <-> freg)
-#define GR2FR "movgr2fr"
-#define FR2GR "movfr2gr"
-
-// Memory access
-#define LOAD "ld"
-#define STORE "st"
-#define FLOAD "fld"
-#define FSTORE "fst"
+/* 有符号除以常量 */
+// d 为 2 的幂（或其相反数）时返回指数，否则返回 -1
+inline int DIV_LOG2(int32_t d) {
+    uint32_t ad = d < 0 ? 0u - static_cast<uint32_t>(d) : static_cast<uint32_t>(d);
+    if (ad < 2 or (ad & (ad - 1)) != 0 or ad == 0x80000000u) return -1;
+    int k = 0;
+    while ((1u << k) != ad) k++;
+    return k;
+}
 
-#define BYTE ".b"
-#define HALF_WORD ".h"
-#define WORD ".w"
-#define DOUBLE ".d"
+// n / d = (mulh(n, multiplier) [+ n 或 - n]) >> shift，再加上结果的符号位
+struct DivMagic {
+    int32_t multiplier;
+    int shift;
+};
 
-#define SINGLE ".s" // float
-#define LONG ".l"
+// |d| >= 2 且不是 2 的幂时的魔数，见 Granlund & Montgomery 与 Hacker's Delight 10-4
+inline DivMagic DIV_MAGIC(int32_t d) {
+    const uint32_t two31 = 0x80000000u;
+    uint32_t ad = d < 0 ? 0u - static_cast<uint32_t>(d) : static_cast<uint32_t>(d);
+    uint32_t t = two31 + (static_cast<uint32_t>(d) >> 31);
+    uint32_t anc = t - 1 - t % ad;
+    int p = 31;
+    uint32_t q1 = two31 / anc, r1 = two31 - q1 * anc;
+    uint32_t q2 = two31 / ad, r2 = two31 - q2 * ad;
+    uint32_t delta;
+    do {
+        p++;
+        q1 *= 2;
+        r1 *= 2;
+        if (r1 >= anc) {
+            q1++;
+            r1 -= anc;
+        }
+        q2 *= 2;
+        r2 *= 2;
+        if (r2 >= ad) {
+            q2++;
+            r2 -= ad;
+        }
+        delta = ad - r2;
+    } while (q1 < delta or (q1 == delta and r1 == 0));
+    auto multiplier = static_cast<int32_t>(q2 + 1);
+    if (d < 0) multiplier = static_cast<int32_t>(0u - static_cast<uint32_t>(multiplier));
+    return {multiplier, p - 32};
+}
 
-// ASM syntax sugar
-#define LOAD_ADDR "la.local"
+/* 栈帧相关 */
+#define PROLOGUE_OFFSET_BASE 8 // $ra
+#define PROLOGUE_ALIGN 16
 
 // errors
 class not_implemented_error : public std::logic_error {
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <climits>
+
+#include "BasicBlock.hpp"
+#include "CodeGenUtil.hpp"
+#include "Constant.hpp"
+#include "Function.hpp"
+#include "Instruction.hpp"
+#include "Module.hpp"
+
+/* io 运行时 flags 的统计规则，各个后端与解释器共用 */
+
+// 每执行一次 inst 计入 flags[1] 的代价：乘法 1，除法 4，除以常量时只有用到乘法的计 1，
+// 数组和指针的 load 计 3，getelementptr 计 1
+inline int get_execute_cost(Instruction *inst) {
+    switch (inst->get_instr_type()) {
+    case Instruction::mul:
+    case Instruction::fmul:
+    case Instruction::getelementptr:
+        return 1;
+    case Instruction::fdiv:
+        return 4;
+    case Instruction::sdiv: {
+        auto *divisor = dynamic_cast<ConstantInt *>(inst->get_operand(1));
+        if (divisor == nullptr or divisor->get_value() == 0 or divisor->get_value() == INT32_MIN) return 4;
+        auto d = divisor->get_value();
+        return d == 1 or d == -1 or DIV_LOG2(d) > 0 ? 0 : 1;
+    }
+    case Instruction::load: {
+        auto *ptr = inst->get_operand(0);
+        if (ptr->is<AllocaInst>() && !((ptr->as<AllocaInst>())->get_alloca_type()->is_array_type())) return 0;
+        return 3;
+    }
+    default:
+        return 0;
+    }
+}
+
+// main 开始执行时计入 flags[0] 的字节数：所有函数中 alloca 的大小之和
+inline int get_allocate_size(Module *m) {
+    int allocate_size = 0;
+    for (auto func : m->get_functions()) {
+        if (func->is_declaration()) continue;
+        for (auto &bb : func->get_basic_blocks()) {
+            for (auto &instr : bb->get_instructions()) {
+                if (instr->is_alloca()) {
+                    auto *alloca_inst = dynamic_cast<AllocaInst *>(instr);
+                    allocate_size += static_cast<int>(alloca_inst->get_alloca_type()->get_size());
+                }
+            }
+        }
+    }
+    return allocate_size;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <list>
+#include <unordered_set>
+#include <utility>
+
+#include "MachineIR.hpp"
+
+/**
+ * 基本块内的表调度
+ *
+ * 调用和跳转把基本块分成若干区域，区域内按依赖图调度：寄存器的写后读、读后写、写后写，
+ * 以及访存之间的依赖。访问不同栈帧对象（或 $sp 的不重叠偏移）的访存互不相关；
+ * 地址没有被取出的栈帧对象也不会被经指针的访存访问，其余访存保持原来的顺序。
+ * 布局前引用栈帧对象的指令视为改写 $t8（见 MachineInstr::has_frame_index），不会移到 $t8 的写和读之间。
+ * 每次在已就绪的指令中选取到区域末尾的关键路径最长的一条。
+ *
+ * 指令延迟按 LA464 估计，见 InstrScheduler.cpp 中的延迟表。
+ * 在栈帧布局前后各运行一次，布局后调度序言、尾声和大偏移的地址计算。
+ */
+class InstrScheduler {
+  public:
+    explicit InstrScheduler(std::list<MachineFunction*>& funcs) : funcs_(funcs) {}
+
+    void run();
+    // 调度一个基本块，返回调度前后流水线模型估计的周期数
+    std::pair<unsigned, unsigned> schedule_block(MachineBasicBlock* bb);
+
+    static unsigned get_latency(MachineInstr::Opcode op);
+    // 单发射顺序流水线模型：每周期发射一条指令，源寄存器的值没有算出时停顿
+    static unsigned estimate_cycles(const std::list<MachineInstr*>& instrs);
+
+  private:
+    std::list<MachineFunction*>& funcs_;
+    // 当前函数中地址被取出的栈帧对象
+    std::unordered_set<int> address_taken_;
+
+    // 对 [begin, end) 中的指令做表调度，结果追加到 out
+    void schedule_region(std::list<MachineInstr*>::iterator begin, std::list<MachineInstr*>::iterator end,
+                         std::list<MachineInstr*>& out);
+};
@@ -0,0 +1,150 @@
+#pragma once
+
+#include "Module.hpp"
+#include <cstdint>
+#include <sys/time.h>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * lightir 解释器：把 Module 展开为基于寄存器的字节码后直接执行，不依赖交叉工具链和模拟器。
+ *
+ * 每个函数的参数、指令结果和用到的常量都在栈帧中占一个槽位，字节码的操作数是预先解析好的槽位下标，
+ * phi 翻译为控制流边上的并行复制。分派使用 GNU C 的 computed goto，处理例程的地址在第一次执行时填入字节码。
+ * input、output、outputFloat 和 add_lab4_flag 由解释器直接实现，
+ * 代价统计的规则与后端一致，在每个基本块开头按整块累计。
+ */
+class Interpreter {
+  public:
+    explicit Interpreter(Module *module);
+    ~Interpreter();
+
+    Interpreter(const Interpreter &other) = delete;
+    Interpreter &operator=(const Interpreter &other) = delete;
+
+    // 执行 main，返回 main 的返回值；stderr 上按 io 运行时的格式输出统计信息
+    int run();
+
+    // 与 io 运行时的 flags[0]、flags[1] 对应，在 run() 之后读取
+    int get_allocate_size() const { return flags[0]; }
+    int get_execute_cost() const { return flags[1]; }
+
+  private:
+    enum Opcode : uint8_t {
+        ADD,
+        SUB,
+        MUL,
+        SDIV,
+        FADD,
+        FSUB,
+        FMUL,
+        FDIV,
+        ALLOCA,
+        LOAD_B,
+        LOAD_W,
+        LOAD_D,
+        STORE_B,
+        STORE_W,
+        STORE_D,
+        ICMP_GE,
+        ICMP_GT,
+        ICMP_LE,
+        ICMP_LT,
+        ICMP_EQ,
+        ICMP_NE,
+        FCMP_GE,
+        FCMP_GT,
+        FCMP_LE,
+        FCMP_LT,
+        FCMP_EQ,
+        FCMP_NE,
+        ZEXT,
+        FPTOSI,
+        SITOFP,
+        SELECT,
+        GEP_W,
+        GEP_D,
+        COST,
+        BR,
+        COND_BR,
+        RET,
+        RET_VOID,
+        CALL,
+        CALL_INPUT,
+        CALL_OUTPUT,
+        CALL_OUTPUT_FLOAT,
+        CALL_ADD_FLAG,
+    };
+
+    // 槽位中整数和 i1 按 32 位存放
+    union Slot {
+        int32_t i;
+        float f;
+        uint8_t *p;
+    };
+
+    struct Inst {
+        const void *handler; // 线索化后的处理例程
+        Opcode op;
+        uint32_t dst;
+        uint32_t a;
+        uint32_t b;
+        uint32_t c;
+    };
+
+    // 控制流边：跳转的目标和边上 phi 复制的区间
+    struct Edge {
+        uint32_t target;
+        uint32_t copy_begin;
+        uint32_t copy_end;
+    };
+
+    struct FunctionCode {
+        Function *func{nullptr};
+        std::vector<Inst> insts;
+        std::vector<Edge> edges;
+        std::vector<std::pair<uint32_t, uint32_t>> copies; // (phi 的槽位, 源槽位)
+        std::vector<uint32_t> call_args;
+        // 槽位依次为参数、指令结果和常量，常量部分在进入函数时从 consts 复制
+        uint32_t num_values{0};
+        std::vector<Slot> consts;
+        unsigned alloca_size{0};
+        bool threaded{false};
+
+        uint32_t num_slots() const { return num_values + static_cast<uint32_t>(consts.size()); }
+    };
+
+    // 被调用者返回后恢复的调用者状态
+    struct CallFrame {
+        FunctionCode *code;
+        const Inst *pc; // call 指令
+        Slot *frame;
+        uint8_t *mem;
+    };
+
+    void compile(FunctionCode &code);
+    // 执行 entry 直到它返回；函数调用不占用宿主的栈，调用链保存在 call_stack 中
+    Slot execute(FunctionCode *entry);
+
+    Module *m;
+    std::unordered_map<Function *, FunctionCode> codes;
+    std::vector<FunctionCode *> callees;
+    // 全局变量在 global_mem 中的偏移
+    std::unordered_map<GlobalVariable *, unsigned> globals;
+    uint8_t *global_mem{nullptr};
+
+    // 解释器的两个栈：值的槽位和 alloca 分配的内存
+    Slot *slot_stack{nullptr};
+    Slot *slot_top{nullptr};
+    Slot *slot_limit{nullptr};
+    uint8_t *mem_stack{nullptr};
+    uint8_t *mem_top{nullptr};
+    uint8_t *mem_limit{nullptr};
+    std::vector<Slot> phi_temp;
+    std::vector<CallFrame> call_stack;
+
+    int flags[2]{0, 0};
+    struct timeval time_start {};
+    struct timeval time_end {};
+    bool end_set{false};
+};
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <vector>
+
+#include "Register.hpp"
+
+class BasicBlock;
+class Function;
+class MachineBasicBlock;
+class MachineFunction;
+
+/**
+ * 机器指令的操作数：通用/浮点/条件标志寄存器、立即数、基本块标签、符号（全局变量或函数名）和栈帧对象
+ *
+ * 栈帧对象在栈帧布局确定之前代替基址，布局之后由 CodeGen 替换为 $sp 加偏移
+ */
+class MachineOperand {
+  public:
+    enum Kind : uint8_t { greg, freg, cfreg, imm, block, symbol, frame_index };
+
+    MachineOperand(const Reg& reg) : kind_(greg), id_(reg.id) {}
+    MachineOperand(const FReg& reg) : kind_(freg), id_(reg.id) {}
+    MachineOperand(const CFReg& reg) : kind_(cfreg), id_(reg.id) {}
+    MachineOperand(MachineBasicBlock* bb) : kind_(block), block_(bb) {}
+    static MachineOperand create_imm(int64_t val);
+    static MachineOperand create_symbol(const std::string& name);
+    static MachineOperand create_frame_index(int index);
+
+    Kind get_kind() const { return kind_; }
+    bool is_greg() const { return kind_ == greg; }
+    bool is_freg() const { return kind_ == freg; }
+    bool is_cfreg() const { return kind_ == cfreg; }
+    bool is_imm() const { return kind_ == imm; }
+    bool is_block() const { return kind_ == block; }
+    bool is_symbol() const { return kind_ == symbol; }
+    bool is_frame_index() const { return kind_ == frame_index; }
+
+    Reg get_reg() const { return Reg(id_); }
+    FReg get_freg() const { return FReg(id_); }
+    CFReg get_cfreg() const { return CFReg(id_); }
+    int64_t get_imm() const { return imm_; }
+    void set_imm(int64_t val) { imm_ = val; }
+    MachineBasicBlock* get_block() const { return block_; }
+    void set_block(MachineBasicBlock* bb) { block_ = bb; }
+    const std::string& get_symbol() const { return symbol_; }
+    int get_frame_index() const { return static_cast<int>(id_); }
+    // 寄存器的统一编号：通用寄存器 0-31，浮点寄存器 32-63，条件标志寄存器 64-71
+    static constexpr unsigned NUM_REG_UNITS = 72;
+    unsigned get_reg_unit() const;
+
+    // 同一个寄存器、立即数、标签、符号或栈帧对象
+    bool operator==(const MachineOperand& other) const;
+    bool operator!=(const MachineOperand& other) const { return !(*this == other); }
+
+    std::string print() const;
+
+  private:
+    MachineOperand(Kind kind) : kind_(kind) {}
+
+    Kind kind_;
+    unsigned id_{0};
+    int64_t imm_{0};
+    MachineBasicBlock* block_{nullptr};
+    std::string symbol_;
+};
+
+/**
+ * 龙芯机器指令
+ *
+ * 操作数按汇编中的顺序排列。除了访存和跳转指令，第一个操作数是唯一的目的寄存器；
+ * 访存指令为 (数据寄存器, 基址, 偏移)，基址可以是栈帧对象。
+ * COMMENT 是伪指令，只在输出中留下注释（对应的 lightir 指令）。
+ */
+class MachineInstr {
+  public:
+    enum Opcode : uint8_t {
+        COMMENT,
+        // 整数运算
+        ADD_W, ADD_D, SUB_W, SUB_D, MUL_W, MUL_D, MULH_W, DIV_W,
+        ADDI_W, ADDI_D, SLT, SLTU, SLTI, AND, OR, XOR, ANDI, ORI, XORI,
+        SLLI_W, SRLI_W, SRAI_W, SLLI_D, LU12I_W, LU32I_D, LU52I_D,
+        BSTRPICK_W, MASKEQZ, MASKNEZ, LA_LOCAL,
+        // 访存
+        LD_B, LD_W, LD_D, ST_B, ST_W, ST_D, FLD_S, FST_S, FLD_D, FST_D,
+        // 浮点运算与转换
+        FADD_S, FSUB_S, FMUL_S, FDIV_S,
+        FCMP_SLT_S, FCMP_SLE_S, FCMP_SEQ_S, FCMP_SNE_S,
+        FMOV_S, MOVGR2FR_W, MOVFR2GR_S, MOVGR2CF, MOVCF2GR, FFINT_S_W, FTINTRZ_W_S, FSEL,
+        // 控制流
+        B, BL, JR, BEQZ, BNEZ, BEQ, BNE, BLT, BGE, BLTU, BGEU, BCEQZ, BCNEZ,
+    };
+
+    static MachineInstr* create(Opcode op, std::vector<MachineOperand> operands, MachineBasicBlock* bb = nullptr);
+    static MachineInstr* create_comment(const std::string& text, MachineBasicBlock* bb = nullptr);
+
+    Opcode get_opcode() const { return op_; }
+    void set_opcode(Opcode op) { op_ = op; }
+    std::vector<MachineOperand>& get_operands() { return operands_; }
+    const std::vector<MachineOperand>& get_operands() const { return operands_; }
+    MachineOperand& get_operand(unsigned i) { return operands_.at(i); }
+    const MachineOperand& get_operand(unsigned i) const { return operands_.at(i); }
+    unsigned get_num_operand() const { return static_cast<unsigned>(operands_.size()); }
+    MachineBasicBlock* get_parent() const { return parent_; }
+    void set_parent(MachineBasicBlock* bb) { parent_ = bb; }
+
+    bool is_comment() const { return op_ == COMMENT; }
+    bool is_load() const;
+    bool is_store() const;
+    bool is_call() const { return op_ == BL; }
+    // 条件跳转（最后一个操作数是目标基本块）
+    bool is_cond_branch() const;
+    // 无条件跳转 b 和返回 jr
+    bool is_unconditional_branch() const { return op_ == B || op_ == JR; }
+    bool is_terminator() const { return is_cond_branch() || is_unconditional_branch(); }
+    // 是否写第一个操作数
+    bool has_def() const;
+    // 第 i 个操作数是否为读取的寄存器
+    bool is_use_operand(unsigned i) const;
+    // 栈帧布局前引用栈帧对象的访存或 addi.d；偏移超出 12 位时 lower_frame 借用 $t8 计算地址，相当于改写 $t8
+    bool has_frame_index() const { return operands_.size() == 3 and operands_[1].is_frame_index(); }
+    // 写入和读取的寄存器，包括调用与返回隐含的参数、返回值和调用者保存寄存器
+    std::vector<MachineOperand> get_defs() const;
+    std::vector<MachineOperand> get_uses() const;
+
+    static const char* get_name(Opcode op);
+    std::string print() const;
+
+  private:
+    MachineInstr(Opcode op, std::vector<MachineOperand> operands) : op_(op), operands_(std::move(operands)) {}
+
+    Opcode op_;
+    std::vector<MachineOperand> operands_;
+    std::string comment_;
+    MachineBasicBlock* parent_{nullptr};
+};
+
+/**
+ * 机器基本块。最后一条指令不是无条件跳转时落入布局中的下一个基本块。
+ * 由 lightir 基本块选择得到的机器基本块记录对应的 BasicBlock，拆分边、序言和出口块没有对应的 BasicBlock
+ */
+class MachineBasicBlock {
+  public:
+    ~MachineBasicBlock();
+    static MachineBasicBlock* create(const std::string& name, MachineFunction* parent, BasicBlock* bb = nullptr);
+
+    const std::string& get_name() const { return name_; }
+    MachineFunction* get_parent() const { return parent_; }
+    BasicBlock* get_basic_block() const { return bb_; }
+
+    std::list<MachineInstr*>& get_instructions() { return instr_list_; }
+    void add_instruction(MachineInstr* instr);
+    // 在 pos 之前插入
+    void insert_instr(std::list<MachineInstr*>::iterator pos, MachineInstr* instr);
+    // 移除并 delete 指令
+    void erase_instr(MachineInstr* instr);
+
+    const std::vector<MachineBasicBlock*>& get_succ_basic_blocks() const { return succ_bbs_; }
+    const std::vector<MachineBasicBlock*>& get_pre_basic_blocks() const { return pre_bbs_; }
+    // 同时设置 succ 的前驱，自动去重
+    void add_succ_basic_block(MachineBasicBlock* succ);
+    void remove_succ_basic_block(MachineBasicBlock* succ);
+
+    std::string print() const;
+
+  private:
+    MachineBasicBlock(std::string name, MachineFunction* parent, BasicBlock* bb)
+        : name_(std::move(name)), parent_(parent), bb_(bb) {}
+
+    std::string name_;
+    MachineFunction* parent_;
+    BasicBlock* bb_;
+    std::list<MachineInstr*> instr_list_;
+    std::vector<MachineBasicBlock*> succ_bbs_;
+    std::vector<MachineBasicBlock*> pre_bbs_;
+};
+
+/**
+ * 机器函数：按布局顺序排列的机器基本块和栈帧对象
+ *
+ * 第一个基本块以函数名为标签，包含序言；出口块包含尾声（尾声较短时复制到各个返回处，出口块随之删除）。
+ * 栈帧对象在布局前只有大小和对齐，offset_ 是布局后相对 $sp 的偏移。
+ */
+class MachineFunction {
+  public:
+    struct FrameObject {
+        unsigned size_;
+        unsigned align_;
+        int offset_;
+    };
+
+    explicit MachineFunction(Function* func) : func_(func) {}
+    ~MachineFunction();
+    MachineFunction(const MachineFunction& other) = delete;
+    MachineFunction& operator=(const MachineFunction& other) = delete;
+
+    Function* get_function() const { return func_; }
+    std::string get_name() const;
+
+    std::list<MachineBasicBlock*>& get_basic_blocks() { return basic_blocks_; }
+    void add_basic_block(MachineBasicBlock* bb) { basic_blocks_.push_back(bb); }
+    // 调整布局：把 bb 移到 pos 之后
+    // 从布局中移除并 delete 基本块，bb 不能再有前驱和后继
+    void erase_basic_block(MachineBasicBlock* bb);
+    void move_basic_block_after(MachineBasicBlock* bb, MachineBasicBlock* pos);
+    // 布局中 bb 的下一个基本块，没有时返回 nullptr
+    MachineBasicBlock* get_next_basic_block(MachineBasicBlock* bb) const;
+    // 尾声所在的出口块
+    MachineBasicBlock* get_exit_block() const { return exit_block_; }
+    void set_exit_block(MachineBasicBlock* bb) { exit_block_ = bb; }
+
+    int create_frame_object(unsigned size, unsigned align);
+    FrameObject& get_frame_object(int index) { return frame_objects_.at(index); }
+    std::vector<FrameObject>& get_frame_objects() { return frame_objects_; }
+    unsigned get_frame_size() const { return frame_size_; }
+    // 是否调用其它函数，不调用的叶函数不保存 $ra
+    bool has_call() const;
+    // 按编号顺序从 $sp 向上排列栈帧对象，编号小的离 $sp 近，最上方是保存的 $ra；返回栈帧大小
+    unsigned layout_frame();
+
+    std::string print() const;
+
+  private:
+    Function* func_;
+    std::list<MachineBasicBlock*> basic_blocks_;
+    MachineBasicBlock* exit_block_{nullptr};
+    std::vector<FrameObject> frame_objects_;
+    unsigned frame_size_{0};
+};
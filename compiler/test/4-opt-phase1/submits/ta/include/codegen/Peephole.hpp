@@ -0,0 +1,42 @@
+#pragma once
+
+#include <list>
+#include <unordered_set>
+
+#include "MachineIR.hpp"
+
+/**
+ * 机器 IR 上的窥孔优化，在栈帧布局之前运行，此时栈上的值仍以栈帧对象表示
+ *
+ * - 基本块内的存取转发：从栈帧对象读出的值若已在寄存器中，读改为寄存器复制，复制再传播到使用处
+ * - 死存储：块内被覆盖前没有读的存储，以及整个函数中从不读取的栈帧对象上的存储
+ * - 常量：重复装入同一常量的指令删除，常量操作数折叠为 addi.w/slli.w/andi 等立即数形式
+ * - 死指令：结果寄存器不再活跃的指令（折叠后多余的常量装入、复制等）
+ * - 跳转到布局中下一个基本块的 b 删除
+ *
+ * 地址被取出（addi.d rd, FI, imm）的栈帧对象是 alloca 的空间，可能经指针访问，不参与前两项
+ */
+class Peephole {
+  public:
+    explicit Peephole(std::list<MachineFunction*>& funcs) : funcs_(funcs) {}
+
+    void run();
+
+  private:
+    std::list<MachineFunction*>& funcs_;
+    // 当前函数中地址被取出的栈帧对象
+    std::unordered_set<int> address_taken_;
+
+    int forwarded_loads_{0};
+    int dead_stores_{0};
+    int redundant_consts_{0};
+    int folded_imms_{0};
+    int dead_instrs_{0};
+    int fallthrough_branches_{0};
+
+    void run_on_function(MachineFunction* func);
+    bool forward_in_block(MachineBasicBlock* bb);
+    bool remove_dead_stores(MachineFunction* func);
+    bool remove_dead_instrs(MachineFunction* func);
+    void remove_fallthrough_branches(MachineFunction* func);
+};
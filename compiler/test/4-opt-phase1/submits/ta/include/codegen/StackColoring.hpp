@@ -0,0 +1,27 @@
+#pragma once
+
+#include <list>
+#include <vector>
+
+#include "MachineIR.hpp"
+
+/**
+ * 栈槽着色：生命期不重叠的值共用栈帧对象
+ *
+ * 在机器 IR 上对栈帧对象做活跃分析（读为使用，整个对象的写为定值），写一个对象时仍活跃的对象与它冲突。
+ * 按访问次数（按循环深度加权）从高到低贪心地分配到不冲突的共享栈槽，先分配的栈槽离 $sp 最近，
+ * 使热的值尽量用 12 位立即数偏移访问。地址被取出的对象（alloca 的空间）不参与共享，放在最后。
+ */
+class StackColoring {
+  public:
+    explicit StackColoring(std::list<MachineFunction*>& funcs) : funcs_(funcs) {}
+
+    void run();
+
+  private:
+    std::list<MachineFunction*>& funcs_;
+
+    void run_on_function(MachineFunction* func);
+    // 各栈帧对象的访问次数，按所在基本块的估计执行频率加权
+    std::vector<double> compute_weights(MachineFunction* func);
+};
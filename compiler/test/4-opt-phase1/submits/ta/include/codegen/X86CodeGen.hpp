@@ -0,0 +1,114 @@
+#pragma once
+
+#include "ASMInstruction.hpp"
+#include "Module.hpp"
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * x86-64 后端：把 lightir 翻译为 AT&T 语法的汇编，遵循 System V ABI，可以用宿主的 gcc 与 io.c 链接后直接运行。
+ *
+ * 与 LoongArch 后端最初的做法相同，参数和指令结果都放在相对 %rbp 的栈槽中，
+ * 每条指令的模板只使用 %rax、%rcx、%rdx 和 %xmm0、%xmm1。
+ * 代价统计的规则与 CodeGen 一致，按基本块累计后在块开头直接更新 io 运行时的 flags。
+ */
+class X86CodeGen {
+  public:
+    explicit X86CodeGen(Module *module) : m(module) {}
+
+    std::string print() const;
+
+    void run();
+
+    void append_inst(const std::string &content,
+                     ASMInstruction::InstType ty = ASMInstruction::Instruction) {
+        output.emplace_back(content, ty);
+    }
+
+    // AT&T 语法，源操作数在前
+    void append_inst(const char *inst, std::initializer_list<std::string> args) {
+        auto content = std::string(inst) + " ";
+        for (const auto &arg : args) {
+            content += arg + ", ";
+        }
+        content.pop_back();
+        content.pop_back();
+        output.emplace_back(content);
+    }
+
+    // x86-64 通用寄存器在各个位宽下的名字
+    struct GReg {
+        const char *q;
+        const char *l;
+        const char *b;
+    };
+
+  private:
+    // 为参数、指令结果、alloca 和 phi 的暂存区分配栈槽
+    void allocate();
+    // for phi copy：按并行复制的语义生成当前基本块到 succ 的边上的复制
+    void copy_stmt(BasicBlock *succ);
+    bool has_phi_copy(BasicBlock *succ) const;
+
+    std::string slot(Value *val) const;
+    std::string label(BasicBlock *bb) const;
+    // 浮点常量在常量池中的地址
+    std::string float_const(float val);
+
+    // 向寄存器中装载数据，整数装入 32 位，指针装入 64 位
+    void load_to_greg(Value *, const GReg &);
+    void load_to_xmm(Value *, const std::string &);
+    // 将寄存器中的数据保存回栈上
+    void store_from_greg(Value *, const GReg &);
+    void store_from_xmm(Value *, const std::string &);
+
+    void gen_prologue();
+    void gen_ret();
+    void gen_br();
+    void gen_binary();
+    void gen_float_binary();
+    void gen_alloca();
+    void gen_load();
+    void gen_store();
+    void gen_icmp();
+    void gen_fcmp();
+    void gen_zext();
+    void gen_call();
+    void gen_gep();
+    void gen_sitofp();
+    void gen_fptosi();
+    void gen_select();
+
+    struct {
+        /* 随着ir遍历设置 */
+        Function *func{nullptr};    // 当前函数
+        BasicBlock *bb{nullptr};    // 当前基本块
+        Instruction *inst{nullptr}; // 当前指令
+        int cost{0};                // 当前基本块累计的代价
+        /* 在allocate()中设置 */
+        unsigned frame_size{0}; // 当前函数的栈帧大小
+        std::unordered_map<Value *, int> offset_map{}; // 值的栈槽相对 %rbp 的偏移
+        std::unordered_map<AllocaInst *, int> alloca_map{}; // alloca 分配的空间相对 %rbp 的偏移
+        int phi_temp_offset{0}; // phi 并行复制的暂存区
+
+        void clear() {
+            func = nullptr;
+            bb = nullptr;
+            inst = nullptr;
+            cost = 0;
+            frame_size = 0;
+            offset_map.clear();
+            alloca_map.clear();
+            phi_temp_offset = 0;
+        }
+
+    } context;
+
+    Module *m;
+    std::list<ASMInstruction> output;
+    // 浮点常量池（位模式），输出到 .rodata
+    std::vector<uint32_t> float_pool;
+    unsigned edge_count{0};
+};
@@ -47,7 +47,8 @@ class Instruction : public User {
         getelementptr,
         zext, // zero extend
         fptosi,
-        sitofp
+        sitofp,
+        select
         // float binary operators Logical operators
 
     };
@@ -103,6 +104,7 @@ class Instruction : public User {
     bool is_call() const { return op_id_ == call; }
     bool is_gep() const { return op_id_ == getelementptr; }
     bool is_zext() const { return op_id_ == zext; }
+    bool is_select() const { return op_id_ == select; }
 
     bool isBinary() const {
         return (is_add() || is_sub() || is_mul() || is_div() || is_fadd() ||
@@ -328,6 +330,23 @@ class SiToFpInst : public Instruction {
     std::string print() override;
 };
 
+class SelectInst : public Instruction {
+
+  private:
+    SelectInst(Value *cond, Value *if_true, Value *if_false, BasicBlock *bb, const std::string& name);
+
+  public:
+    // cond 为 i1，为真时取 if_true，否则取 if_false
+    static SelectInst *create_select(Value *cond, Value *if_true, Value *if_false,
+                                     BasicBlock *bb, const std::string& name = "");
+
+    Value *get_condition() const { return get_operand(0); }
+    Value *get_true_value() const { return get_operand(1); }
+    Value *get_false_value() const { return get_operand(2); }
+
+    std::string print() override;
+};
+
 class PhiInst : public Instruction {
 
   private:
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "FuncInfo.hpp"
+#include "PassManager.hpp"
+
+/**
+ * 基本别名分析
+ *
+ * 指针沿 getelementptr 追溯到底层对象（全局变量、alloca 或形参），并把下标分解为 常量偏移 + 变量下标 的形式。
+ * - 底层对象不同：全局变量、alloca 之间互不别名；形参不会指向本函数的 alloca；
+ *   形参指向的对象由所有调用点的实参求出，两个形参（或形参与全局变量）可能指向的对象不相交时互不别名
+ * - 底层对象相同且变量下标相同：按常量偏移和访问大小判断重叠，完全相同为 MustAlias
+ * - 其余情况为 MayAlias
+ *
+ * 函数调用的读写集合来自 FuncInfo，按底层对象判断。查询的两个指针应当在同一个函数中。
+ **/
+class AliasAnalysis : public ModuleAnalysisPass {
+  public:
+    enum AliasResult
+    {
+        NoAlias,
+        MayAlias,
+        MustAlias
+    };
+
+    /**
+     *
+     * @param m 所属 Module
+     * @param func_info 已经运行过的 FuncInfo，用于函数调用的读写集合
+     */
+    AliasAnalysis(Module *m, FuncInfo* func_info) : ModuleAnalysisPass(m), func_info_(func_info) {}
+
+    void run() override;
+
+    // 对 p1、p2 指向的标量的访问是否可能重叠
+    AliasResult alias(Value* p1, Value* p2) const;
+    // 与 alias 相同，但 p1、p2 可能取自循环的不同迭代：以指令为下标时两次迭代中的下标不一定相同
+    AliasResult alias_across_iterations(Value* p1, Value* p2) const;
+    // p1、p2 是否可能指向同一个对象（不考虑偏移）
+    bool may_alias_object(Value* p1, Value* p2) const;
+    // 函数调用是否可能修改 / 读取 ptr 所在的对象
+    bool may_mod(const CallInst* call, Value* ptr) const;
+    bool may_ref(const CallInst* call, Value* ptr) const;
+
+    // 沿 getelementptr 追溯指针的底层对象（全局变量、alloca 或形参），无法追溯时返回 nullptr
+    static Value* get_underlying_object(Value* ptr);
+
+  private:
+    // 指针分解为 底层对象 + 常量字节偏移 + sum(变量下标 * 字节倍数)
+    struct Decomposed
+    {
+        Value* base_;
+        long long offset_;
+        std::vector<std::pair<Value*, long long>> vars_;
+    };
+
+    FuncInfo* func_info_;
+    // 形参可能指向的全局变量 / alloca
+    std::unordered_map<Argument*, std::unordered_set<Value*>> arg_objects_;
+    // 可能指向未知对象的形参
+    std::unordered_set<Argument*> unknown_args_;
+
+    static Decomposed decompose(Value* ptr);
+    // 形参 arg 是否可能指向对象 obj（全局变量或其它函数的 alloca）
+    bool arg_may_point_to(Argument* arg, Value* obj) const;
+};
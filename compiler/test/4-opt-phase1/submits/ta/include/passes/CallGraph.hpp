@@ -0,0 +1,46 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "Instruction.hpp"
+#include "PassManager.hpp"
+
+/**
+ * 调用图
+ *
+ * 结点是 Module 中的全部函数（包括只有声明的库函数），边由调用指令给出。
+ * 用 Tarjan 算法求强连通分量，get_sccs 按自底向上的顺序（被调函数所在的分量在前）返回。
+ * 自底向上的过程间分析按此顺序处理时，非递归的分量只需处理一次，递归的分量在分量内部迭代到不动点。
+ */
+class CallGraph : public ModuleAnalysisPass {
+  public:
+    CallGraph(Module *m) : ModuleAnalysisPass(m) {}
+
+    void run() override;
+
+    // func 中的调用指令
+    const std::vector<CallInst*>& get_call_sites(Function* func) const { return call_sites_.at(func); }
+    // func 调用的函数（不重复）
+    const std::vector<Function*>& get_callees(Function* func) const { return callees_.at(func); }
+    // 强连通分量，被调函数所在的分量在前
+    const std::vector<std::vector<Function*>>& get_sccs() const { return sccs_; }
+    // func 所在强连通分量在 get_sccs() 中的下标
+    unsigned get_scc_index(Function* func) const { return scc_index_.at(func); }
+    // func 是否在调用环上（包括直接调用自身）
+    bool is_recursive(Function* func) const;
+
+  private:
+    std::unordered_map<Function*, std::vector<CallInst*>> call_sites_;
+    std::unordered_map<Function*, std::vector<Function*>> callees_;
+    std::vector<std::vector<Function*>> sccs_;
+    std::unordered_map<Function*, unsigned> scc_index_;
+
+    // Tarjan 算法的状态
+    std::unordered_map<Function*, unsigned> dfn_;
+    std::unordered_map<Function*, unsigned> low_;
+    std::vector<Function*> stack_;
+    std::unordered_map<Function*, bool> on_stack_;
+
+    void tarjan(Function* func);
+};
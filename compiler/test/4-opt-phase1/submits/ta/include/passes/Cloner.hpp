@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Function.hpp"
+#include "Instruction.hpp"
+
+/**
+ * 复制指令、基本块和函数的工具，供函数特化、内联、循环展开等变换使用
+ *
+ * value_map_ 记录 旧值 -> 新值 的映射，复制前可以预先放入需要替换的值（例如用实参替换形参）。
+ * 复制出的指令先使用原操作数，全部复制完成后再统一按 value_map_ 重映射，因此可以处理 phi 和回边。
+ */
+class Cloner {
+  public:
+    std::unordered_map<Value*, Value*> value_map_;
+    // 不为空时，复制出的 ret 改为跳转到 return_block_，返回值（已重映射，void 时为 nullptr）和所在基本块记录在 returns_ 中，供内联使用
+    BasicBlock* return_block_ = nullptr;
+    std::vector<std::pair<Value*, BasicBlock*>> returns_;
+
+    // 将 blocks 复制到 func 中，返回与 blocks 一一对应的新基本块
+    // 跳转到 blocks 之外的基本块保持原目标；新块中 phi 来自 blocks 之外的前驱也保持不变
+    std::vector<BasicBlock*> clone_blocks(const std::vector<BasicBlock*>& blocks, Function* func);
+    // 复制整个函数，新函数使用相同的函数类型
+    Function* clone_function(Function* func, const std::string& name);
+    // 将 func 的函数体复制到没有基本块的函数 into 中
+    // func 的形参需要预先在 value_map_ 中给出映射（没有映射的形参保持原值）；into 返回 void 时丢弃返回值
+    void clone_body(Function* func, Function* into);
+
+    // 按 value_map_ 查找值，不在映射中的值保持原样
+    Value* lookup(Value* val) const;
+
+  private:
+    // 在 bb 末尾创建 inst 的副本（操作数暂时与 inst 相同）
+    static Instruction* clone_instr(Instruction* inst, BasicBlock* bb);
+    // 将 inst 的操作数按 value_map_ 重映射
+    void remap(Instruction* inst) const;
+};
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "PassManager.hpp"
+
+/**
+ * 无用参数与无用返回值删除
+ *
+ * 对除 main 以外有函数体的函数（库函数 input/output/outputFloat 只有声明，不受影响）：
+ * 1. 形参没有被使用（或只被原样传给自身递归调用的同一位置）时，删除该形参以及所有调用点上对应的实参
+ * 2. 所有调用点都不使用返回值（或只把它作为自身的返回值）时，将返回类型改为 void
+ *
+ * 函数类型不可修改，因此按新的 FunctionType 创建同名函数，复制函数体后替换原函数。
+ * 删除实参可能使调用者的形参变得无用，因此迭代直到不再变化。
+ **/
+class DeadArgumentElimination : public TransformPass {
+  public:
+    DeadArgumentElimination(Module *m) : TransformPass(m) {}
+
+    void run() override;
+
+  private:
+    // 返回函数是否被改写
+    bool run_on_function(Function* func);
+};
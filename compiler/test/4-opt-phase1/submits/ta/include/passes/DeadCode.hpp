@@ -1,15 +1,22 @@
 #pragma once
 
 #include <deque>
+#include <unordered_set>
 
 #include "PassManager.hpp"
 
 class FuncInfo;
+class PostDominators;
 /**
  * 死代码消除：假设所有指令都可以去掉，然后只保留具有副作用的指令和它们所影响的指令。去掉不可达的基本块。
  *
  * 在初始化时指定一个 bool 参数 remove_unreachable_bb, 代表是否去除函数不可达基本块
  *
+ * 可选的 bool 参数 aggressive 开启激进的死代码删除(ADCE)：跳转指令不再默认有用，
+ * 只有当有用的指令控制依赖于它（或 phi 需要区分它的出边）时才保留；
+ * 无用的条件跳转改为跳向最近的有用后必经节点，之后不可达的基本块（例如结果无人使用的循环）被删除。
+ * 不能到达 ret 的基本块（死循环）的跳转总是有用。
+ *
  * 参见 https://www.clear.rice.edu/comp512/Lectures/10Dead-Clean-SCCP.pdf
  **/
 class DeadCode : public TransformPass {
@@ -19,14 +26,24 @@ class DeadCode : public TransformPass {
      * 
      * @param m 所属 Module
      * @param remove_unreachable_bb 是否需要删除不可达的 BasicBlocks
+     * @param aggressive 是否根据控制依赖删除无用的分支, 需要同时删除不可达的 BasicBlocks
      */
-    DeadCode(Module *m, bool remove_unreachable_bb) : TransformPass(m), remove_bb_(remove_unreachable_bb), func_info(nullptr) {}
+    DeadCode(Module *m, bool remove_unreachable_bb, bool aggressive = false)
+        : TransformPass(m), remove_bb_(remove_unreachable_bb || aggressive), aggressive_(aggressive), func_info(nullptr), post_dominators_(nullptr) {}
 
     void run() override;
 
+    // 从 entry 开始对基本块进行搜索，删除不可达基本块
+    static bool clear_basic_blocks(Function *func);
+
   private:
     bool remove_bb_;
+    bool aggressive_;
     FuncInfo* func_info;
+    // ADCE 使用的后必经树
+    PostDominators* post_dominators_;
+    // ADCE 中含有有用指令的基本块
+    std::unordered_set<BasicBlock*> live_blocks_{};
     std::unordered_map<Instruction *, bool> marked{};
     std::deque<Instruction*> work_list{};
 
@@ -36,10 +53,10 @@ class DeadCode : public TransformPass {
     void mark(const Instruction *ins);
     // 删除函数中无用指令
     bool sweep(Function *func);
-    // 从 entry 开始对基本块进行搜索，删除不可达基本块
-    static bool clear_basic_blocks(Function *func);
+    // ADCE：将无用的条件跳转改为跳向最近的有用后必经节点
+    bool redirect_dead_branches(Function *func);
+    // bb 最近的含有有用指令的严格后必经节点，没有时返回 nullptr
+    BasicBlock *live_post_dominator(BasicBlock *bb) const;
     // 指令是否有副作用
     bool is_critical(Instruction *ins) const;
-    // 删除无用函数和全局变量
-    void sweep_globally() const;
 };
@@ -1,27 +1,87 @@
 #pragma once
 
+#include <cstdint>
 #include <unordered_map>
-#include <unordered_set>
+#include <vector>
 
 #include "PassManager.hpp"
 
 /**
  * 分析函数的信息，包括哪些函数是纯函数，每个函数存储的变量
+ *
+ * 在调用图上按强连通分量自底向上计算：被调函数的摘要先算完，调用者在一遍中合并；
+ * 只有递归的分量需要在分量内部迭代。摘要用位集合记录，全局变量按 Module 中的顺序编号，参数按序号编号。
  */
 class FuncInfo : public ModuleAnalysisPass {
+    // 紧凑的位集合
+    class BitSet
+    {
+      public:
+        // 置位，返回该位原来是否为 0
+        bool set(unsigned i);
+        bool test(unsigned i) const;
+        // 并入 other，返回是否增加了新的位
+        bool unite(const BitSet& other);
+        bool empty() const;
+        // 不小于 i 的第一个置位的位置，没有时返回 size()
+        unsigned find_next(unsigned i) const;
+        unsigned size() const { return static_cast<unsigned>(words_.size()) * 64; }
+
+      private:
+        std::vector<uint64_t> words_;
+    };
     // 非纯函数的 load / store 信息
     struct UseMessage
     {
         // 影响的全局变量(注意此处不包含常全局变量，目前的文法也不支持常全局变量))
-        std::unordered_set<GlobalVariable*> globals_;
+        BitSet globals_;
         // 影响的参数(第一个参数序号为 0)
-        std::unordered_set<Argument*> arguments_;
+        BitSet arguments_;
 
-        void add(Value* val);
-        bool have(Value* val) const;
-        bool empty() const;
+        bool empty() const { return globals_.empty() && arguments_.empty(); }
     };
   public:
+    /**
+     * 一次函数调用间接 load/store 的变量
+     *
+     * 按调用点的实参解释被调函数的摘要，遍历时才计算每个变量，不复制集合。
+     * 不同参数可能指向同一个变量，因此遍历结果可能重复。视图在 FuncInfo 销毁或重新运行后失效。
+     */
+    class AccessView
+    {
+      public:
+        class iterator
+        {
+          public:
+            iterator(const AccessView* view, unsigned pos) : view_(view), pos_(pos) {}
+            Value* operator*() const;
+            iterator& operator++();
+            bool operator==(const iterator& other) const { return pos_ == other.pos_; }
+            bool operator!=(const iterator& other) const { return pos_ != other.pos_; }
+
+          private:
+            const AccessView* view_;
+            // 前 globals_.size() 位对应全局变量，之后对应参数
+            unsigned pos_;
+        };
+
+        AccessView(const FuncInfo* info, const UseMessage* msg, const CallInst* call)
+            : info_(info), msg_(msg), call_(call) {}
+        iterator begin() const;
+        iterator end() const;
+        bool empty() const { return msg_ == nullptr || msg_->empty(); }
+        // 调用是否访问变量 var（全局/局部变量或函数参数）
+        bool count(Value* var) const;
+
+      private:
+        const FuncInfo* info_;
+        // 库函数没有摘要，为 nullptr
+        const UseMessage* msg_;
+        const CallInst* call_;
+
+        unsigned next(unsigned pos) const;
+    };
+
     FuncInfo(Module *m) : ModuleAnalysisPass(m) {}
 
     void run() override;
@@ -35,9 +95,9 @@ class FuncInfo : public ModuleAnalysisPass {
     // 返回 LoadInst 加载的变量(全局/局部变量或函数参数)
     static Value* load_ptr(const LoadInst* ld);
     // 返回 CallInst 代表的函数调用间接存入的变量(全局/局部变量或函数参数)
-    std::unordered_set<Value*> get_stores(const CallInst* call);
+    AccessView get_stores(const CallInst* call) const;
     // 返回 CallInst 代表的函数调用间接加载的变量(全局/局部变量或函数参数)
-    std::unordered_set<Value*> get_loads(const CallInst* call);
+    AccessView get_loads(const CallInst* call) const;
   private:
     // 函数存储的值
     std::unordered_map<Function*, UseMessage> stores;
@@ -45,7 +105,15 @@ class FuncInfo : public ModuleAnalysisPass {
     std::unordered_map<Function*, UseMessage> loads;
     // 函数是否因为调用库函数而变得非纯函数
     std::unordered_map<Function*, bool> use_libs;
+    // 全局变量的编号
+    std::vector<GlobalVariable*> globals_;
+    std::unordered_map<GlobalVariable*, unsigned> global_index_;
 
+    // 在 msg 中记录变量 var（全局变量或参数），返回是否新增
+    bool add_use(UseMessage& msg, Value* var);
+    // 把 call 调用的函数的摘要按实参并入调用者，返回调用者的摘要是否变化
+    bool merge_callee(CallInst* call, const std::unordered_map<Value*, Value*>& val_2_var);
+    AccessView get_view(const std::unordered_map<Function*, UseMessage>& msgs, const CallInst* call) const;
     // 将所有由变量 var 计算出的指针的来源都设置为变量 var, 并记录在函数内直接对 var 的 load/store
     void cal_val_2_var(Value* var, std::unordered_map<Value*, Value*>& val_2_var);
     static Value* trace_ptr(Value* val);
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <unordered_set>
+
+#include "Instruction.hpp"
+#include "PassManager.hpp"
+
+/**
+ * 函数内联
+ *
+ * 把调用点替换为被调函数的函数体：在调用处拆分基本块，复制被调函数的基本块并用实参替换形参，
+ * ret 改为跳转到调用之后的部分，多个返回值用 phi 合并；被调函数中的 alloca 移到调用者的入口块。
+ *
+ * 只内联不在调用环上的函数，因此内联总会终止。被调函数指令数不超过 INLINE_SIZE，
+ * 或者只有一个调用点且不超过 INLINE_SINGLE_SITE_SIZE 时内联；调用者的指令数受 INLINE_CALLER_SIZE 限制。
+ * 内联后不再被调用的函数由 GlobalDeadCodeElimination 删除。
+ **/
+class FunctionInline : public TransformPass {
+  public:
+    FunctionInline(Module *m) : TransformPass(m) {}
+
+    void run() override;
+
+  private:
+    static constexpr int INLINE_SIZE = 30;
+    static constexpr int INLINE_SINGLE_SITE_SIZE = 300;
+    static constexpr int INLINE_CALLER_SIZE = 2000;
+
+    // 在调用环上的函数
+    std::unordered_set<Function*> recursive_;
+
+    void find_recursive();
+    bool should_inline(CallInst* call) const;
+    void inline_call(CallInst* call);
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "PassManager.hpp"
+
+/**
+ * 全局死代码删除
+ *
+ * 从 main 出发沿调用关系和对全局变量的引用标记可达的函数与全局变量，删除其余有函数体的函数和全局变量。
+ * 与只看使用列表不同，互相调用但从 main 不可达的函数也会被删除。库函数只有声明，保留不动。
+ *
+ * 删除函数后，剩下的函数可能只有一个调用点而可以内联，内联和删除无用参数后又可能产生新的不可达函数，
+ * 因此在启用内联/无用参数删除时反复迭代，直到不再删除任何东西。
+ * 结束时在日志中（设置 LOGV=1 时可见）报告删除的函数个数和全局变量的字节数。
+ **/
+class GlobalDeadCodeElimination : public TransformPass {
+  public:
+    /**
+     *
+     * @param m 所属 Module
+     * @param inline_funcs 每轮删除后是否重新内联
+     * @param dead_args 每轮删除后是否重新删除无用参数
+     */
+    GlobalDeadCodeElimination(Module *m, bool inline_funcs, bool dead_args)
+        : TransformPass(m), inline_funcs_(inline_funcs), dead_args_(dead_args) {}
+
+    void run() override;
+
+  private:
+    bool inline_funcs_;
+    bool dead_args_;
+    int removed_funcs_ = 0;
+    unsigned removed_bytes_ = 0;
+
+    // 删除一轮不可达的函数和全局变量，返回是否删除了东西
+    bool sweep();
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "Constant.hpp"
+#include "PassManager.hpp"
+
+/**
+ * 过程间稀疏条件常量传播（IPSCCP）
+ *
+ * 从 main 出发，在可执行的基本块和控制流边上求解格值，常量经过实参传给形参、经过 ret 传回调用点。
+ * 求解后把常量值替换到所有使用处，并把条件已知的分支改为无条件跳转（不可达块交给 DeadCode 删除）。
+ *
+ * 在初始化时指定一个 bool 参数 specialize，代表是否进行函数特化：
+ * 对以相同常量实参组合被多次调用的小函数复制一份特化版本，并把这些调用点改为调用它，
+ * 再次传播后特化版本内部可以折叠。复制的总规模受预算限制。
+ *
+ * 参见 https://www.clear.rice.edu/comp512/Lectures/10Dead-Clean-SCCP.pdf
+ **/
+class IPSCCP : public TransformPass {
+  public:
+    /**
+     *
+     * @param m 所属 Module
+     * @param specialize 是否对常量实参进行函数特化
+     */
+    IPSCCP(Module *m, bool specialize) : TransformPass(m), specialize_(specialize) {}
+
+    void run() override;
+
+  private:
+    // 格值：未定义（还没有确定的值）/ 常量 / 不确定
+    struct LatticeValue
+    {
+        enum Kind : std::uint8_t { UNDEF, CONST, OVERDEF };
+        Kind kind_ = UNDEF;
+        Constant* const_ = nullptr;
+
+        // 与 other 求交，返回格值是否改变
+        bool merge(const LatticeValue& other);
+    };
+
+    // 被特化的函数指令数上限
+    static constexpr int SPECIALIZE_FUNC_SIZE = 80;
+    // 特化复制的指令总数上限
+    static constexpr int SPECIALIZE_BUDGET = 400;
+    // 每个函数最多的特化版本数
+    static constexpr int SPECIALIZE_PER_FUNC = 4;
+
+    bool specialize_;
+
+    // 值（指令、形参）的格值，函数对应其返回值的格值
+    std::unordered_map<Value*, LatticeValue> values_;
+    std::unordered_set<BasicBlock*> executable_;
+    std::set<std::pair<BasicBlock*, BasicBlock*>> executable_edges_;
+    // 被调函数 -> 可执行的调用点
+    std::unordered_map<Function*, std::vector<CallInst*>> call_sites_;
+    std::deque<BasicBlock*> bb_work_list_;
+    std::deque<Value*> value_work_list_;
+
+    // 求解所有函数的格值
+    void solve();
+    // 按格值改写程序，返回是否改变
+    bool rewrite();
+    // 函数特化，返回是否产生了新的调用关系
+    bool specialize();
+
+    LatticeValue get_value(Value* val);
+    // 以 lv 更新 val 的格值，改变时加入工作表
+    void update(Value* val, const LatticeValue& lv);
+    void mark_executable(BasicBlock* bb);
+    void mark_edge(BasicBlock* from, BasicBlock* to);
+    void visit(Instruction* inst);
+    void visit_call(CallInst* call);
+    // 所有操作数均为常量时计算指令结果，无法折叠时返回 nullptr
+    Constant* fold(Instruction* inst, const std::vector<Constant*>& ops) const;
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "PassManager.hpp"
+
+/**
+ * 分支转换为 select（if-conversion）
+ *
+ * 把小的、没有副作用的分支结构展平到条件所在的基本块中，phi 改为 select：
+ * 1. 菱形：A 条件跳转到 T 和 F，T 和 F 都只有前驱 A、都无条件跳转到 M
+ * 2. 三角形：A 条件跳转到 T 和 M，T 只有前驱 A、无条件跳转到 M
+ * T、F 中的指令必须可以无条件执行（不访存、不调用、不做除法），且数量不超过 SPECULATE_LIMIT。
+ * 转换后如果 M 只剩下前驱 A，把 M 合并进 A，使外层的分支结构也能继续被转换。
+ *
+ * CodeGen 用 maskeqz/masknez/or（整数）和 fsel（浮点）实现 select，从而去掉跳转。
+ **/
+class IfConversion : public TransformPass {
+  public:
+    IfConversion(Module *m) : TransformPass(m) {}
+
+    void run() override;
+
+  private:
+    // 每个分支中允许推测执行的指令数上限
+    static constexpr int SPECULATE_LIMIT = 4;
+
+    // 尝试转换以 bb 的条件跳转开始的分支结构，返回是否改变
+    bool convert(BasicBlock* bb);
+    // bb 是否只有前驱 pred、无条件跳转到 succ，且其中的指令都可以推测执行
+    static bool is_speculatable_arm(BasicBlock* bb, BasicBlock* pred, BasicBlock* succ);
+    // 若 succ 是 bb 唯一的后继、bb 是 succ 唯一的前驱，把 succ 合并进 bb
+    static bool merge_into_pred(BasicBlock* bb);
+};
@@ -1,21 +1,37 @@
 #pragma once
 
+#include <functional>
+#include <vector>
+
+#include "AliasAnalysis.hpp"
 #include "FuncInfo.hpp"
 #include "LoopDetection.hpp"
+#include "MemorySSA.hpp"
 #include "PassManager.hpp"
 
 class LoopInvariantCodeMotion : public TransformPass {
   public:
-    LoopInvariantCodeMotion(Module *m) : TransformPass(m), loop_detection_(nullptr), func_info_(nullptr) {}
+    LoopInvariantCodeMotion(Module *m) : TransformPass(m), loop_detection_(nullptr), func_info_(nullptr), alias_analysis_(nullptr), memory_ssa_(nullptr) {}
     ~LoopInvariantCodeMotion() override = default;
 
     void run() override;
 
   private:
+    // 可以在循环内提升为标量的内存位置：循环不变的地址，以及循环内对它的全部 load/store
+    struct PromotionCandidate
+    {
+        Value* addr_;
+        std::vector<Instruction*> accesses_;
+    };
+
     LoopDetection* loop_detection_;
     FuncInfo* func_info_;
-    std::unordered_set<Value*> collect_loop_store_vars(Loop* loop);
+    AliasAnalysis* alias_analysis_;
+    MemorySSA* memory_ssa_;
     std::vector<Instruction*> collect_insts(Loop* loop);
     void traverse_loop(Loop* loop);
     void run_on_loop(Loop* loop);
+    BasicBlock* insert_preheader(Loop* loop);
+    std::vector<PromotionCandidate> collect_promotable_vars(Loop* loop, const std::function<bool(Value*)>& is_invariant);
+    void promote_scalar(Loop* loop, const PromotionCandidate& candidate);
 };
\ No newline at end of file
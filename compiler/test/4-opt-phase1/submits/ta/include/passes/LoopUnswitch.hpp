@@ -0,0 +1,34 @@
+#pragma once
+
+#include "LoopDetection.hpp"
+#include "PassManager.hpp"
+
+/**
+ * 循环判断外提（loop unswitching）
+ *
+ * 循环中以循环不变量为条件的分支每次迭代都要比较和跳转一次。
+ * 把整个循环（包括子循环）复制一份，原循环中该分支固定走真分支、副本中固定走假分支，
+ * 再在 preheader 中按条件选择进入哪一份，循环内就不再需要判断。
+ * 不可达的分支由随后的 DeadCode 删除。
+ *
+ * 要求循环有 preheader（由 LICM 插入）且只有一个出口块、出口块的前驱都在循环内，
+ * 这样循环中定义、循环外使用的值只需在出口块插入 phi 合并两份循环。
+ * 从外层循环开始尝试，每次变换后重新检测循环；复制的指令数受预算限制。
+ **/
+class LoopUnswitch : public TransformPass {
+  public:
+    LoopUnswitch(Module *m) : TransformPass(m) {}
+
+    void run() override;
+
+  private:
+    // 可以外提判断的循环的指令数上限
+    static constexpr int UNSWITCH_LOOP_SIZE = 100;
+    // 每个函数复制的指令总数上限
+    static constexpr int UNSWITCH_BUDGET = 300;
+
+    // 按先外层后内层的顺序尝试 loop 及其子循环，成功一次即返回 true
+    bool traverse_loop(Loop* loop, int& budget);
+    // 尝试对单个循环外提判断，成功时从 budget 中扣除复制的指令数
+    bool unswitch(Loop* loop, int& budget);
+};
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "AliasAnalysis.hpp"
+#include "Dominators.hpp"
+#include "FuncInfo.hpp"
+#include "PassManager.hpp"
+
+/**
+ * 内存访问在 MemorySSA 中的结点
+ *
+ * 整个内存视为一个变量：store 和会写内存的调用是 MemoryDef，load 和只读内存的调用是 MemoryUse，
+ * 汇合点上的 MemoryPhi 合并来自各前驱的 MemoryDef。LiveOnEntry 表示函数入口时的内存状态。
+ */
+class MemoryAccess {
+  public:
+    enum Kind
+    {
+        LiveOnEntry,
+        Def,
+        Use,
+        Phi
+    };
+
+    MemoryAccess(Kind kind, unsigned id, BasicBlock* bb, Instruction* inst)
+        : kind_(kind), id_(id), bb_(bb), inst_(inst) {}
+
+    Kind get_kind() const { return kind_; }
+    bool is_def() const { return kind_ == Def; }
+    bool is_use() const { return kind_ == Use; }
+    bool is_phi() const { return kind_ == Phi; }
+    bool is_live_on_entry() const { return kind_ == LiveOnEntry; }
+    // Def 和 Phi 的编号，打印时使用
+    unsigned get_id() const { return id_; }
+    BasicBlock* get_block() const { return bb_; }
+    // 对应的 load/store/call，Phi 和 LiveOnEntry 为 nullptr
+    Instruction* get_instruction() const { return inst_; }
+    // Def/Use 之前最近的 Def 或 Phi
+    MemoryAccess* get_defining_access() const { return defining_; }
+    // Phi 的各个前驱中的 Def 或 Phi
+    const std::vector<std::pair<MemoryAccess*, BasicBlock*>>& get_incoming() const { return incoming_; }
+
+  private:
+    friend class MemorySSA;
+
+    Kind kind_;
+    unsigned id_;
+    BasicBlock* bb_;
+    Instruction* inst_;
+    MemoryAccess* defining_ = nullptr;
+    std::vector<std::pair<MemoryAccess*, BasicBlock*>> incoming_;
+};
+
+/**
+ * MemorySSA 分析
+ *
+ * MemoryPhi 放在含有 MemoryDef 的基本块的迭代支配边界上，再沿支配树重命名。
+ * 要求函数中没有不可达的基本块（与 Dominators 相同），变换修改了内存访问后需要重新运行。
+ *
+ * get_clobbering_access 沿 defining access 向上查找第一个可能修改给定地址的 Def，
+ * 遇到 Phi 时分别查找每个前驱，回到正在查找的 Phi 的路径（循环回边）不产生新的结果；
+ * 所有路径得到同一个结果时越过 Phi，否则返回 Phi 本身。
+ * AliasAnalysis::alias 把同一个下标变量视为同一个值，这只在循环的同一次迭代中成立，
+ * 所以越过循环回边之后改用 alias_across_iterations（要求控制流图可归约，回边由支配关系确定）。
+ */
+class MemorySSA : public FunctionAnalysisPass {
+  public:
+    /**
+     *
+     * @param f 分析的函数
+     * @param func_info 已经运行过的 FuncInfo，用于判断调用是否读写内存
+     * @param alias_analysis 已经运行过的 AliasAnalysis，用于判断 Def 是否修改给定地址
+     */
+    MemorySSA(Function* f, FuncInfo* func_info, AliasAnalysis* alias_analysis)
+        : FunctionAnalysisPass(f), func_info_(func_info), alias_analysis_(alias_analysis) {}
+
+    void run() override;
+
+    // 指令对应的 MemoryAccess，不访问内存的指令返回 nullptr
+    MemoryAccess* get_access(Instruction* inst) const;
+    // 基本块开头的 MemoryPhi，没有时返回 nullptr
+    MemoryAccess* get_phi(BasicBlock* bb) const;
+    MemoryAccess* get_live_on_entry() const { return live_on_entry_; }
+
+    // load 或只读调用 use 读到的值最近一次可能被修改的位置
+    // load 查询其地址；调用查询 FuncInfo 给出的每个读取的对象，各对象结果不同时保守地返回 use 的 defining access
+    MemoryAccess* get_clobbering_access(MemoryAccess* use);
+    // 从 start 之前开始（不含 start 本身），查找最近一个可能修改 ptr 的访问
+    // whole_object 为 true 时 ptr 代表它所在的整个对象
+    MemoryAccess* get_clobbering_access(MemoryAccess* start, Value* ptr, bool whole_object);
+
+    std::string print() const;
+
+  private:
+    FuncInfo* func_info_;
+    AliasAnalysis* alias_analysis_;
+    std::vector<std::unique_ptr<MemoryAccess>> accesses_;
+    std::unordered_map<Instruction*, MemoryAccess*> inst_access_;
+    std::unordered_map<BasicBlock*, MemoryAccess*> phis_;
+    // (Phi, 前驱) 为循环回边的 incoming
+    std::set<std::pair<MemoryAccess*, BasicBlock*>> back_edges_;
+    MemoryAccess* live_on_entry_ = nullptr;
+    unsigned next_id_ = 0;
+
+    MemoryAccess* create_access(MemoryAccess::Kind kind, BasicBlock* bb, Instruction* inst);
+    void rename(Dominators* dominators, BasicBlock* bb, MemoryAccess* incoming);
+    // def 是否可能修改 ptr
+    // crossed 表示查找已经越过循环回边
+    bool clobbers(MemoryAccess* def, Value* ptr, bool whole_object, bool crossed) const;
+    bool is_back_edge(MemoryAccess* phi, BasicBlock* pre) const;
+    // 从 acc 开始（含 acc）查找，visited 按 (Phi, crossed) 记录查找过的 Phi 的结果（正在查找的为 nullptr）
+    // 所有路径都回到正在查找的 Phi 时返回 nullptr
+    MemoryAccess* walk(MemoryAccess* acc, Value* ptr, bool whole_object, bool crossed,
+                       std::map<std::pair<MemoryAccess*, bool>, MemoryAccess*>& visited);
+    static std::string print_access(const MemoryAccess* acc);
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "BasicBlock.hpp"
+#include "PassManager.hpp"
+
+/**
+ * 分析 Pass, 获得某函数的后必经树（反向 CFG 上的支配树）以及控制依赖
+ *
+ * 反向 CFG 以一个虚拟出口为根：所有 ret 所在基本块连向虚拟出口。
+ * 无法到达 ret 的基本块（如死循环）也直接连向虚拟出口，使每个基本块都有后必经节点。
+ * 接口中用 nullptr 表示虚拟出口。
+ *
+ * 基本块 X 控制依赖于基本块 Y，当且仅当 Y 在 X 的后必经边界（反向支配边界）中，
+ * 即 Y 的终止指令决定了 X 是否执行。
+ */
+class PostDominators : public FunctionAnalysisPass {
+  public:
+    explicit PostDominators(Function* f) : FunctionAnalysisPass(f) { assert(!f->is_declaration() && "PostDominators can not apply to function declaration."); }
+    ~PostDominators() override = default;
+    void run() override;
+
+    // 获取基本块的直接后必经节点，nullptr 代表虚拟出口
+    BasicBlock *get_ipdom(BasicBlock *bb) const { return ipdom_.at(bb); }
+    // 后必经边界
+    const std::set<BasicBlock*> &get_post_dominance_frontier(BasicBlock *bb) const {
+        return post_dom_frontier_.at(bb);
+    }
+    // bb 控制依赖的基本块，即 bb 的后必经边界
+    const std::set<BasicBlock*> &get_control_dependence(BasicBlock *bb) const {
+        return post_dom_frontier_.at(bb);
+    }
+    // bb 是否能沿 CFG 到达 ret
+    bool reach_exit(BasicBlock *bb) const { return reach_exit_.count(bb); }
+    // bb1 是否后必经 bb2
+    bool is_post_dominate(BasicBlock *bb1, BasicBlock *bb2) const {
+        return post_dom_tree_L_.at(bb1) <= post_dom_tree_L_.at(bb2) &&
+               post_dom_tree_R_.at(bb1) >= post_dom_tree_L_.at(bb2);
+    }
+
+    // for debug
+    void print_ipdom() const;
+
+  private:
+    // 反向 CFG 上的前驱，即 CFG 上的后继（ret 块和 exit_roots_ 额外以虚拟出口为前驱）
+    std::vector<BasicBlock*> reverse_preds(BasicBlock* bb) const;
+    void dfs(BasicBlock *bb, std::set<BasicBlock *> &visited);
+    void create_reverse_post_order();
+    void create_ipdom();
+    void create_post_dominance_frontier();
+    void create_post_dom_dfs_order();
+    BasicBlock *intersect(BasicBlock *b1, BasicBlock *b2) const;
+
+    std::vector<BasicBlock *> reversed_post_order_vec_{}; // 反向 CFG 的逆后序，第一个为虚拟出口
+    std::map<BasicBlock *, unsigned int> reversed_post_order_{}; // 逆后序索引
+    std::map<BasicBlock *, BasicBlock *> ipdom_{}; // 直接后必经
+    std::map<BasicBlock *, std::set<BasicBlock*>> post_dom_frontier_{}; // 后必经边界
+    std::map<BasicBlock *, std::set<BasicBlock*>> post_dom_tree_succ_blocks_{}; // 后必经树中的孩子节点
+    std::set<BasicBlock *> reach_exit_{}; // 能到达 ret 的基本块
+    std::set<BasicBlock *> exit_roots_{}; // 不能到达 ret 而直接连向虚拟出口的基本块
+
+    // 后必经树上的dfs序L,R
+    std::map<BasicBlock *, unsigned int> post_dom_tree_L_;
+    std::map<BasicBlock *, unsigned int> post_dom_tree_R_;
+};
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "PassManager.hpp"
+
+/**
+ * 基于值区间的折叠
+ *
+ * 用 ValueRangeAnalysis 求出整数值的区间，区间为单点的值（主要是结果确定的比较）替换为常量，
+ * 条件为常量的跳转改为无条件跳转。例如循环体中重复的 i < n、y 有界时 y*y >= 0。
+ * 不可达的基本块和无用的指令由随后的 DeadCode 删除。
+ **/
+class RangeFolding : public TransformPass {
+  public:
+    RangeFolding(Module *m) : TransformPass(m) {}
+
+    void run() override;
+
+  private:
+    int folded_values_{ 0 };
+    int folded_branches_{ 0 };
+
+    void run_on_function(Function* func);
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "Instruction.hpp"
+#include "PassManager.hpp"
+
+/**
+ * 重结合：把同一基本块内由 add/sub 或 mul 组成的表达式树展开为操作数列表，重新排序后再生成
+ *
+ * 操作数按秩排序：常量最小，其次是形参（按参数顺序），指令按所在循环深度、基本块逆后序和块内位置递增。
+ * 这样常量被合并成一个，循环不变的操作数先结合在一起，LICM 就可以把它们外提，
+ * 例如 a + i + b 变为 (a + b) + i。加法树中带有公共因子的乘法会被提取，例如 i*4 + j*4 变为 (i + j)*4。
+ *
+ * 整数运算按 32 位补码回绕，重结合不改变结果。浮点运算只有在 fast_math 时才处理。
+ **/
+class Reassociate : public TransformPass {
+  public:
+    /**
+     *
+     * @param m 所属 Module
+     * @param fast_math 是否允许对浮点运算重结合
+     */
+    Reassociate(Module *m, bool fast_math) : TransformPass(m), fast_math_(fast_math) {}
+
+    void run() override;
+
+  private:
+    // 表达式树的叶子，sign 为 -1 表示减去该操作数（只用于加法树）
+    struct Operand
+    {
+        Value* val_;
+        int sign_;
+    };
+
+    bool fast_math_;
+    // 指令的秩，形参和常量的秩直接计算
+    std::unordered_map<Value*, long long> rank_;
+
+    void run_on_function(Function* func);
+    // 在 pos 之前创建二元运算指令
+    Instruction* create_before(Instruction::OpID op, Value* lhs, Value* rhs, Instruction* pos);
+    long long get_rank(Value* val) const;
+    // 是否是可以重结合的加法类（add/sub）或乘法类（mul）指令
+    bool is_add_family(const Value* val) const;
+    bool is_mul_family(const Value* val) const;
+    // 指令是否是一棵表达式树的根（不是被同类指令唯一使用的内部节点）
+    bool is_root(Instruction* inst) const;
+    // 展开以 inst 为根的表达式树，返回内部节点个数
+    int linearize(Instruction* inst, int sign, std::vector<Operand>& ops) const;
+    // 在 pos 之前按排好的操作数生成加法树/乘法树，返回结果
+    Value* build_add(std::vector<Operand> ops, Instruction* pos, bool is_float);
+    Value* build_mul(std::vector<Operand> ops, Instruction* pos, bool is_float);
+    // 提取加法树中乘法叶子的公共因子，返回是否提取
+    bool factor(std::vector<Operand>& ops, Instruction* pos, bool is_float);
+};
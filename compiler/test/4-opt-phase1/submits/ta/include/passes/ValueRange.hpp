@@ -0,0 +1,87 @@
+#pragma once
+
+#include <climits>
+#include <unordered_map>
+#include <vector>
+
+#include "Instruction.hpp"
+#include "PassManager.hpp"
+
+class Dominators;
+
+/**
+ * 整数值的闭区间 [lo_, hi_]，lo_ > hi_ 表示空集（尚未求值或不可能取到的值）
+ *
+ * 区间端点用 long long 保存，运算结果超出 32 位时按回绕处理为全集。
+ */
+struct ValueRange
+{
+    long long lo_;
+    long long hi_;
+
+    static ValueRange empty() { return { 1, 0 }; }
+    static ValueRange full(const Type* ty) { return ty->is_int1_type() ? ValueRange{ 0, 1 } : ValueRange{ INT_MIN, INT_MAX }; }
+    static ValueRange single(long long v) { return { v, v }; }
+
+    bool is_empty() const { return lo_ > hi_; }
+    bool is_single() const { return lo_ == hi_; }
+    bool contains(long long v) const { return lo_ <= v && v <= hi_; }
+    bool operator==(const ValueRange& other) const
+    {
+        return (is_empty() && other.is_empty()) || (lo_ == other.lo_ && hi_ == other.hi_);
+    }
+    bool operator!=(const ValueRange& other) const { return !(*this == other); }
+    ValueRange unite(const ValueRange& other) const;
+    ValueRange intersect(const ValueRange& other) const;
+};
+
+/**
+ * 分析 Pass，求函数中每个整数（i32 与 i1）SSA 值的取值区间
+ *
+ * 在区间格上迭代到不动点：常量为单点，参数、load 和函数返回值为全集，
+ * 算术指令按区间运算（可能溢出时为全集），phi 取各入边区间的并。
+ * 循环头（由 LoopDetection 给出）的 phi 区间多次扩大后加宽到 32 位边界，保证迭代终止；
+ * 到达不动点后再不加宽地迭代几轮收窄。
+ *
+ * 条件跳转的比较结果在它支配的后继中成立：例如 i < n 的真分支中 i 的上界不超过 n 的上界减一。
+ * 判断同一对操作数的比较时还会直接使用这些条件，因此循环体中重复的 i < n 也能确定结果。
+ */
+class ValueRangeAnalysis : public FunctionAnalysisPass {
+  public:
+    explicit ValueRangeAnalysis(Function* f) : FunctionAnalysisPass(f) {}
+
+    void run() override;
+
+    // val 在整个函数中的取值区间
+    ValueRange get_range(Value* val) const;
+
+  private:
+    // 条件跳转成立的比较：cmp_ 的结果为 truth_
+    struct Fact
+    {
+        ICmpInst* cmp_;
+        bool truth_;
+    };
+
+    // 循环头 phi 的区间扩大这么多次后加宽
+    static constexpr int WIDEN_THRESHOLD = 2;
+    // 到达不动点后收窄的轮数
+    static constexpr int NARROW_ROUNDS = 2;
+
+    std::unordered_map<Value*, ValueRange> ranges_;
+    // 每个基本块中成立的条件，包括支配它的边上的条件
+    std::unordered_map<BasicBlock*, std::vector<Fact>> facts_;
+
+    // 基本块 pre 跳向 succ 的边上成立的条件
+    static void edge_facts(BasicBlock* pre, BasicBlock* succ, std::vector<Fact>& facts);
+    // 分支条件 cond 为 truth 时成立的比较，会穿过前端生成的 icmp ne (zext c), 0
+    static void collect_facts(Value* cond, bool truth, std::vector<Fact>& facts);
+    void compute_facts(Dominators* dominators);
+
+    // val 在条件 facts 成立时的区间
+    ValueRange range_under(Value* val, const std::vector<Fact>& facts) const;
+    // 在 facts 成立时求 inst 的区间
+    ValueRange evaluate(Instruction* inst, const std::vector<Fact>& facts) const;
+    ValueRange evaluate_cmp(Instruction* inst, const std::vector<Fact>& facts) const;
+    ValueRange evaluate_phi(PhiInst* phi) const;
+};
@@ -4,11 +4,22 @@
 #include "ast.hpp"
 #include "cminusf_builder.hpp"
 #include "CodeGen.hpp"
+#include "X86CodeGen.hpp"
+#include "Interpreter.hpp"
 #include "PassManager.hpp"
 #include "DeadCode.hpp"
 #include "Mem2Reg.hpp"
 #include "LoopDetection.hpp"
 #include "LICM.hpp"
+#include "IPSCCP.hpp"
+#include "DeadArgElim.hpp"
+#include "FunctionInline.hpp"
+#include "GlobalDCE.hpp"
+#include "IfConversion.hpp"
+#include "LoopUnswitch.hpp"
+#include "MemorySSA.hpp"
+#include "RangeFolding.hpp"
+#include "Reassociate.hpp"
 
 #include <filesystem>
 #include <fstream>
@@ -22,13 +33,32 @@ struct Config {
     string exe_name; // compiler exe name
     std::filesystem::path input_file;
     std::filesystem::path output_file;
+    string target{ "loongarch64" };
 
     bool emitast{ false };
     bool emitasm{ false };
     bool emitllvm{ false };
+    bool run{ false };
     // optization conifg
     bool mem2reg{ false };
     bool licm{ false };
+    bool ipsccp{ false };
+    bool func_spec{ false };
+    bool dae{ false };
+    bool func_inline{ false };
+    bool global_dce{ false };
+    bool adce{ false };
+    bool if_conversion{ false };
+    bool loop_unswitch{ false };
+    bool reassociate{ false };
+    bool range_fold{ false };
+    bool fast_math{ false };
+    bool print_memssa{ false };
+    bool peephole{ false };
+    bool stack_coloring{ false };
+    bool block_placement{ false };
+    bool schedule{ false };
+    bool const_hoist{ false };
 
     Config(int argc, char** argv) : argc(argc), argv(argv) {
         parse_cmd_line();
@@ -69,12 +99,73 @@ int main(int argc, char** argv) {
             PM.add_pass<Mem2Reg>();
             PM.add_pass<DeadCode>(false);
         }
+        if (config.ipsccp) {
+            PM.add_pass<IPSCCP>(config.func_spec);
+            PM.add_pass<DeadCode>(true);
+        }
+        if (config.dae) {
+            PM.add_pass<DeadArgumentElimination>();
+            PM.add_pass<DeadCode>(false);
+        }
+        if (config.func_inline) {
+            PM.add_pass<FunctionInline>();
+            PM.add_pass<DeadCode>(true);
+        }
+        if (config.global_dce) {
+            PM.add_pass<GlobalDeadCodeElimination>(config.func_inline, config.dae);
+        }
+        if (config.reassociate) {
+            PM.add_pass<Reassociate>(config.fast_math);
+            PM.add_pass<DeadCode>(false);
+        }
         if (config.licm) {
             PM.add_pass<LoopInvariantCodeMotion>();
             PM.add_pass<DeadCode>(false);
         }
+        if (config.loop_unswitch) {
+            PM.add_pass<LoopUnswitch>();
+            PM.add_pass<DeadCode>(true);
+        }
+        if (config.range_fold) {
+            PM.add_pass<RangeFolding>();
+            PM.add_pass<DeadCode>(true);
+        }
+        if (config.adce) {
+            PM.add_pass<DeadCode>(true, true);
+        }
+        if (config.if_conversion) {
+            PM.add_pass<IfConversion>();
+            PM.add_pass<DeadCode>(false);
+        }
         PM.run();
 
+        if (config.print_memssa) {
+            FuncInfo func_info(m);
+            func_info.run();
+            AliasAnalysis alias_analysis(m, &func_info);
+            alias_analysis.run();
+            for (auto func : m->get_functions()) {
+                if (func->is_declaration()) continue;
+                MemorySSA memory_ssa(func, &func_info, &alias_analysis);
+                memory_ssa.run();
+                std::cerr << memory_ssa.print() << std::endl;
+            }
+        }
+
+        if (config.run) { // 直接解释执行，返回 main 的返回值
+            int ret = 0;
+            try {
+                Interpreter interpreter(m);
+                ret = interpreter.run();
+            }
+            catch (const std::runtime_error& e) {
+                std::cerr << config.exe_name << ": " << e.what() << std::endl;
+                ret = -1;
+            }
+            delete m;
+            return ret;
+        }
+
         std::ofstream output_stream(config.output_file);
         if (config.emitllvm) {
             auto abs_path = std::filesystem::canonical(config.input_file);
@@ -89,7 +180,20 @@ int main(int argc, char** argv) {
             output_stream2 << "; ModuleID = 'cminus'\n";
             output_stream2 << "source_filename = " << abs_path << "\n\n";
             output_stream2 << m->print();
-            CodeGen codegen(m);
+            if (config.target == "x86_64") {
+                X86CodeGen codegen(m);
+                codegen.run();
+                output_stream << codegen.print();
+                delete m;
+                return 0;
+            }
+            CodeGenOptions codegen_options;
+            codegen_options.peephole = config.peephole;
+            codegen_options.stack_coloring = config.stack_coloring;
+            codegen_options.block_placement = config.block_placement;
+            codegen_options.schedule = config.schedule;
+            codegen_options.const_hoist = config.const_hoist;
+            CodeGen codegen(m, codegen_options);
             codegen.run();
             output_stream << codegen.print();
         }
@@ -115,6 +219,15 @@ void Config::parse_cmd_line() {
                 print_err("bad output file");
             }
         }
+        else if (argv[i] == "-target"s) {
+            if (i + 1 < argc && (argv[i + 1] == "loongarch64"s || argv[i + 1] == "x86_64"s)) {
+                target = argv[i + 1];
+                i += 1;
+            }
+            else {
+                print_err("bad target, expected loongarch64 or x86_64");
+            }
+        }
         else if (argv[i] == "-emit-ast"s) {
             emitast = true;
         }
@@ -124,12 +237,66 @@ void Config::parse_cmd_line() {
         else if (argv[i] == "-emit-llvm"s) {
             emitllvm = true;
         }
+        else if (argv[i] == "-run"s) {
+            run = true;
+        }
         else if (argv[i] == "-mem2reg"s) {
             mem2reg = true;
         }
         else if (argv[i] == "-licm"s) {
             licm = true;
         }
+        else if (argv[i] == "-ipsccp"s) {
+            ipsccp = true;
+        }
+        else if (argv[i] == "-func-spec"s) {
+            func_spec = true;
+        }
+        else if (argv[i] == "-dae"s) {
+            dae = true;
+        }
+        else if (argv[i] == "-inline"s) {
+            func_inline = true;
+        }
+        else if (argv[i] == "-global-dce"s) {
+            global_dce = true;
+        }
+        else if (argv[i] == "-adce"s) {
+            adce = true;
+        }
+        else if (argv[i] == "-if-conversion"s) {
+            if_conversion = true;
+        }
+        else if (argv[i] == "-loop-unswitch"s) {
+            loop_unswitch = true;
+        }
+        else if (argv[i] == "-reassociate"s) {
+            reassociate = true;
+        }
+        else if (argv[i] == "-range-fold"s) {
+            range_fold = true;
+        }
+        else if (argv[i] == "-ffast-math"s) {
+            fast_math = true;
+        }
+        else if (argv[i] == "-print-memssa"s) {
+            print_memssa = true;
+        }
+        else if (argv[i] == "-peephole"s) {
+            peephole = true;
+        }
+        else if (argv[i] == "-stack-coloring"s) {
+            stack_coloring = true;
+        }
+        else if (argv[i] == "-block-placement"s) {
+            block_placement = true;
+        }
+        else if (argv[i] == "-schedule"s) {
+            schedule = true;
+        }
+        else if (argv[i] == "-const-hoist"s) {
+            const_hoist = true;
+        }
         else {
             if (input_file.empty()) {
                 input_file = argv[i];
@@ -153,12 +320,69 @@ void Config::check() {
     if (emitllvm and emitasm) {
         print_err("emit llvm and emit asm both set");
     }
-    if (not emitllvm and not emitasm and not emitast) {
+    if (run and (emitllvm or emitasm or emitast)) {
+        print_err("run cannot be used with -emit-llvm, -S or -emit-ast");
+    }
+    if (not emitllvm and not emitasm and not emitast and not run) {
         print_err("not supported: generate executable file directly");
     }
     if (licm and not mem2reg) {
         print_err("licm must be used with mem2reg");
     }
+    if (ipsccp and not mem2reg) {
+        print_err("ipsccp must be used with mem2reg");
+    }
+    if (func_spec and not ipsccp) {
+        print_err("func-spec must be used with ipsccp");
+    }
+    if (dae and not mem2reg) {
+        print_err("dae must be used with mem2reg");
+    }
+    if (func_inline and not mem2reg) {
+        print_err("inline must be used with mem2reg");
+    }
+    if (global_dce and not mem2reg) {
+        print_err("global-dce must be used with mem2reg");
+    }
+    if (adce and not mem2reg) {
+        print_err("adce must be used with mem2reg");
+    }
+    if (if_conversion and not mem2reg) {
+        print_err("if-conversion must be used with mem2reg");
+    }
+    if (loop_unswitch and not licm) {
+        print_err("loop-unswitch must be used with licm");
+    }
+    if (reassociate and not mem2reg) {
+        print_err("reassociate must be used with mem2reg");
+    }
+    if (range_fold and not mem2reg) {
+        print_err("range-fold must be used with mem2reg");
+    }
+    if (print_memssa and not mem2reg) {
+        print_err("print-memssa must be used with mem2reg");
+    }
+    if (peephole and not emitasm) {
+        print_err("peephole must be used with -S");
+    }
+    if (stack_coloring and not emitasm) {
+        print_err("stack-coloring must be used with -S");
+    }
+    if (block_placement and not emitasm) {
+        print_err("block-placement must be used with -S");
+    }
+    if (schedule and not emitasm) {
+        print_err("schedule must be used with -S");
+    }
+    if (const_hoist and not emitasm) {
+        print_err("const-hoist must be used with -S");
+    }
+    if (target != "loongarch64" and not emitasm) {
+        print_err("target must be used with -S");
+    }
+    if (target == "x86_64" and (peephole or stack_coloring or block_placement or schedule or const_hoist)) {
+        print_err("machine-level optimizations are only implemented for loongarch64");
+    }
     if (output_file.empty()) {
         output_file = input_file.stem();
     }
@@ -172,8 +396,8 @@ void Config::check() {
 
 void Config::print_help() const {
     std::cout << "Usage: " << exe_name
-        << " [-h|--help] [-o <target-file>] [-emit-llvm] [-S] [-dump-json]"
-        "[-mem2reg] [-licm]"
+        << " [-h|--help] [-o <target-file>] [-emit-llvm] [-S] [-run] [-target loongarch64|x86_64] [-dump-json]"
+        "[-mem2reg] [-licm] [-ipsccp] [-func-spec] [-dae] [-inline] [-global-dce] [-adce] [-if-conversion] [-loop-unswitch] [-reassociate] [-range-fold] [-ffast-math] [-print-memssa] [-peephole] [-stack-coloring] [-block-placement] [-schedule] [-const-hoist]"
         "<input-file>"
         << std::endl;
     exit(0);
@@ -0,0 +1,42 @@
+#include "BlockFrequency.hpp"
+
+#include <cmath>
+#include <map>
+
+#include "LoopDetection.hpp"
+
+BlockFrequency::BlockFrequency(MachineFunction* func)
+{
+    auto* loop_detection = new LoopDetection(func->get_function());
+    loop_detection->run();
+    std::map<BasicBlock*, unsigned> depth;
+    for (auto* loop : loop_detection->get_loops())
+    {
+        for (auto* bb : loop->get_blocks()) depth[bb]++;
+    }
+    delete loop_detection;
+
+    for (auto* mbb : func->get_basic_blocks())
+    {
+        if (mbb->get_basic_block() != nullptr)
+        {
+            depth_[mbb] = depth[mbb->get_basic_block()];
+            continue;
+        }
+        depth_[mbb] = 0;
+        for (auto* pred : mbb->get_pre_basic_blocks())
+        {
+            if (pred->get_basic_block() == nullptr) continue;
+            depth_[mbb] = depth[pred->get_basic_block()];
+            break;
+        }
+    }
+}
+
+unsigned BlockFrequency::get_loop_depth(MachineBasicBlock* bb) const
+{
+    auto it = depth_.find(bb);
+    return it == depth_.end() ? 0 : it->second;
+}
+
+double BlockFrequency::get_frequency(MachineBasicBlock* bb) const { return std::pow(10.0, get_loop_depth(bb)); }
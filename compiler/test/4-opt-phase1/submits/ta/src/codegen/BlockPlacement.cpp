@@ -0,0 +1,232 @@
+#include "BlockPlacement.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "BlockFrequency.hpp"
+#include "logging.hpp"
+
+using Op = MachineInstr::Opcode;
+
+namespace
+{
+// 块中最后一条不是注释的指令，没有时返回 nullptr
+MachineInstr* last_instr(MachineBasicBlock* bb)
+{
+    auto& instrs = bb->get_instructions();
+    for (auto it = instrs.rbegin(); it != instrs.rend(); ++it)
+    {
+        if (not (*it)->is_comment()) return *it;
+    }
+    return nullptr;
+}
+
+// 跳转到的基本块，按出现顺序去重
+std::vector<MachineBasicBlock*> branch_targets(MachineBasicBlock* bb)
+{
+    std::vector<MachineBasicBlock*> targets;
+    for (auto* instr : bb->get_instructions())
+    {
+        if (not instr->is_cond_branch() and instr->get_opcode() != Op::B) continue;
+        auto* target = instr->get_operands().back().get_block();
+        if (std::find(targets.begin(), targets.end(), target) == targets.end()) targets.push_back(target);
+    }
+    return targets;
+}
+
+Op invert_branch(Op op)
+{
+    switch (op)
+    {
+        case Op::BEQZ: return Op::BNEZ;
+        case Op::BNEZ: return Op::BEQZ;
+        case Op::BEQ: return Op::BNE;
+        case Op::BNE: return Op::BEQ;
+        case Op::BLT: return Op::BGE;
+        case Op::BGE: return Op::BLT;
+        case Op::BLTU: return Op::BGEU;
+        case Op::BGEU: return Op::BLTU;
+        case Op::BCEQZ: return Op::BCNEZ;
+        case Op::BCNEZ: return Op::BCEQZ;
+        default: assert(false && "not a conditional branch"); return op;
+    }
+}
+
+int count_branches(MachineFunction* func)
+{
+    int count = 0;
+    for (auto* bb : func->get_basic_blocks())
+    {
+        for (auto* instr : bb->get_instructions())
+        {
+            if (instr->get_opcode() == Op::B) count++;
+        }
+    }
+    return count;
+}
+
+// 按块频率静态估计的跳转次数：块的频率按各后继的频率分配，跳到的后继计入，落入的后继不计
+double estimate_taken_branches(MachineFunction* func, const BlockFrequency& freq)
+{
+    double taken = 0;
+    for (auto* bb : func->get_basic_blocks())
+    {
+        auto targets = branch_targets(bb);
+        if (targets.empty()) continue;
+        double total = 0;
+        for (auto* succ : bb->get_succ_basic_blocks()) total += freq.get_frequency(succ);
+        for (auto* target : targets) taken += freq.get_frequency(bb) * freq.get_frequency(target) / total;
+    }
+    return taken;
+}
+
+struct Edge
+{
+    MachineBasicBlock* src;
+    MachineBasicBlock* dst;
+    double weight;
+};
+} // namespace
+
+void BlockPlacement::run()
+{
+    for (auto* func : funcs_) run_on_function(func);
+    LOG_INFO << "block placement: " << branches_before_ << " -> " << branches_after_
+             << " unconditional branches, estimated taken branches " << taken_before_ << " -> " << taken_after_
+             << ", " << inverted_branches_ << " conditional branches inverted";
+}
+
+void BlockPlacement::make_branches_explicit(MachineFunction* func)
+{
+    for (auto* bb : func->get_basic_blocks())
+    {
+        auto* next = func->get_next_basic_block(bb);
+        if (next == nullptr) continue;
+        auto* last = last_instr(bb);
+        if (last != nullptr and last->is_unconditional_branch()) continue;
+        MachineInstr::create(Op::B, {next}, bb);
+        bb->add_succ_basic_block(next);
+    }
+}
+
+void BlockPlacement::remove_fallthrough_branches(MachineFunction* func)
+{
+    for (auto* bb : func->get_basic_blocks())
+    {
+        auto* next = func->get_next_basic_block(bb);
+        auto* last = last_instr(bb);
+        if (next == nullptr or last == nullptr or last->get_opcode() != Op::B) continue;
+        auto* target = last->get_operand(0).get_block();
+        if (target == next)
+        {
+            bb->erase_instr(last);
+            continue;
+        }
+        // b 之前的条件跳转到下一个块：取反条件，跳到 b 的目标
+        bb->get_instructions().remove(last);
+        auto* cond = last_instr(bb);
+        bb->add_instruction(last);
+        if (cond == nullptr or not cond->is_cond_branch()) continue;
+        auto& cond_target = cond->get_operands().back();
+        if (cond_target.get_block() != next) continue;
+        cond->set_opcode(invert_branch(cond->get_opcode()));
+        cond_target.set_block(target);
+        bb->erase_instr(last);
+        inverted_branches_++;
+    }
+}
+
+void BlockPlacement::run_on_function(MachineFunction* func)
+{
+    BlockFrequency freq(func);
+    branches_before_ += count_branches(func);
+    taken_before_ += estimate_taken_branches(func, freq);
+    make_branches_explicit(func);
+
+    auto* entry = func->get_basic_blocks().front();
+    auto* exit = func->get_exit_block();
+    std::vector<MachineBasicBlock*> blocks;
+    for (auto* bb : func->get_basic_blocks())
+    {
+        if (bb != exit) blocks.push_back(bb);
+    }
+
+    // 边权：源块的频率按各后继的频率分配，循环内的后继比出循环的后继更可能执行；
+    // 权重相同时先考虑 b 的目标，即原来落入的后继
+    std::vector<Edge> edges;
+    for (auto* bb : blocks)
+    {
+        auto targets = branch_targets(bb);
+        std::reverse(targets.begin(), targets.end());
+        double total = 0;
+        for (auto* succ : targets) total += freq.get_frequency(succ);
+        for (auto* succ : targets)
+        {
+            if (succ == exit or succ == entry or succ == bb) continue;
+            edges.push_back({ bb, succ, freq.get_frequency(bb) * freq.get_frequency(succ) / total });
+        }
+    }
+    std::stable_sort(edges.begin(), edges.end(), [](const Edge& a, const Edge& b) { return a.weight > b.weight; });
+
+    // 合并首尾相接的链，链的编号为最初的块号
+    std::vector<std::vector<MachineBasicBlock*>> chains;
+    std::unordered_map<MachineBasicBlock*, unsigned> chain_of;
+    for (auto* bb : blocks)
+    {
+        chain_of[bb] = static_cast<unsigned>(chains.size());
+        chains.push_back({ bb });
+    }
+    for (auto& edge : edges)
+    {
+        auto src_chain = chain_of[edge.src];
+        auto dst_chain = chain_of[edge.dst];
+        if (src_chain == dst_chain) continue;
+        if (chains[src_chain].back() != edge.src or chains[dst_chain].front() != edge.dst) continue;
+        for (auto* bb : chains[dst_chain])
+        {
+            chains[src_chain].push_back(bb);
+            chain_of[bb] = src_chain;
+        }
+        chains[dst_chain].clear();
+    }
+
+    // 入口链在最前，之后每次放置从已放置的块跳入权重最大的链，相同时按原来的顺序
+    std::list<MachineBasicBlock*> layout;
+    std::unordered_set<MachineBasicBlock*> placed;
+    std::vector<bool> chain_placed(chains.size(), false);
+    auto place = [&](unsigned chain) {
+        chain_placed[chain] = true;
+        for (auto* bb : chains[chain])
+        {
+            layout.push_back(bb);
+            placed.insert(bb);
+        }
+    };
+    place(chain_of[entry]);
+    while (true)
+    {
+        std::vector<double> connection(chains.size(), 0);
+        for (auto& edge : edges)
+        {
+            if (placed.count(edge.src) and not placed.count(edge.dst)) connection[chain_of[edge.dst]] += edge.weight;
+        }
+        int best = -1;
+        for (unsigned i = 0; i < chains.size(); i++)
+        {
+            if (chain_placed[i] or chains[i].empty()) continue;
+            if (best < 0 or connection[i] > connection[best]) best = static_cast<int>(i);
+        }
+        if (best < 0) break;
+        place(static_cast<unsigned>(best));
+    }
+    if (exit != nullptr) layout.push_back(exit);
+    assert(layout.size() == func->get_basic_blocks().size());
+    func->get_basic_blocks() = layout;
+
+    remove_fallthrough_branches(func);
+    branches_after_ += count_branches(func);
+    taken_after_ += estimate_taken_branches(func, freq);
+}
@@ -1,25 +1,73 @@
 #include "CodeGen.hpp"
 
+#include <algorithm>
+#include <climits>
 #include <cstring>
+#include <vector>
 
-#include "ASMInstruction.hpp"
 #include "BasicBlock.hpp"
+#include "BlockFrequency.hpp"
+#include "BlockPlacement.hpp"
 #include "CodeGenUtil.hpp"
+#include "ExecuteCost.hpp"
 #include "Function.hpp"
+#include "InstrScheduler.hpp"
 #include "Instruction.hpp"
+#include "MachineIR.hpp"
+#include "Peephole.hpp"
 #include "Register.hpp"
+#include "StackColoring.hpp"
 #include "Type.hpp"
+#include "logging.hpp"
 #include <string>
 
+using Op = MachineInstr::Opcode;
+
+static MachineOperand imm(int64_t val) { return MachineOperand::create_imm(val); }
+
+static MachineOperand frame_index(int index) { return MachineOperand::create_frame_index(index); }
+
+// 浮点常量池的标签，源程序中的标识符只含字母，不会冲突
+static const char* const FLOAT_POOL_LABEL = ".LCF";
+
+CodeGen::~CodeGen()
+{
+    for (auto* mfunc : mfuncs) delete mfunc;
+}
+
+MachineInstr* CodeGen::append_inst(MachineInstr::Opcode op, std::vector<MachineOperand> operands)
+{
+    auto* instr = MachineInstr::create(op, std::move(operands));
+    context.mbb->insert_instr(context.insert_pos, instr);
+    // 调用者保存的 $t3-$t7 被调用破坏
+    if (instr->is_call()) context.global_cache.clear();
+    return instr;
+}
+
+void CodeGen::append_comment(const std::string& text)
+{
+    context.mbb->insert_instr(context.insert_pos, MachineInstr::create_comment(text));
+}
+
+void CodeGen::set_insert_point(MachineBasicBlock* bb)
+{
+    set_insert_point(bb, bb->get_instructions().end());
+}
+
+void CodeGen::set_insert_point(MachineBasicBlock* bb, std::list<MachineInstr*>::iterator pos)
+{
+    context.mbb = bb;
+    context.insert_pos = pos;
+    context.global_cache.clear();
+}
 
 void CodeGen::allocate()
 {
-    unsigned offset = PROLOGUE_OFFSET_BASE;
+    auto* mfunc = context.mfunc;
     for (auto& arg : context.func->get_args())
     {
         auto size = arg->get_type()->get_size();
-        offset = ALIGN(offset + size, size);
-        context.offset_map[arg] = -static_cast<int>(offset);
+        context.frame_index_map[arg] = mfunc->create_frame_object(size, size);
     }
     for (auto& bb : context.func->get_basic_blocks())
     {
@@ -28,53 +76,198 @@ void CodeGen::allocate()
             if (not instr->is_void())
             {
                 auto size = instr->get_type()->get_size();
-                offset = ALIGN(offset + size, size > 8 ? 8 : size);
-                context.offset_map[instr] = -static_cast<int>(offset);
+                context.frame_index_map[instr] = mfunc->create_frame_object(size, size > 8 ? 8 : size);
             }
             if (instr->is_alloca())
             {
                 auto* alloca_inst = dynamic_cast<AllocaInst*>(instr);
                 auto alloc_size = alloca_inst->get_alloca_type()->get_size();
-                offset = ALIGN(offset + alloc_size, alloc_size > 8 ? 8 : alloc_size);
+                context.alloca_map[alloca_inst] =
+                    mfunc->create_frame_object(alloc_size, alloc_size > 8 ? 8 : alloc_size);
             }
         }
     }
-    context.frame_size = ALIGN(offset, PROLOGUE_ALIGN);
 }
 
-void CodeGen::copy_stmt()
+void CodeGen::lower_frame()
 {
-    for (auto& succ : context.bb->get_succ_basic_blocks())
+    auto* mfunc = context.mfunc;
+    // 写过的 $s0-$s8、$fs0-$fs7 在序言中保存、在尾声中恢复
+    std::vector<bool> saved_gregs(32, false);
+    std::vector<bool> saved_fregs(32, false);
+    for (auto* bb : mfunc->get_basic_blocks())
     {
-        for (auto& inst : succ->get_instructions())
+        for (auto* instr : bb->get_instructions())
         {
-            if (inst->is_phi())
+            for (auto& def : instr->get_defs())
             {
-                for (unsigned i = 1; i < inst->get_operands().size(); i += 2)
-                {
-                    if (inst->get_operand(i) == context.bb)
-                    {
-                        auto* lvalue = inst->get_operand(i - 1);
-                        if (lvalue->get_type()->is_float_type())
-                        {
-                            load_to_freg(lvalue, FReg::fa(0));
-                            store_from_freg(inst, FReg::fa(0));
-                        }
-                        else
-                        {
-                            load_to_greg(lvalue, Reg::a(0));
-                            store_from_greg(inst, Reg::a(0));
-                        }
-                        break;
-                    }
-                }
+                if (def.is_greg() and def.get_reg().id >= Reg::s(0).id) saved_gregs[def.get_reg().id] = true;
+                if (def.is_freg() and def.get_freg().id >= FReg::fs(0).id) saved_fregs[def.get_freg().id] = true;
             }
-            else
+        }
+    }
+    for (unsigned id = 0; id < 32; id++)
+    {
+        if (saved_gregs[id]) context.callee_saved.emplace_back(Reg(id), mfunc->create_frame_object(8, 8));
+    }
+    for (unsigned id = 0; id < 32; id++)
+    {
+        if (saved_fregs[id]) context.callee_saved.emplace_back(FReg(id), mfunc->create_frame_object(8, 8));
+    }
+    mfunc->layout_frame();
+
+    // 栈帧大小是静态的，不使用 $fp；叶函数不保存 $ra，没有栈帧对象时也不调整 $sp
+    auto* entry = mfunc->get_basic_blocks().front();
+    set_insert_point(entry, entry->get_instructions().begin());
+    auto frame_size = static_cast<int>(mfunc->get_frame_size());
+    if (mfunc->has_call())
+    {
+        append_inst(Op::ST_D, {Reg::ra(), Reg::sp(), imm(-8)});
+    }
+    if (frame_size > 0 and IS_IMM_12(-frame_size))
+    {
+        append_inst(Op::ADDI_D, {Reg::sp(), Reg::sp(), imm(-frame_size)});
+    }
+    else if (frame_size > 0)
+    {
+        load_large_int64(frame_size, Reg::t(0));
+        append_inst(Op::SUB_D, {Reg::sp(), Reg::sp(), Reg::t(0)});
+    }
+    for (auto& [reg, index] : context.callee_saved)
+    {
+        append_inst(reg.is_greg() ? Op::ST_D : Op::FST_D, {reg, frame_index(index), imm(0)});
+    }
+
+    // 尾声只有几条指令时复制到每个返回处，省去跳转到出口块的 b
+    auto* exit = mfunc->get_exit_block();
+    if (IS_IMM_12(frame_size))
+    {
+        auto preds = exit->get_pre_basic_blocks();
+        for (auto* pred : preds)
+        {
+            auto& instrs = pred->get_instructions();
+            if (instrs.empty() or instrs.back()->get_opcode() != Op::B) continue;
+            pred->erase_instr(instrs.back());
+            pred->remove_succ_basic_block(exit);
+            set_insert_point(pred);
+            gen_epilogue();
+        }
+    }
+    if (exit->get_pre_basic_blocks().empty())
+    {
+        mfunc->erase_basic_block(exit);
+    }
+    else
+    {
+        set_insert_point(exit);
+        gen_epilogue();
+    }
+
+    for (auto* bb : mfunc->get_basic_blocks())
+    {
+        auto& instrs = bb->get_instructions();
+        for (auto it = instrs.begin(); it != instrs.end(); ++it)
+        {
+            set_insert_point(bb, it);
+            eliminate_frame_index(*it);
+        }
+    }
+}
+
+// 栈帧对象只出现在访存指令的基址和 addi.d 的源操作数中，偏移超出 12 位时先把地址算到 $t8
+void CodeGen::eliminate_frame_index(MachineInstr* instr)
+{
+    if (not instr->has_frame_index()) return;
+    auto& operands = instr->get_operands();
+    auto& object = context.mfunc->get_frame_object(operands[1].get_frame_index());
+    auto offset = object.offset_ + operands[2].get_imm();
+    if (IS_IMM_12(static_cast<int>(offset)))
+    {
+        operands[1] = Reg::sp();
+        operands[2].set_imm(offset);
+        return;
+    }
+    assert(instr->is_load() or instr->is_store() or instr->get_opcode() == Op::ADDI_D);
+    // 栈帧偏移在 32 位范围内，lu12i.w 会做符号扩展
+    auto addr = Reg::t(8);
+    load_large_int32(static_cast<int32_t>(offset), addr);
+    if (instr->get_opcode() == Op::ADDI_D)
+    {
+        instr->set_opcode(Op::ADD_D);
+        operands[1] = Reg::sp();
+        operands[2] = addr;
+        return;
+    }
+    append_inst(Op::ADD_D, {addr, Reg::sp(), addr});
+    operands[1] = addr;
+    operands[2].set_imm(0);
+}
+
+void CodeGen::copy_stmt(BasicBlock* succ)
+{
+    // 当前边上 phi 的并行复制：目的 phi <- 源值，源值为 nullptr 表示暂存寄存器
+    std::vector<std::pair<Value*, Value*>> copies;
+    for (auto& inst : succ->get_instructions())
+    {
+        if (not inst->is_phi()) break;
+        for (unsigned i = 1; i < inst->get_operands().size(); i += 2)
+        {
+            if (inst->get_operand(i) == context.bb)
             {
+                auto* src = inst->get_operand(i - 1);
+                if (src != inst) copies.emplace_back(inst, src);
                 break;
             }
         }
     }
+
+    auto emit_copy = [&](Value* dst, Value* src) {
+        if (dst->get_type()->is_float_type())
+        {
+            if (src == nullptr) store_from_freg(dst, FReg::ft(1));
+            else
+            {
+                load_to_freg(src, FReg::fa(0));
+                store_from_freg(dst, FReg::fa(0));
+            }
+        }
+        else
+        {
+            if (src == nullptr) store_from_greg(dst, Reg::t(1));
+            else
+            {
+                load_to_greg(src, Reg::a(0));
+                store_from_greg(dst, Reg::a(0));
+            }
+        }
+    };
+    // 先复制目的不再被其它复制读取的，剩下的都在环上：把环上一个目的的旧值存入暂存寄存器，打开环
+    while (not copies.empty())
+    {
+        bool progress = false;
+        for (auto it = copies.begin(); it != copies.end();)
+        {
+            auto* dst = it->first;
+            bool is_read = std::any_of(copies.begin(), copies.end(),
+                                       [dst](const std::pair<Value*, Value*>& copy) { return copy.second == dst; });
+            if (is_read)
+            {
+                ++it;
+                continue;
+            }
+            emit_copy(dst, it->second);
+            it = copies.erase(it);
+            progress = true;
+        }
+        if (progress) continue;
+        auto* saved = copies.front().first;
+        if (saved->get_type()->is_float_type()) load_to_freg(saved, FReg::ft(1));
+        else load_to_greg(saved, Reg::t(1));
+        for (auto& copy : copies)
+        {
+            if (copy.second == saved) copy.second = nullptr;
+        }
+    }
 }
 
 void CodeGen::load_to_greg(Value* val, const Reg& reg)
@@ -85,9 +278,14 @@ void CodeGen::load_to_greg(Value* val, const Reg& reg)
     if (auto* constant = dynamic_cast<ConstantInt*>(val))
     {
         int32_t val1 = constant->get_value();
+        auto hoisted = context.hoisted_ints.find(val1);
         if (IS_IMM_12(val1))
         {
-            append_inst(ADDI WORD, {reg.print(), "$zero", std::to_string(val1)});
+            append_inst(Op::ADDI_W, {reg, Reg::zero(), imm(val1)});
+        }
+        else if (hoisted != context.hoisted_ints.end())
+        {
+            append_inst(Op::OR, {reg, hoisted->second, Reg::zero()});
         }
         else
         {
@@ -96,7 +294,37 @@ void CodeGen::load_to_greg(Value* val, const Reg& reg)
     }
     else if (auto* global = dynamic_cast<GlobalVariable*>(val))
     {
-        append_inst(LOAD_ADDR, {reg.print(), global->get_name()});
+        auto symbol = MachineOperand::create_symbol(global->get_name());
+        auto hoisted = context.hoisted_globals.find(global);
+        auto cached = context.global_cache.find(global);
+        if (hoisted != context.hoisted_globals.end())
+        {
+            append_inst(Op::OR, {reg, hoisted->second, Reg::zero()});
+        }
+        else if (cached != context.global_cache.end())
+        {
+            append_inst(Op::OR, {reg, cached->second, Reg::zero()});
+        }
+        else if (context.reused_globals.count(global))
+        {
+            // 轮流使用 $t3-$t7，替换掉原来占用该寄存器的地址
+            auto cache_reg = Reg::t(3 + context.next_cache_reg++ % 5);
+            for (auto it = context.global_cache.begin(); it != context.global_cache.end(); ++it)
+            {
+                if (it->second.id == cache_reg.id)
+                {
+                    context.global_cache.erase(it);
+                    break;
+                }
+            }
+            append_inst(Op::LA_LOCAL, {cache_reg, symbol});
+            append_inst(Op::OR, {reg, cache_reg, Reg::zero()});
+            context.global_cache.emplace(global, cache_reg);
+        }
+        else
+        {
+            append_inst(Op::LA_LOCAL, {reg, symbol});
+        }
     }
     else
     {
@@ -108,8 +336,8 @@ void CodeGen::load_large_int32(int32_t val, const Reg& reg)
 {
     int32_t high_20 = val >> 12;
     uint32_t low_12 = val & LOW_12_MASK;
-    append_inst(LU12I_W, {reg.print(), std::to_string(high_20)});
-    append_inst(ORI, {reg.print(), reg.print(), std::to_string(low_12)});
+    append_inst(Op::LU12I_W, {reg, imm(high_20)});
+    append_inst(Op::ORI, {reg, reg, imm(low_12)});
 }
 
 void CodeGen::load_large_int64(int64_t val, const Reg& reg)
@@ -120,87 +348,43 @@ void CodeGen::load_large_int64(int64_t val, const Reg& reg)
     auto high_32 = static_cast<int32_t>(val >> 32);
     int32_t high_32_low_20 = (high_32 << 12) >> 12;
     int32_t high_32_high_12 = high_32 >> 20;
-    append_inst(LU32I_D, {reg.print(), std::to_string(high_32_low_20)});
-    append_inst(LU52I_D,
-                {reg.print(), reg.print(), std::to_string(high_32_high_12)});
+    append_inst(Op::LU32I_D, {reg, imm(high_32_low_20)});
+    append_inst(Op::LU52I_D, {reg, reg, imm(high_32_high_12)});
 }
 
 void CodeGen::load_from_stack_to_greg(Value* val, const Reg& reg)
 {
-    auto offset = context.offset_map.at(val);
-    auto offset_str = std::to_string(offset);
+    auto index = context.frame_index_map.at(val);
     auto* type = val->get_type();
-    if (IS_IMM_12(offset))
+    if (type->is_int1_type())
     {
-        if (type->is_int1_type())
-        {
-            append_inst(LOAD BYTE, {reg.print(), "$fp", offset_str});
-        }
-        else if (type->is_int32_type())
-        {
-            append_inst(LOAD WORD, {reg.print(), "$fp", offset_str});
-        }
-        else
-        {
-            append_inst(LOAD DOUBLE, {reg.print(), "$fp", offset_str});
-        }
+        append_inst(Op::LD_B, {reg, frame_index(index), imm(0)});
+    }
+    else if (type->is_int32_type())
+    {
+        append_inst(Op::LD_W, {reg, frame_index(index), imm(0)});
     }
     else
     {
-        load_large_int64(offset, reg);
-        append_inst(ADD DOUBLE, {reg.print(), "$fp", reg.print()});
-        if (type->is_int1_type())
-        {
-            append_inst(LOAD BYTE, {reg.print(), reg.print(), "0"});
-        }
-        else if (type->is_int32_type())
-        {
-            append_inst(LOAD WORD, {reg.print(), reg.print(), "0"});
-        }
-        else
-        {
-            append_inst(LOAD DOUBLE, {reg.print(), reg.print(), "0"});
-        }
+        append_inst(Op::LD_D, {reg, frame_index(index), imm(0)});
     }
 }
 
 void CodeGen::store_from_greg(Value* val, const Reg& reg)
 {
-    auto offset = context.offset_map.at(val);
-    auto offset_str = std::to_string(offset);
+    auto index = context.frame_index_map.at(val);
     auto* type = val->get_type();
-    if (IS_IMM_12(offset))
+    if (type->is_int1_type())
     {
-        if (type->is_int1_type())
-        {
-            append_inst(STORE BYTE, {reg.print(), "$fp", offset_str});
-        }
-        else if (type->is_int32_type())
-        {
-            append_inst(STORE WORD, {reg.print(), "$fp", offset_str});
-        }
-        else
-        {
-            append_inst(STORE DOUBLE, {reg.print(), "$fp", offset_str});
-        }
+        append_inst(Op::ST_B, {reg, frame_index(index), imm(0)});
+    }
+    else if (type->is_int32_type())
+    {
+        append_inst(Op::ST_W, {reg, frame_index(index), imm(0)});
     }
     else
     {
-        auto addr = Reg::t(8);
-        load_large_int64(offset, addr);
-        append_inst(ADD DOUBLE, {addr.print(), "$fp", addr.print()});
-        if (type->is_int1_type())
-        {
-            append_inst(STORE BYTE, {reg.print(), addr.print(), "0"});
-        }
-        else if (type->is_int32_type())
-        {
-            append_inst(STORE WORD, {reg.print(), addr.print(), "0"});
-        }
-        else
-        {
-            append_inst(STORE DOUBLE, {reg.print(), addr.print(), "0"});
-        }
+        append_inst(Op::ST_D, {reg, frame_index(index), imm(0)});
     }
 }
 
@@ -214,66 +398,201 @@ void CodeGen::load_to_freg(Value* val, const FReg& freg)
     }
     else
     {
-        auto offset = context.offset_map.at(val);
-        auto offset_str = std::to_string(offset);
-        if (IS_IMM_12(offset))
+        append_inst(Op::FLD_S, {freg, frame_index(context.frame_index_map.at(val)), imm(0)});
+    }
+}
+
+void CodeGen::load_float_imm(float val, const FReg& r)
+{
+    int32_t bytes = 0;
+    memcpy(&bytes, &val, sizeof(float));
+    if (options.const_hoist)
+    {
+        auto hoisted = context.hoisted_floats.find(static_cast<uint32_t>(bytes));
+        if (hoisted != context.hoisted_floats.end())
         {
-            append_inst(FLOAD SINGLE, {freg.print(), "$fp", offset_str});
+            append_inst(Op::FMOV_S, {r, hoisted->second});
+            return;
         }
-        else
+        if (bytes == 0)
         {
-            auto addr = Reg::t(8);
-            load_large_int64(offset, addr);
-            append_inst(ADD DOUBLE, {addr.print(), "$fp", addr.print()});
-            append_inst(FLOAD SINGLE, {freg.print(), addr.print(), "0"});
+            append_inst(Op::MOVGR2FR_W, {r, Reg::zero()});
+            return;
+        }
+        auto offset = get_float_pool_offset(val);
+        if (offset >= 0)
+        {
+            append_inst(Op::LA_LOCAL, {Reg::t(8), MachineOperand::create_symbol(FLOAT_POOL_LABEL)});
+            append_inst(Op::FLD_S, {r, Reg::t(8), imm(offset)});
+            return;
         }
     }
+    load_large_int32(bytes, Reg::t(8));
+    append_inst(Op::MOVGR2FR_W, {r, Reg::t(8)});
 }
 
-void CodeGen::load_float_imm(float val, const FReg& r)
+int CodeGen::get_float_pool_offset(float val)
 {
-    int32_t bytes = 0;
+    uint32_t bytes = 0;
     memcpy(&bytes, &val, sizeof(float));
-    load_large_int32(bytes, Reg::t(8));
-    append_inst(GR2FR WORD, {r.print(), Reg::t(8).print()});
+    auto it = std::find(float_pool.begin(), float_pool.end(), bytes);
+    auto offset = static_cast<int>(std::distance(float_pool.begin(), it)) * 4;
+    if (not IS_IMM_12(offset)) return -1;
+    if (it == float_pool.end()) float_pool.push_back(bytes);
+    return offset;
 }
 
-void CodeGen::store_from_freg(Value* val, const FReg& r)
+void CodeGen::hoist_constants()
 {
-    auto offset = context.offset_map.at(val);
-    if (IS_IMM_12(offset))
+    // 候选：装入需要多条指令的整数常量、非零浮点常量和全局变量地址
+    struct Candidate
+    {
+        Value* val;
+        double benefit;
+    };
+    std::vector<Candidate> candidates;
+    std::unordered_map<Value*, size_t> index;
+    // 提升后每次使用省下的指令数：整数常量和地址 2 条变为 1 条复制，浮点常量 3 条变为 1 条
+    auto add_use = [&](Value* val, double freq) {
+        double saving = dynamic_cast<ConstantFP*>(val) ? 2 : 1;
+        auto it = index.find(val);
+        if (it == index.end())
+        {
+            index[val] = candidates.size();
+            candidates.push_back({val, saving * freq});
+        }
+        else
+        {
+            candidates[it->second].benefit += saving * freq;
+        }
+    };
+    BlockFrequency freq(context.mfunc);
+    for (auto& bb : context.func->get_basic_blocks())
+    {
+        auto bb_freq = freq.get_frequency(context.mbb_map.at(bb));
+        for (auto& instr : bb->get_instructions())
+        {
+            if (instr->get_instr_type() == Instruction::sdiv and dynamic_cast<ConstantInt*>(instr->get_operand(1)))
+            {
+                auto* divisor = dynamic_cast<ConstantInt*>(instr->get_operand(1));
+                // 除以常量时装入的是魔数乘数
+                auto d = divisor->get_value();
+                if (d != 0 and d != INT32_MIN and DIV_LOG2(d) < 0 and d != 1 and d != -1)
+                {
+                    auto multiplier = DIV_MAGIC(d).multiplier;
+                    if (not IS_IMM_12(multiplier)) add_use(ConstantInt::get(multiplier, m), bb_freq);
+                    continue;
+                }
+            }
+            auto& operands = instr->get_operands();
+            for (unsigned i = 0; i < operands.size(); i++)
+            {
+                // phi 的复制在前驱的出边上
+                auto use_freq = bb_freq;
+                if (instr->is_phi())
+                {
+                    if (i % 2 == 1) continue;
+                    use_freq = freq.get_frequency(context.mbb_map.at(operands[i + 1]->as<BasicBlock>()));
+                }
+                auto* op = operands[i];
+                if (auto* c = dynamic_cast<ConstantInt*>(op))
+                {
+                    if (not IS_IMM_12(c->get_value())) add_use(c, use_freq);
+                }
+                else if (auto* c = dynamic_cast<ConstantFP*>(op))
+                {
+                    if (c->get_value() != 0) add_use(c, use_freq);
+                }
+                else if (dynamic_cast<GlobalVariable*>(op))
+                {
+                    add_use(op, use_freq);
+                }
+            }
+        }
+    }
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [](const Candidate& a, const Candidate& b) { return a.benefit > b.benefit; });
+
+    // 收益要超过装入、保存和恢复寄存器的开销
+    const double hoist_cost = 4;
+    unsigned num_gregs = 0;
+    unsigned num_fregs = 0;
+    std::vector<std::pair<float, FReg>> pooled;
+    for (auto& candidate : candidates)
     {
-        auto offset_str = std::to_string(offset);
-        append_inst(FSTORE SINGLE, {r.print(), "$fp", offset_str});
+        if (candidate.benefit <= hoist_cost) break;
+        if (auto* c = dynamic_cast<ConstantFP*>(candidate.val))
+        {
+            if (num_fregs > 7) continue;
+            auto reg = FReg::fs(num_fregs++);
+            uint32_t bytes = 0;
+            float val = c->get_value();
+            memcpy(&bytes, &val, sizeof(float));
+            if (get_float_pool_offset(val) >= 0) pooled.emplace_back(val, reg);
+            else load_float_imm(val, reg);
+            context.hoisted_floats.emplace(bytes, reg);
+            continue;
+        }
+        if (num_gregs > 8) continue;
+        auto reg = Reg::s(num_gregs++);
+        if (auto* c = dynamic_cast<ConstantInt*>(candidate.val))
+        {
+            load_large_int32(c->get_value(), reg);
+            context.hoisted_ints.emplace(c->get_value(), reg);
+        }
+        else
+        {
+            auto* global = static_cast<GlobalVariable*>(candidate.val);
+            append_inst(Op::LA_LOCAL, {reg, MachineOperand::create_symbol(global->get_name())});
+            context.hoisted_globals.emplace(global, reg);
+        }
     }
-    else
+    // 常量池中的浮点常量共用一次 la.local
+    if (not pooled.empty())
     {
-        auto addr = Reg::t(8);
-        load_large_int64(offset, addr);
-        append_inst(ADD DOUBLE, {addr.print(), "$fp", addr.print()});
-        append_inst(FSTORE SINGLE, {r.print(), addr.print(), "0"});
+        append_inst(Op::LA_LOCAL, {Reg::t(8), MachineOperand::create_symbol(FLOAT_POOL_LABEL)});
+        for (auto& [val, reg] : pooled) append_inst(Op::FLD_S, {reg, Reg::t(8), imm(get_float_pool_offset(val))});
     }
+    LOG_INFO << "constant hoisting: " << context.func->get_name() << " " << num_gregs << " integers/addresses, "
+             << num_fregs << " floats hoisted";
 }
 
-void CodeGen::gen_prologue()
+void CodeGen::store_from_freg(Value* val, const FReg& r)
 {
-    if (IS_IMM_12(-static_cast<int>(context.frame_size)))
-    {
-        append_inst("st.d $ra, $sp, -8");
-        append_inst("st.d $fp, $sp, -16");
-        append_inst("addi.d $fp, $sp, 0");
-        append_inst("addi.d $sp, $sp, " +
-                    std::to_string(-static_cast<int>(context.frame_size)));
-    }
-    else
+    append_inst(Op::FST_S, {r, frame_index(context.frame_index_map.at(val)), imm(0)});
+}
+
+void CodeGen::gen_add_lab4_flag(int idx, int val)
+{
+    context.lab4_flags[idx] += val;
+}
+
+void CodeGen::gen_lab4_flags(bool force)
+{
+    // 进入基本块后总会执行到末尾，在块开头一次加上整块的代价，总数与逐条统计相同
+    if (context.lab4_flags[0] == 0 and context.lab4_flags[1] == 0 and not force) return;
+    append_inst(Op::LA_LOCAL, {Reg::t(0), MachineOperand::create_symbol("flags")});
+    for (int idx = 0; idx < 2; idx++)
     {
-        load_large_int64(context.frame_size, Reg::t(0));
-        append_inst("st.d $ra, $sp, -8");
-        append_inst("st.d $fp, $sp, -16");
-        append_inst("sub.d $sp, $sp, $t0");
-        append_inst("add.d $fp, $sp, $t0");
+        auto val = context.lab4_flags[idx];
+        if (val == 0 and not (force and idx == 0)) continue;
+        append_inst(Op::LD_W, {Reg::t(1), Reg::t(0), imm(idx * 4)});
+        if (IS_IMM_12(val))
+        {
+            append_inst(Op::ADDI_W, {Reg::t(1), Reg::t(1), imm(val)});
+        }
+        else
+        {
+            load_large_int32(val, Reg::t(2));
+            append_inst(Op::ADD_W, {Reg::t(1), Reg::t(1), Reg::t(2)});
+        }
+        append_inst(Op::ST_W, {Reg::t(1), Reg::t(0), imm(idx * 4)});
+        context.lab4_flags[idx] = 0;
     }
+}
 
+void CodeGen::gen_prologue()
+{
     int garg_cnt = 0;
     int farg_cnt = 0;
     for (auto arg : context.func->get_args())
@@ -290,48 +609,35 @@ void CodeGen::gen_prologue()
     
     if (context.func->get_name() == "main")
     {
-        int allocate_size = 0;
-        for (auto func : context.func->get_parent()->get_functions())
-        {
-            if (func->is_declaration()) continue;
+        auto allocate_size = get_allocate_size(context.func->get_parent());
 
-            for (auto& bb : func->get_basic_blocks())
-            {
-                for (auto& instr : bb->get_instructions())
-                {
-                    if (instr->is_alloca())
-                    {
-                        auto* alloca_inst = dynamic_cast<AllocaInst*>(instr);
-                        allocate_size += static_cast<int>(alloca_inst->get_alloca_type()->get_size());
-                    }
-                }
-            }
-        }
-
-        load_to_greg(ConstantInt::get(0, m), Reg::a(0));
-        load_to_greg(ConstantInt::get(allocate_size, m), Reg::a(1));
-        append_inst("bl add_lab4_flag");
+        // 总是访问 flags，静态链接时才会带上 io 运行时，在程序结束时输出统计
+        gen_add_lab4_flag(0, allocate_size);
+        gen_lab4_flags(true);
     }
 }
 
 void CodeGen::gen_epilogue()
 {
-    append_inst(context.func->get_name() + "_exit", ASMInstruction::Label);
-    if (IS_IMM_12(-static_cast<int>(context.frame_size)))
+    auto frame_size = static_cast<int>(context.mfunc->get_frame_size());
+    for (auto& [reg, index] : context.callee_saved)
     {
-        append_inst("addi.d $sp, $sp, " + std::to_string(static_cast<int>(context.frame_size)));
-        append_inst("ld.d $ra, $sp, -8");
-        append_inst("ld.d $fp, $sp, -16");
-        append_inst("jr $ra");
+        append_inst(reg.is_greg() ? Op::LD_D : Op::FLD_D, {reg, frame_index(index), imm(0)});
     }
-    else
+    if (frame_size > 0 and IS_IMM_12(frame_size))
+    {
+        append_inst(Op::ADDI_D, {Reg::sp(), Reg::sp(), imm(frame_size)});
+    }
+    else if (frame_size > 0)
     {
-        load_large_int64(context.frame_size, Reg::t(0));
-        append_inst("add.d $sp, $sp, $t0");
-        append_inst("ld.d $ra, $sp, -8");
-        append_inst("ld.d $fp, $sp, -16");
-        append_inst("jr $ra");
+        load_large_int64(frame_size, Reg::t(0));
+        append_inst(Op::ADD_D, {Reg::sp(), Reg::sp(), Reg::t(0)});
     }
+    if (context.mfunc->has_call())
+    {
+        append_inst(Op::LD_D, {Reg::ra(), Reg::sp(), imm(-8)});
+    }
+    append_inst(Op::JR, {Reg::ra()});
 }
 
 
@@ -341,7 +647,7 @@ void CodeGen::gen_ret()
     auto* retType = context.func->get_return_type();
     if (retType->is_void_type())
     {
-        append_inst("addi.w  $a0, $zero, 0");
+        append_inst(Op::ADDI_W, {Reg::a(0), Reg::zero(), imm(0)});
     }
     else if (retType->is_float_type())
     {
@@ -351,45 +657,178 @@ void CodeGen::gen_ret()
     {
         load_to_greg(retInst->get_operand(0), Reg::a(0));
     }
-    std::string label = context.func->get_name() + "_exit";
-    append_inst("b " + label);
+    append_inst(Op::B, {context.mfunc->get_exit_block()});
+    context.mbb->add_succ_basic_block(context.mfunc->get_exit_block());
 }
 
+// 分支目标有 phi 时，复制放在对应的出边上，需要复制的出边拆分为单独的基本块：
+// 假分支的边块紧跟在 bb 之后（落入），真分支的边块再放在其后
 void CodeGen::gen_br()
 {
     auto* branchInst = dynamic_cast<BranchInst*>(context.inst);
-    if (branchInst->is_cond_br())
+    auto* mbb = context.mbb;
+    if (not branchInst->is_cond_br() or branchInst->get_operand(1) == branchInst->get_operand(2))
     {
-        load_to_greg(branchInst->get_operand(0), Reg::t(0));
-        auto* trueBB = dynamic_cast<BasicBlock*>(branchInst->get_operand(1));
-        auto* falseBB = dynamic_cast<BasicBlock*>(branchInst->get_operand(2));
-        append_inst("bnez", {Reg::t(0).print(), trueBB->get_name()});
-        append_inst("b", {falseBB->get_name()});
+        auto* branchbb = dynamic_cast<BasicBlock*>(branchInst->get_operand(branchInst->is_cond_br() ? 1 : 0));
+        copy_stmt(branchbb);
+        append_inst(Op::B, {context.mbb_map.at(branchbb)});
+        mbb->add_succ_basic_block(context.mbb_map.at(branchbb));
+        return;
     }
-    else
+    auto* trueBB = dynamic_cast<BasicBlock*>(branchInst->get_operand(1));
+    auto* falseBB = dynamic_cast<BasicBlock*>(branchInst->get_operand(2));
+    auto create_edge = [&](BasicBlock* succ, MachineBasicBlock* after) {
+        auto* edge = MachineBasicBlock::create(context.bb->get_name() + "_" + succ->get_name() + "_edge",
+                                               context.mfunc);
+        context.mfunc->move_basic_block_after(edge, after);
+        return edge;
+    };
+    auto* false_edge = has_phi_copy(falseBB) ? create_edge(falseBB, mbb) : nullptr;
+    auto* true_edge = has_phi_copy(trueBB) ? create_edge(trueBB, false_edge ? false_edge : mbb) : nullptr;
+    auto* true_target = true_edge ? true_edge : context.mbb_map.at(trueBB);
+    gen_cond_branch(branchInst, true_target);
+    mbb->add_succ_basic_block(true_target);
+    if (false_edge)
+    {
+        mbb->add_succ_basic_block(false_edge);
+        set_insert_point(false_edge);
+    }
+    copy_stmt(falseBB);
+    append_inst(Op::B, {context.mbb_map.at(falseBB)});
+    context.mbb->add_succ_basic_block(context.mbb_map.at(falseBB));
+    if (true_edge)
+    {
+        set_insert_point(true_edge);
+        copy_stmt(trueBB);
+        append_inst(Op::B, {context.mbb_map.at(trueBB)});
+        true_edge->add_succ_basic_block(context.mbb_map.at(trueBB));
+    }
+    set_insert_point(mbb);
+}
+
+// 比较只被同一基本块的条件跳转使用时，不生成 0/1 值，由跳转直接比较
+void CodeGen::gen_cond_branch(BranchInst* br, MachineBasicBlock* target)
+{
+    bool negate = false;
+    auto* cmp = find_fused_cmp(br, negate);
+    if (cmp == nullptr)
     {
-        auto* branchbb = dynamic_cast<BasicBlock*>(branchInst->get_operand(0));
-        append_inst("b " + branchbb->get_name());
+        load_to_greg(br->get_condition(), Reg::t(0));
+        append_inst(Op::BNEZ, {Reg::t(0), target});
+        return;
+    }
+    auto op = cmp->get_instr_type();
+    if (cmp->is_fcmp())
+    {
+        load_to_freg(cmp->get_operand(0), FReg::ft(0));
+        load_to_freg(cmp->get_operand(1), FReg::ft(1));
+        gen_fcmp_flag(op);
+        append_inst(negate ? Op::BCEQZ : Op::BCNEZ, {CFReg(0), target});
+        return;
+    }
+    // 与常量 0 比较时直接使用 $zero
+    auto operand = [this](Value* val, const Reg& reg) {
+        auto* c = dynamic_cast<ConstantInt*>(val);
+        if (c != nullptr and c->get_value() == 0) return Reg::zero();
+        load_to_greg(val, reg);
+        return reg;
+    };
+    auto lhs = operand(cmp->get_operand(0), Reg::t(0));
+    auto rhs = operand(cmp->get_operand(1), Reg::t(1));
+    if (negate)
+    {
+        switch (op)
+        {
+            case Instruction::ge: op = Instruction::lt; break;
+            case Instruction::gt: op = Instruction::le; break;
+            case Instruction::le: op = Instruction::gt; break;
+            case Instruction::lt: op = Instruction::ge; break;
+            case Instruction::eq: op = Instruction::ne; break;
+            case Instruction::ne: op = Instruction::eq; break;
+            default: assert(false);
+        }
+    }
+    switch (op)
+    {
+        case Instruction::ge: append_inst(Op::BGE, {lhs, rhs, target}); break;
+        case Instruction::gt: append_inst(Op::BLT, {rhs, lhs, target}); break;
+        case Instruction::le: append_inst(Op::BGE, {rhs, lhs, target}); break;
+        case Instruction::lt: append_inst(Op::BLT, {lhs, rhs, target}); break;
+        case Instruction::eq: append_inst(Op::BEQ, {lhs, rhs, target}); break;
+        case Instruction::ne: append_inst(Op::BNE, {lhs, rhs, target}); break;
+        default: assert(false);
     }
 }
 
+Instruction* CodeGen::find_fused_cmp(BranchInst* br, bool& negate) const
+{
+    auto single_local_use = [br](Value* val) {
+        auto* inst = dynamic_cast<Instruction*>(val);
+        return inst != nullptr and inst->get_parent() == br->get_parent() and inst->get_use_list().size() == 1;
+    };
+    negate = false;
+    auto* cond = br->get_condition();
+    if (not single_local_use(cond)) return nullptr;
+    auto* cmp = dynamic_cast<Instruction*>(cond);
+    if (not cmp->is_cmp() and not cmp->is_fcmp()) return nullptr;
+    // 前端生成的 icmp ne (zext c), 0 或 icmp eq (zext c), 0
+    auto* zero = dynamic_cast<ConstantInt*>(cmp->get_operand(1));
+    auto* zext = dynamic_cast<Instruction*>(cmp->get_operand(0));
+    if ((cmp->get_instr_type() == Instruction::ne or cmp->get_instr_type() == Instruction::eq) and
+        zero != nullptr and zero->get_value() == 0 and single_local_use(zext) and zext->is_zext() and
+        single_local_use(zext->get_operand(0)))
+    {
+        auto* inner = zext->get_operand(0)->as<Instruction>();
+        if (inner->is_cmp() or inner->is_fcmp())
+        {
+            negate = cmp->get_instr_type() == Instruction::eq;
+            return inner;
+        }
+    }
+    return cmp;
+}
+
+bool CodeGen::has_phi_copy(BasicBlock* succ) const
+{
+    for (auto& inst : succ->get_instructions())
+    {
+        if (not inst->is_phi()) break;
+        for (unsigned i = 1; i < inst->get_operands().size(); i += 2)
+        {
+            if (inst->get_operand(i) == context.bb and inst->get_operand(i - 1) != inst) return true;
+        }
+    }
+    return false;
+}
+
 void CodeGen::gen_binary()
 {
+    // 除以常量时用乘法和移位代替除法
+    auto* divisor = dynamic_cast<ConstantInt*>(context.inst->get_operand(1));
+    if (context.inst->get_instr_type() == Instruction::sdiv and divisor != nullptr and
+        divisor->get_value() != 0 and divisor->get_value() != INT32_MIN)
+    {
+        load_to_greg(context.inst->get_operand(0), Reg::t(0));
+        bool use_mul = gen_div_by_const(divisor->get_value());
+        store_from_greg(context.inst, Reg::t(2));
+        if (use_mul) gen_add_lab4_flag(1, 1);
+        return;
+    }
     load_to_greg(context.inst->get_operand(0), Reg::t(0));
     load_to_greg(context.inst->get_operand(1), Reg::t(1));
     switch (context.inst->get_instr_type())
     {
         case Instruction::add:
-            output.emplace_back("add.w $t2, $t0, $t1");
+            append_inst(Op::ADD_W, {Reg::t(2), Reg::t(0), Reg::t(1)});
             break;
         case Instruction::sub:
-            output.emplace_back("sub.w $t2, $t0, $t1");
+            append_inst(Op::SUB_W, {Reg::t(2), Reg::t(0), Reg::t(1)});
             break;
         case Instruction::mul:
-            output.emplace_back("mul.w $t2, $t0, $t1");
+            append_inst(Op::MUL_W, {Reg::t(2), Reg::t(0), Reg::t(1)});
             break;
         case Instruction::sdiv:
-            output.emplace_back("div.w $t2, $t0, $t1");
+            append_inst(Op::DIV_W, {Reg::t(2), Reg::t(0), Reg::t(1)});
             break;
         default:
             assert(false);
@@ -397,18 +836,58 @@ void CodeGen::gen_binary()
     store_from_greg(context.inst, Reg::t(2));
     if (context.inst->get_instr_type() == Instruction::mul)
     {
-        load_to_greg(ConstantInt::get(1, m), Reg::a(0));
-        load_to_greg(ConstantInt::get(1, m), Reg::a(1));
-        append_inst("bl add_lab4_flag");
+        gen_add_lab4_flag(1, 1);
     }
     if (context.inst->get_instr_type() == Instruction::sdiv)
     {
-        load_to_greg(ConstantInt::get(1, m), Reg::a(0));
-        load_to_greg(ConstantInt::get(4, m), Reg::a(1));
-        append_inst("bl add_lab4_flag");
+        gen_add_lab4_flag(1, 4);
     }
 }
 
+bool CodeGen::gen_div_by_const(MachineBasicBlock* bb, int32_t d)
+{
+    set_insert_point(bb);
+    return gen_div_by_const(d);
+}
+
+bool CodeGen::gen_div_by_const(int32_t d)
+{
+    auto n = Reg::t(0);
+    auto q = Reg::t(2);
+    auto tmp = Reg::t(1);
+    if (d == 1)
+    {
+        append_inst(Op::ADD_W, {q, n, Reg::zero()});
+        return false;
+    }
+    if (d == -1)
+    {
+        append_inst(Op::SUB_W, {q, Reg::zero(), n});
+        return false;
+    }
+    int k = DIV_LOG2(d);
+    if (k > 0)
+    {
+        // 负数被除数加上 2^k - 1，使算术右移向零取整
+        append_inst(Op::SRAI_W, {tmp, n, imm(31)});
+        append_inst(Op::SRLI_W, {tmp, tmp, imm(32 - k)});
+        append_inst(Op::ADD_W, {tmp, n, tmp});
+        append_inst(Op::SRAI_W, {q, tmp, imm(k)});
+        if (d < 0) append_inst(Op::SUB_W, {q, Reg::zero(), q});
+        return false;
+    }
+    auto magic = DIV_MAGIC(d);
+    load_to_greg(ConstantInt::get(magic.multiplier, m), tmp);
+    append_inst(Op::MULH_W, {q, n, tmp});
+    if (d > 0 and magic.multiplier < 0) append_inst(Op::ADD_W, {q, q, n});
+    if (d < 0 and magic.multiplier > 0) append_inst(Op::SUB_W, {q, q, n});
+    if (magic.shift > 0) append_inst(Op::SRAI_W, {q, q, imm(magic.shift)});
+    // 商为负时加一，向零取整
+    append_inst(Op::SRLI_W, {tmp, q, imm(31)});
+    append_inst(Op::ADD_W, {q, q, tmp});
+    return true;
+}
+
 void CodeGen::gen_float_binary()
 {
     auto* floatInst = dynamic_cast<FBinaryInst*>(context.inst);
@@ -420,16 +899,16 @@ void CodeGen::gen_float_binary()
     switch (op)
     {
         case Instruction::fadd:
-            append_inst("fadd.s", {FReg::ft(0).print(), FReg::ft(1).print(), FReg::ft(2).print()});
+            append_inst(Op::FADD_S, {FReg::ft(0), FReg::ft(1), FReg::ft(2)});
             break;
         case Instruction::fsub:
-            append_inst("fsub.s", {FReg::ft(0).print(), FReg::ft(1).print(), FReg::ft(2).print()});
+            append_inst(Op::FSUB_S, {FReg::ft(0), FReg::ft(1), FReg::ft(2)});
             break;
         case Instruction::fmul:
-            append_inst("fmul.s", {FReg::ft(0).print(), FReg::ft(1).print(), FReg::ft(2).print()});
+            append_inst(Op::FMUL_S, {FReg::ft(0), FReg::ft(1), FReg::ft(2)});
             break;
         case Instruction::fdiv:
-            append_inst("fdiv.s", {FReg::ft(0).print(), FReg::ft(1).print(), FReg::ft(2).print()});
+            append_inst(Op::FDIV_S, {FReg::ft(0), FReg::ft(1), FReg::ft(2)});
             break;
         default:
             std::cout << "wrong gen_float_binary\n";
@@ -438,30 +917,18 @@ void CodeGen::gen_float_binary()
     store_from_freg(context.inst, FReg::ft(0));
     if (context.inst->get_instr_type() == Instruction::fmul)
     {
-        load_to_greg(ConstantInt::get(1, m), Reg::a(0));
-        load_to_greg(ConstantInt::get(1, m), Reg::a(1));
-        append_inst("bl add_lab4_flag");
+        gen_add_lab4_flag(1, 1);
     }
     if (context.inst->get_instr_type() == Instruction::fdiv)
     {
-        load_to_greg(ConstantInt::get(1, m), Reg::a(0));
-        load_to_greg(ConstantInt::get(4, m), Reg::a(1));
-        append_inst("bl add_lab4_flag");
+        gen_add_lab4_flag(1, 4);
     }
 }
 
 void CodeGen::gen_alloca()
 {
     auto* allocaInst = dynamic_cast<AllocaInst*>(context.inst);
-    auto offset = context.offset_map[allocaInst];
-    auto trueOffset = offset - static_cast<int>(allocaInst->get_alloca_type()->get_size());
-    if (IS_IMM_12(trueOffset))
-        append_inst("addi.d", {Reg::t(0).print(), "$fp", std::to_string(trueOffset)});
-    else
-    {
-        load_to_greg(ConstantInt::get(trueOffset, m), Reg::t(1));
-        append_inst("add.d", {Reg::t(0).print(), "$fp", Reg::t(1).print()});
-    }
+    append_inst(Op::ADDI_D, {Reg::t(0), frame_index(context.alloca_map.at(allocaInst)), imm(0)});
     store_from_greg(allocaInst, Reg::t(0));
 }
 
@@ -473,28 +940,26 @@ void CodeGen::gen_load()
 
     if (type->is_float_type())
     {
-        append_inst("fld.s $ft0, $t0, 0");
+        append_inst(Op::FLD_S, {FReg::ft(0), Reg::t(0), imm(0)});
         store_from_freg(context.inst, FReg::ft(0));
     }
     else if (type->is_int32_type())
     {
-        append_inst("ld.w $t0, $t0, 0");
+        append_inst(Op::LD_W, {Reg::t(0), Reg::t(0), imm(0)});
         store_from_greg(context.inst, Reg::t(0));
     }
     else if (type->is_int1_type())
     {
-        append_inst("ld.b $t0, $t0, 0");
+        append_inst(Op::LD_B, {Reg::t(0), Reg::t(0), imm(0)});
         store_from_greg(context.inst, Reg::t(0));
     }
     else
     {
-        append_inst("ld.d $t0, $t0, 0");
+        append_inst(Op::LD_D, {Reg::t(0), Reg::t(0), imm(0)});
         store_from_greg(context.inst, Reg::t(0));
     }
     if (ptr->is<AllocaInst>() && !((ptr->as<AllocaInst>())->get_alloca_type()->is_array_type())) return;
-    load_to_greg(ConstantInt::get(1, m), Reg::a(0));
-    load_to_greg(ConstantInt::get(3, m), Reg::a(1));
-    append_inst("bl add_lab4_flag");
+    gen_add_lab4_flag(1, 3);
 }
 
 void CodeGen::gen_store()
@@ -506,22 +971,22 @@ void CodeGen::gen_store()
     if (value->get_type()->is_float_type())
     {
         load_to_freg(value, FReg::ft(0));
-        append_inst("fst.s $ft0, $t0, 0");
+        append_inst(Op::FST_S, {FReg::ft(0), Reg::t(0), imm(0)});
     }
     else if (value->get_type()->is_int32_type())
     {
         load_to_greg(value, Reg::t(1));
-        append_inst("st.w $t1, $t0, 0");
+        append_inst(Op::ST_W, {Reg::t(1), Reg::t(0), imm(0)});
     }
     else if (value->get_type()->is_int1_type())
     {
         load_to_greg(value, Reg::t(1));
-        append_inst("st.b $t1, $t0, 0");
+        append_inst(Op::ST_B, {Reg::t(1), Reg::t(0), imm(0)});
     }
     else
     {
         load_to_greg(value, Reg::t(1));
-        append_inst("st.d $t1, $t0, 0");
+        append_inst(Op::ST_D, {Reg::t(1), Reg::t(0), imm(0)});
     }
 }
 
@@ -529,76 +994,80 @@ void CodeGen::gen_icmp()
 {
     auto* icmpInst = dynamic_cast<ICmpInst*>(context.inst);
     auto op = icmpInst->get_instr_type();
-    load_to_greg(icmpInst->get_operand(0), Reg::t(0));
-    load_to_greg(icmpInst->get_operand(1), Reg::t(1));
+    auto t0 = Reg::t(0);
+    auto t1 = Reg::t(1);
+    load_to_greg(icmpInst->get_operand(0), t0);
+    load_to_greg(icmpInst->get_operand(1), t1);
     switch (op)
     {
         case Instruction::ge:
-            append_inst("slt $t0, $t0, $t1");
-            append_inst("addi.d $t1, $zero, 1");
-            append_inst("xor $t0, $t0, $t1");
+            append_inst(Op::SLT, {t0, t0, t1});
+            append_inst(Op::ADDI_D, {t1, Reg::zero(), imm(1)});
+            append_inst(Op::XOR, {t0, t0, t1});
             break;
         case Instruction::gt:
-            append_inst("slt $t0, $t1, $t0");
+            append_inst(Op::SLT, {t0, t1, t0});
             break;
         case Instruction::le:
-            append_inst("slt $t0, $t1, $t0");
-            append_inst("addi.d $t1, $zero, 1");
-            append_inst("xor $t0, $t0, $t1");
+            append_inst(Op::SLT, {t0, t1, t0});
+            append_inst(Op::ADDI_D, {t1, Reg::zero(), imm(1)});
+            append_inst(Op::XOR, {t0, t0, t1});
             break;
         case Instruction::lt:
-            append_inst("slt $t0, $t0, $t1");
+            append_inst(Op::SLT, {t0, t0, t1});
             break;
         case Instruction::eq:
-            append_inst("xor $t0, $t0, $t1");
-            append_inst("sltu $t0, $zero, $t0");
-            append_inst("addi.d $t1, $zero, 1");
-            append_inst("xor $t0, $t0, $t1");
+            append_inst(Op::XOR, {t0, t0, t1});
+            append_inst(Op::SLTU, {t0, Reg::zero(), t0});
+            append_inst(Op::ADDI_D, {t1, Reg::zero(), imm(1)});
+            append_inst(Op::XOR, {t0, t0, t1});
             break;
         case Instruction::ne:
-            append_inst("xor $t0, $t0, $t1");
-            append_inst("sltu $t0, $zero, $t0");
+            append_inst(Op::XOR, {t0, t0, t1});
+            append_inst(Op::SLTU, {t0, Reg::zero(), t0});
             break;
         default:
             std::cout << "wrong icmp\n";
             break;
     }
-    store_from_greg(icmpInst, Reg::t(0));
+    store_from_greg(icmpInst, t0);
 }
 
-void CodeGen::gen_fcmp()
+void CodeGen::gen_fcmp_flag(Instruction::OpID op)
 {
-    auto* fcmpInst = dynamic_cast<FCmpInst*>(context.inst);
-    auto op = fcmpInst->get_instr_type();
-    load_to_freg(fcmpInst->get_operand(0), FReg::ft(0));
-    load_to_freg(fcmpInst->get_operand(1), FReg::ft(1));
+    auto fcc0 = CFReg(0);
     switch (op)
     {
         case Instruction::fge:
-            append_inst("fcmp.sle.s $fcc0, $ft1, $ft0");
+            append_inst(Op::FCMP_SLE_S, {fcc0, FReg::ft(1), FReg::ft(0)});
             break;
         case Instruction::fgt:
-            append_inst("fcmp.slt.s $fcc0, $ft1, $ft0");
+            append_inst(Op::FCMP_SLT_S, {fcc0, FReg::ft(1), FReg::ft(0)});
             break;
         case Instruction::fle:
-            append_inst("fcmp.sle.s $fcc0, $ft0, $ft1");
+            append_inst(Op::FCMP_SLE_S, {fcc0, FReg::ft(0), FReg::ft(1)});
             break;
         case Instruction::flt:
-            append_inst("fcmp.slt.s $fcc0, $ft0, $ft1");
+            append_inst(Op::FCMP_SLT_S, {fcc0, FReg::ft(0), FReg::ft(1)});
             break;
         case Instruction::feq:
-            append_inst("fcmp.seq.s $fcc0, $ft0, $ft1");
+            append_inst(Op::FCMP_SEQ_S, {fcc0, FReg::ft(0), FReg::ft(1)});
             break;
         case Instruction::fne:
-            append_inst("fcmp.sne.s $fcc0, $ft0, $ft1");
+            append_inst(Op::FCMP_SNE_S, {fcc0, FReg::ft(0), FReg::ft(1)});
             break;
         default:
             break;
     }
-    append_inst("bceqz", {"$fcc0", "0XC"});
-    append_inst("addi.w $t0, $zero, 1");
-    append_inst("b 0x8");
-    append_inst("addi.w $t0, $zero, 0");
+}
+
+void CodeGen::gen_fcmp()
+{
+    auto* fcmpInst = dynamic_cast<FCmpInst*>(context.inst);
+    load_to_freg(fcmpInst->get_operand(0), FReg::ft(0));
+    load_to_freg(fcmpInst->get_operand(1), FReg::ft(1));
+    gen_fcmp_flag(fcmpInst->get_instr_type());
+    append_inst(Op::MOVCF2GR, {Reg::t(0), CFReg(0)});
     store_from_greg(context.inst, Reg::t(0));
 }
 
@@ -606,7 +1075,7 @@ void CodeGen::gen_zext()
 {
     auto* zextInst = dynamic_cast<ZextInst*>(context.inst);
     load_to_greg(zextInst->get_operand(0), Reg::t(0));
-    append_inst("bstrpick.w $t0, $t0, 7, 0");
+    append_inst(Op::BSTRPICK_W, {Reg::t(0), Reg::t(0), imm(7), imm(0)});
     store_from_greg(context.inst, Reg::t(0));
 }
 
@@ -631,7 +1100,7 @@ void CodeGen::gen_call()
         }
     }
     auto* func = dynamic_cast<Function*>(callInst->get_operand(0));
-    append_inst("bl", {func->get_name()});
+    append_inst(Op::BL, {MachineOperand::create_symbol(func->get_name())});
     auto retType = functionType->get_return_type();
     if (retType->is_integer_type())
     {
@@ -650,29 +1119,27 @@ void CodeGen::gen_gep()
     load_to_greg(getElementPtrInst->get_operand(0), Reg::t(0));
     load_to_greg(getElementPtrInst->get_operand(num - 1), Reg::t(1));
     auto elementType = getElementPtrInst->get_element_type();
-    append_inst("addi.d $t2, $zero, 4");
+    append_inst(Op::ADDI_D, {Reg::t(2), Reg::zero(), imm(4)});
     if (elementType->is_float_type() || elementType->is_int32_type())
     {
-        append_inst("mul.d $t1, $t1, $t2");
+        append_inst(Op::MUL_D, {Reg::t(1), Reg::t(1), Reg::t(2)});
     }
     else
     {
-        append_inst("addi.d $t2, $zero, 8");
-        append_inst("mul.d $t1, $t1, $t2");
+        append_inst(Op::ADDI_D, {Reg::t(2), Reg::zero(), imm(8)});
+        append_inst(Op::MUL_D, {Reg::t(1), Reg::t(1), Reg::t(2)});
     }
-    append_inst("add.d $t2, $t1, $t0");
+    append_inst(Op::ADD_D, {Reg::t(2), Reg::t(1), Reg::t(0)});
     store_from_greg(context.inst, Reg::t(2));
-    load_to_greg(ConstantInt::get(1, m), Reg::a(0));
-    load_to_greg(ConstantInt::get(1, m), Reg::a(1));
-    append_inst("bl add_lab4_flag");
+    gen_add_lab4_flag(1, 1);
 }
 
 void CodeGen::gen_sitofp()
 {
     auto* sitofpInst = dynamic_cast<SiToFpInst*>(context.inst);
     load_to_greg(sitofpInst->get_operand(0), Reg::t(0));
-    append_inst("movgr2fr.w $ft0, $t0");
-    append_inst("ffint.s.w $ft1, $ft0");
+    append_inst(Op::MOVGR2FR_W, {FReg::ft(0), Reg::t(0)});
+    append_inst(Op::FFINT_S_W, {FReg::ft(1), FReg::ft(0)});
     store_from_freg(context.inst, FReg::ft(1));
 }
 
@@ -680,58 +1147,103 @@ void CodeGen::gen_fptosi()
 {
     auto* fptosiInst = dynamic_cast<FpToSiInst*>(context.inst);
     load_to_freg(fptosiInst->get_operand(0), FReg::ft(0));
-    append_inst("ftintrz.w.s $ft1, $ft0");
-    append_inst("movfr2gr.s $t0, $ft1");
+    append_inst(Op::FTINTRZ_W_S, {FReg::ft(1), FReg::ft(0)});
+    append_inst(Op::MOVFR2GR_S, {Reg::t(0), FReg::ft(1)});
     store_from_greg(context.inst, Reg::t(0));
 }
 
-void CodeGen::run()
+void CodeGen::gen_select()
 {
-    m->set_print_name();
-    if (!m->get_global_variable().empty())
+    auto* selectInst = dynamic_cast<SelectInst*>(context.inst);
+    if (selectInst->get_type()->is_float_type())
     {
-        append_inst("Global variables", ASMInstruction::Comment);
-        append_inst(".text", ASMInstruction::Attribute);
-        append_inst(".section", {".bss", "\"aw\"", "@nobits"},
-                    ASMInstruction::Attribute);
-        for (auto global : m->get_global_variable())
-        {
-            auto size = global->get_type()->get_pointer_element_type()->get_size();
-            append_inst(".globl", {global->get_name()},
-                        ASMInstruction::Attribute);
-            append_inst(".type", {global->get_name(), "@object"},
-                        ASMInstruction::Attribute);
-            append_inst(".size", {global->get_name(), std::to_string(size)},
-                        ASMInstruction::Attribute);
-            append_inst(global->get_name(), ASMInstruction::Label);
-            append_inst(".space", {std::to_string(size)},
-                        ASMInstruction::Attribute);
-        }
+        // fsel fd, fj, fk, ca: ca 为真时取 fk，否则取 fj
+        load_to_freg(selectInst->get_false_value(), FReg::ft(0));
+        load_to_freg(selectInst->get_true_value(), FReg::ft(1));
+        load_to_greg(selectInst->get_condition(), Reg::t(0));
+        append_inst(Op::MOVGR2CF, {CFReg(0), Reg::t(0)});
+        append_inst(Op::FSEL, {FReg::ft(2), FReg::ft(0), FReg::ft(1), CFReg(0)});
+        store_from_freg(context.inst, FReg::ft(2));
+    }
+    else
+    {
+        // maskeqz 在条件为 0 时清零，masknez 在条件非 0 时清零，两者恰有一个保留原值
+        load_to_greg(selectInst->get_condition(), Reg::t(0));
+        load_to_greg(selectInst->get_true_value(), Reg::t(1));
+        load_to_greg(selectInst->get_false_value(), Reg::t(2));
+        append_inst(Op::MASKEQZ, {Reg::t(1), Reg::t(1), Reg::t(0)});
+        append_inst(Op::MASKNEZ, {Reg::t(2), Reg::t(2), Reg::t(0)});
+        append_inst(Op::OR, {Reg::t(0), Reg::t(1), Reg::t(2)});
+        store_from_greg(context.inst, Reg::t(0));
     }
+}
 
-    output.emplace_back(".text", ASMInstruction::Attribute);
+void CodeGen::run()
+{
+    m->set_print_name();
     for (auto func : m->get_functions())
     {
         if (not func->is_declaration())
         {
             context.clear();
             context.func = func;
+            context.mfunc = new MachineFunction(func);
+            mfuncs.push_back(context.mfunc);
 
-            append_inst(".globl", {func->get_name()}, ASMInstruction::Attribute);
-            append_inst(".type", {func->get_name(), "@function"},
-                        ASMInstruction::Attribute);
-            append_inst(func->get_name(), ASMInstruction::Label);
+            // 序言块以函数名为标签，出口块放在最后
+            auto* prologue = MachineBasicBlock::create(func->get_name(), context.mfunc);
+            for (auto& bb : func->get_basic_blocks())
+            {
+                context.mbb_map[bb] = MachineBasicBlock::create(bb->get_name(), context.mfunc, bb);
+            }
+            context.mfunc->set_exit_block(MachineBasicBlock::create(func->get_name() + "_exit", context.mfunc));
+            prologue->add_succ_basic_block(context.mbb_map.at(func->get_entry_block()));
 
             allocate();
+            set_insert_point(prologue);
             gen_prologue();
+            if (options.const_hoist) hoist_constants();
+
+            // 与条件跳转融合的比较及 zext 不单独生成
+            for (auto& bb : func->get_basic_blocks())
+            {
+                auto* br = dynamic_cast<BranchInst*>(bb->get_terminator());
+                if (br == nullptr or not br->is_cond_br()) continue;
+                bool negate;
+                auto* cmp = find_fused_cmp(br, negate);
+                if (cmp == nullptr) continue;
+                for (Value* val = br->get_condition(); val != cmp;
+                     val = val->as<Instruction>()->get_operand(0))
+                {
+                    context.fused_insts.insert(val->as<Instruction>());
+                }
+                context.fused_insts.insert(cmp);
+            }
 
             for (auto& bb : func->get_basic_blocks())
             {
                 context.bb = bb;
-                append_inst(context.bb->get_name(), ASMInstruction::Label);
+                set_insert_point(context.mbb_map.at(bb));
+                if (options.const_hoist)
+                {
+                    // 两次调用之间使用至少三次的未提升的全局变量，地址缓存在 $t3-$t7 中
+                    std::unordered_map<GlobalVariable*, int> global_uses;
+                    context.reused_globals.clear();
+                    for (auto& instr : bb->get_instructions())
+                    {
+                        for (auto* op : instr->get_operands())
+                        {
+                            auto* global = dynamic_cast<GlobalVariable*>(op);
+                            if (global == nullptr or context.hoisted_globals.count(global)) continue;
+                            if (++global_uses[global] == 3) context.reused_globals.insert(global);
+                        }
+                        if (instr->is_call()) global_uses.clear();
+                    }
+                }
                 for (auto& instr : bb->get_instructions())
                 {
-                    append_inst(instr->print(), ASMInstruction::Comment);
+                    append_comment(instr->print());
+                    if (context.fused_insts.count(instr)) continue;
                     context.inst = instr;
                     switch (instr->get_instr_type())
                     {
@@ -739,7 +1251,6 @@ void CodeGen::run()
                             gen_ret();
                             break;
                         case Instruction::br:
-                            copy_stmt();
                             gen_br();
                             break;
                         case Instruction::add:
@@ -796,20 +1307,83 @@ void CodeGen::run()
                         case Instruction::sitofp:
                             gen_sitofp();
                             break;
+                        case Instruction::select:
+                            gen_select();
+                            break;
                     }
                 }
+                auto* mbb = context.mbb_map.at(bb);
+                set_insert_point(mbb, mbb->get_instructions().begin());
+                gen_lab4_flags();
             }
-            gen_epilogue();
         }
     }
+
+    if (options.peephole)
+    {
+        Peephole peephole(mfuncs);
+        peephole.run();
+    }
+    if (options.stack_coloring)
+    {
+        StackColoring stack_coloring(mfuncs);
+        stack_coloring.run();
+    }
+    if (options.block_placement)
+    {
+        BlockPlacement block_placement(mfuncs);
+        block_placement.run();
+    }
+    if (options.schedule)
+    {
+        InstrScheduler scheduler(mfuncs);
+        scheduler.run();
+    }
+    for (auto* mfunc : mfuncs)
+    {
+        context.clear();
+        context.mfunc = mfunc;
+        lower_frame();
+    }
+    if (options.schedule)
+    {
+        InstrScheduler scheduler(mfuncs);
+        scheduler.run();
+    }
 }
 
 std::string CodeGen::print() const
 {
     std::string result;
-    for (const auto& inst : output)
+    if (!m->get_global_variable().empty())
+    {
+        result += "# Global variables\n";
+        result += "\t.text\n";
+        result += "\t.section .bss, \"aw\", @nobits\n";
+        for (auto global : m->get_global_variable())
+        {
+            auto size = std::to_string(global->get_type()->get_pointer_element_type()->get_size());
+            result += "\t.globl " + global->get_name() + "\n";
+            result += "\t.type " + global->get_name() + ", @object\n";
+            result += "\t.size " + global->get_name() + ", " + size + "\n";
+            result += global->get_name() + ":\n";
+            result += "\t.space " + size + "\n";
+        }
+    }
+
+    if (not float_pool.empty())
+    {
+        result += "# Float constants\n";
+        result += "\t.section .rodata\n";
+        result += "\t.align 2\n";
+        result += std::string(FLOAT_POOL_LABEL) + ":\n";
+        for (auto bits : float_pool) result += "\t.word " + std::to_string(bits) + "\n";
+    }
+
+    result += "\t.text\n";
+    for (auto* mfunc : mfuncs)
     {
-        result += inst.format();
+        result += mfunc->print();
     }
     return result;
 }
@@ -0,0 +1,277 @@
+#include "InstrScheduler.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+#include "logging.hpp"
+
+using Op = MachineInstr::Opcode;
+
+namespace
+{
+// LA464 上各指令从发射到结果可用的周期数，顺序与 MachineInstr::Opcode 一致。
+// 除法和浮点除法的延迟与操作数有关，这里取典型值；la.local 展开为 pcalau12i 和 addi.d 两条
+const unsigned latency_table[] = {
+    0,                                                     // COMMENT
+    1, 1, 1, 1,                                            // add.w add.d sub.w sub.d
+    4, 4, 4, 12,                                           // mul.w mul.d mulh.w div.w
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,                       // addi.w addi.d slt sltu slti and or xor andi ori xori
+    1, 1, 1, 1, 1, 1, 1,                                   // slli.w srli.w srai.w slli.d lu12i.w lu32i.d lu52i.d
+    1, 1, 1, 2,                                            // bstrpick.w maskeqz masknez la.local
+    4, 4, 4,                                               // ld.b ld.w ld.d
+    1, 1, 1,                                               // st.b st.w st.d
+    5, 1, 5, 1,                                            // fld.s fst.s fld.d fst.d
+    4, 4, 4, 10,                                           // fadd.s fsub.s fmul.s fdiv.s
+    2, 2, 2, 2,                                            // fcmp.*.s
+    1, 2, 2, 2, 2, 4, 4, 2,                                // fmov.s movgr2fr.w movfr2gr.s movgr2cf movcf2gr ffint.s.w ftintrz.w.s fsel
+    1, 1, 1,                                               // b bl jr
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1,                          // 条件跳转
+};
+
+static_assert(sizeof(latency_table) / sizeof(latency_table[0]) == MachineInstr::BCNEZ + 1,
+              "latency_table 与 MachineInstr::Opcode 不一致");
+
+unsigned access_width(Op op)
+{
+    switch (op)
+    {
+        case Op::LD_B:
+        case Op::ST_B: return 1;
+        case Op::LD_D:
+        case Op::ST_D:
+        case Op::FLD_D:
+        case Op::FST_D: return 8;
+        default: return 4;
+    }
+}
+
+// 访存指令访问的位置：栈帧对象或 $sp 加偏移，其余基址的位置未知
+struct MemRef
+{
+    enum Base : uint8_t { unknown, frame_index, sp };
+    Base base{unknown};
+    int index{0};
+    int64_t offset{0};
+    unsigned width{0};
+    // 地址没有被取出的栈帧对象，只能通过栈帧对象访问
+    bool is_private{false};
+};
+
+bool may_alias(const MemRef& a, const MemRef& b)
+{
+    if (a.is_private and b.base != MemRef::frame_index) return false;
+    if (b.is_private and a.base != MemRef::frame_index) return false;
+    if (a.base == MemRef::unknown or a.base != b.base) return true;
+    if (a.base == MemRef::frame_index and a.index != b.index) return false;
+    return a.offset < b.offset + static_cast<int64_t>(b.width) and b.offset < a.offset + static_cast<int64_t>(a.width);
+}
+
+struct Node
+{
+    MachineInstr* instr;
+    // 紧挨在 instr 之前的注释，随 instr 一起移动
+    std::vector<MachineInstr*> comments;
+    MemRef mem;
+    std::vector<std::pair<unsigned, unsigned>> succs; // (后继, 延迟)
+    unsigned num_preds{0};
+    unsigned height{0};
+    unsigned ready{0};
+};
+} // namespace
+
+unsigned InstrScheduler::get_latency(MachineInstr::Opcode op) { return latency_table[op]; }
+
+unsigned InstrScheduler::estimate_cycles(const std::list<MachineInstr*>& instrs)
+{
+    unsigned ready[MachineOperand::NUM_REG_UNITS] = {};
+    unsigned cycle = 0;
+    for (auto* instr : instrs)
+    {
+        if (instr->is_comment()) continue;
+        unsigned issue = cycle;
+        for (auto& use : instr->get_uses()) issue = std::max(issue, ready[use.get_reg_unit()]);
+        for (auto& def : instr->get_defs()) ready[def.get_reg_unit()] = issue + get_latency(instr->get_opcode());
+        cycle = issue + 1;
+    }
+    return cycle;
+}
+
+void InstrScheduler::run()
+{
+    unsigned before = 0;
+    unsigned after = 0;
+    for (auto* func : funcs_)
+    {
+        address_taken_.clear();
+        for (auto* bb : func->get_basic_blocks())
+        {
+            for (auto* instr : bb->get_instructions())
+            {
+                if (instr->is_load() or instr->is_store()) continue;
+                for (auto& op : instr->get_operands())
+                {
+                    if (op.is_frame_index()) address_taken_.insert(op.get_frame_index());
+                }
+            }
+        }
+        for (auto* bb : func->get_basic_blocks())
+        {
+            auto cycles = schedule_block(bb);
+            before += cycles.first;
+            after += cycles.second;
+        }
+    }
+    LOG_INFO << "instruction scheduling: estimated cycles " << before << " -> " << after;
+}
+
+std::pair<unsigned, unsigned> InstrScheduler::schedule_block(MachineBasicBlock* bb)
+{
+    auto& instrs = bb->get_instructions();
+    unsigned before = estimate_cycles(instrs);
+    // 调用和跳转不移动，把基本块分成若干区域
+    std::list<MachineInstr*> scheduled;
+    auto begin = instrs.begin();
+    for (auto it = instrs.begin(); it != instrs.end(); ++it)
+    {
+        if (not (*it)->is_call() and not (*it)->is_terminator()) continue;
+        schedule_region(begin, it, scheduled);
+        scheduled.push_back(*it);
+        begin = std::next(it);
+    }
+    schedule_region(begin, instrs.end(), scheduled);
+    assert(scheduled.size() == instrs.size());
+    instrs = std::move(scheduled);
+    return { before, estimate_cycles(instrs) };
+}
+
+void InstrScheduler::schedule_region(std::list<MachineInstr*>::iterator begin,
+                                     std::list<MachineInstr*>::iterator end, std::list<MachineInstr*>& out)
+{
+    std::vector<Node> nodes;
+    std::vector<MachineInstr*> comments;
+    for (auto it = begin; it != end; ++it)
+    {
+        if ((*it)->is_comment())
+        {
+            comments.push_back(*it);
+            continue;
+        }
+        Node node{ *it, std::move(comments) };
+        comments.clear();
+        if (node.instr->is_load() or node.instr->is_store())
+        {
+            auto& base = node.instr->get_operand(1);
+            node.mem.offset = node.instr->get_operand(2).get_imm();
+            node.mem.width = access_width(node.instr->get_opcode());
+            if (base.is_frame_index())
+            {
+                node.mem.base = MemRef::frame_index;
+                node.mem.index = base.get_frame_index();
+                node.mem.is_private = not address_taken_.count(node.mem.index);
+            }
+            else if (base.is_greg() and base.get_reg() == Reg::sp())
+            {
+                node.mem.base = MemRef::sp;
+            }
+        }
+        nodes.push_back(std::move(node));
+    }
+
+    // 依赖图，边总是从前面的指令指向后面的指令
+    const unsigned num = static_cast<unsigned>(nodes.size());
+    std::vector<int> last_def(MachineOperand::NUM_REG_UNITS, -1);
+    std::vector<std::vector<unsigned>> uses_since_def(MachineOperand::NUM_REG_UNITS);
+    // 布局前引用栈帧对象的指令可能改写 $t8，不能移到 $t8 的写和读之间；这些指令之间互不相关
+    const unsigned scratch = MachineOperand(Reg::t(8)).get_reg_unit();
+    std::vector<unsigned> scratch_clobbers;
+    auto add_edge = [&](unsigned from, unsigned to, unsigned latency) {
+        if (from == to) return;
+        nodes[from].succs.emplace_back(to, latency);
+        nodes[to].num_preds++;
+    };
+    for (unsigned j = 0; j < num; j++)
+    {
+        auto* instr = nodes[j].instr;
+        for (auto& use : instr->get_uses())
+        {
+            auto unit = use.get_reg_unit();
+            if (last_def[unit] >= 0)
+                add_edge(last_def[unit], j, get_latency(nodes[last_def[unit]].instr->get_opcode()));
+        }
+        for (auto& def : instr->get_defs())
+        {
+            auto unit = def.get_reg_unit();
+            if (last_def[unit] >= 0) add_edge(last_def[unit], j, 1);
+            for (auto use : uses_since_def[unit]) add_edge(use, j, 0);
+            if (unit == scratch)
+            {
+                for (auto clobber : scratch_clobbers) add_edge(clobber, j, 0);
+            }
+        }
+        if (instr->has_frame_index())
+        {
+            for (auto use : uses_since_def[scratch]) add_edge(use, j, 0);
+        }
+        for (auto& use : instr->get_uses()) uses_since_def[use.get_reg_unit()].push_back(j);
+        for (auto& def : instr->get_defs())
+        {
+            last_def[def.get_reg_unit()] = static_cast<int>(j);
+            uses_since_def[def.get_reg_unit()].clear();
+            if (def.get_reg_unit() == scratch) scratch_clobbers.clear();
+        }
+        if (instr->has_frame_index()) scratch_clobbers.push_back(j);
+        if (not instr->is_load() and not instr->is_store()) continue;
+        for (unsigned i = 0; i < j; i++)
+        {
+            auto* prev = nodes[i].instr;
+            if (not prev->is_load() and not prev->is_store()) continue;
+            if (not prev->is_store() and not instr->is_store()) continue;
+            if (not may_alias(nodes[i].mem, nodes[j].mem)) continue;
+            add_edge(i, j, prev->is_store() and instr->is_load() ? 1 : 0);
+        }
+    }
+
+    // 关键路径长度作为优先级
+    for (unsigned i = num; i-- > 0;)
+    {
+        auto& node = nodes[i];
+        node.height = get_latency(node.instr->get_opcode());
+        for (auto& succ : node.succs) node.height = std::max(node.height, succ.second + nodes[succ.first].height);
+    }
+
+    // 优先选择操作数已就绪且关键路径最长的指令，都没有就绪时选择最早就绪的，相同时保持原来的顺序
+    std::vector<unsigned> candidates;
+    for (unsigned i = 0; i < num; i++)
+    {
+        if (nodes[i].num_preds == 0) candidates.push_back(i);
+    }
+    unsigned cycle = 0;
+    while (not candidates.empty())
+    {
+        auto better = [&](unsigned a, unsigned b) {
+            bool a_ready = nodes[a].ready <= cycle;
+            bool b_ready = nodes[b].ready <= cycle;
+            if (a_ready != b_ready) return a_ready;
+            if (not a_ready and nodes[a].ready != nodes[b].ready) return nodes[a].ready < nodes[b].ready;
+            if (nodes[a].height != nodes[b].height) return nodes[a].height > nodes[b].height;
+            return a < b;
+        };
+        auto best = std::min_element(candidates.begin(), candidates.end(), better);
+        auto chosen = *best;
+        candidates.erase(best);
+
+        auto& node = nodes[chosen];
+        cycle = std::max(cycle, node.ready);
+        for (auto* comment : node.comments) out.push_back(comment);
+        out.push_back(node.instr);
+        for (auto& succ : node.succs)
+        {
+            auto& next = nodes[succ.first];
+            next.ready = std::max(next.ready, cycle + succ.second);
+            if (--next.num_preds == 0) candidates.push_back(succ.first);
+        }
+        cycle++;
+    }
+    for (auto* comment : comments) out.push_back(comment);
+}
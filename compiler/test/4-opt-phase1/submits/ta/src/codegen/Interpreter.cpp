@@ -0,0 +1,474 @@
+#include "Interpreter.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include "BasicBlock.hpp"
+#include "CodeGenUtil.hpp"
+#include "Constant.hpp"
+#include "ExecuteCost.hpp"
+#include "Function.hpp"
+#include "GlobalVariable.hpp"
+#include "Instruction.hpp"
+#include "Type.hpp"
+
+#if !defined(__GNUC__)
+#error "Interpreter requires the labels-as-values extension of GNU C"
+#endif
+
+namespace
+{
+// 值槽位栈与 alloca 内存栈的容量，只在用到时才会真正占用物理内存
+const size_t SLOT_STACK_SIZE = 1u << 22;
+const size_t MEM_STACK_SIZE = 1u << 26;
+// 全局变量区末尾的余量，越界访问最后一个全局变量时不至于破坏宿主的堆
+const unsigned GLOBAL_PADDING = 4096;
+
+int32_t wrap_add(int32_t a, int32_t b) { return static_cast<int32_t>(static_cast<uint32_t>(a) + static_cast<uint32_t>(b)); }
+int32_t wrap_sub(int32_t a, int32_t b) { return static_cast<int32_t>(static_cast<uint32_t>(a) - static_cast<uint32_t>(b)); }
+int32_t wrap_mul(int32_t a, int32_t b) { return static_cast<int32_t>(static_cast<uint32_t>(a) * static_cast<uint32_t>(b)); }
+
+// 除以 0 和 INT32_MIN / -1 在 C 中未定义，这里分别取 0 和 INT32_MIN，不让解释器本身崩溃
+int32_t safe_div(int32_t a, int32_t b)
+{
+    if (b == 0) return 0;
+    if (b == -1) return wrap_sub(0, a);
+    return a / b;
+}
+
+// 超出范围时饱和，NaN 取 0
+int32_t safe_fptosi(float f)
+{
+    if (std::isnan(f)) return 0;
+    if (f >= 2147483648.0f) return INT32_MAX;
+    if (f <= -2147483648.0f) return INT32_MIN;
+    return static_cast<int32_t>(f);
+}
+
+unsigned memory_width(Type* ty)
+{
+    if (ty->is_int1_type()) return 1;
+    if (ty->is_pointer_type()) return 8;
+    return 4;
+}
+} // namespace
+
+Interpreter::Interpreter(Module* module) : m(module)
+{
+    // 与 .bss 相同，全局变量按声明顺序连续存放并初始化为 0
+    unsigned global_size = 0;
+    for (auto* global : m->get_global_variable())
+    {
+        globals[global] = global_size;
+        global_size = ALIGN(global_size + global->get_type()->get_pointer_element_type()->get_size(), 8);
+    }
+    global_mem = new uint8_t[global_size + GLOBAL_PADDING]();
+    for (auto* func : m->get_functions())
+    {
+        if (func->is_declaration()) continue;
+        codes[func].func = func;
+    }
+    size_t max_copies = 0;
+    for (auto& [func, code] : codes)
+    {
+        compile(code);
+        for (auto& edge : code.edges) max_copies = std::max<size_t>(max_copies, edge.copy_end - edge.copy_begin);
+    }
+    phi_temp.resize(max_copies);
+
+    slot_stack = new Slot[SLOT_STACK_SIZE];
+    slot_top = slot_stack;
+    slot_limit = slot_stack + SLOT_STACK_SIZE;
+    mem_stack = new uint8_t[MEM_STACK_SIZE];
+    mem_top = mem_stack;
+    mem_limit = mem_stack + MEM_STACK_SIZE;
+}
+
+Interpreter::~Interpreter()
+{
+    delete[] global_mem;
+    delete[] slot_stack;
+    delete[] mem_stack;
+}
+
+void Interpreter::compile(FunctionCode& code)
+{
+    auto* func = code.func;
+    std::unordered_map<Value*, uint32_t> slot_of;
+    for (auto* arg : func->get_args()) slot_of[arg] = code.num_values++;
+    for (auto* bb : func->get_basic_blocks())
+    {
+        for (auto* instr : bb->get_instructions())
+        {
+            if (not instr->is_void()) slot_of[instr] = code.num_values++;
+        }
+    }
+    // 无返回值的调用把结果写到这个槽位
+    const uint32_t discard = code.num_values++;
+
+    auto operand = [&](Value* val) -> uint32_t {
+        auto it = slot_of.find(val);
+        if (it != slot_of.end()) return it->second;
+        Slot slot{};
+        if (auto* const_int = dynamic_cast<ConstantInt*>(val))
+            slot.i = const_int->get_value();
+        else if (auto* const_fp = dynamic_cast<ConstantFP*>(val))
+            slot.f = const_fp->get_value();
+        else if (auto* global = dynamic_cast<GlobalVariable*>(val))
+            slot.p = global_mem + globals.at(global);
+        else
+            throw std::runtime_error("interpreter: unsupported operand " + val->get_name());
+        auto index = code.num_values + static_cast<uint32_t>(code.consts.size());
+        code.consts.push_back(slot);
+        slot_of[val] = index;
+        return index;
+    };
+
+    // 目标基本块的位置在所有基本块生成后回填
+    std::unordered_map<BasicBlock*, uint32_t> block_pc;
+    std::vector<std::pair<uint32_t, BasicBlock*>> edge_targets;
+    auto make_edge = [&](BasicBlock* from, BasicBlock* to) -> uint32_t {
+        Edge edge{0, static_cast<uint32_t>(code.copies.size()), 0};
+        for (auto* instr : to->get_instructions())
+        {
+            if (not instr->is_phi()) break;
+            for (auto& [val, pre_bb] : dynamic_cast<PhiInst*>(instr)->get_phi_pairs())
+            {
+                if (pre_bb != from) continue;
+                if (val != instr) code.copies.emplace_back(slot_of.at(instr), operand(val));
+                break;
+            }
+        }
+        edge.copy_end = static_cast<uint32_t>(code.copies.size());
+        auto index = static_cast<uint32_t>(code.edges.size());
+        code.edges.push_back(edge);
+        edge_targets.emplace_back(index, to);
+        return index;
+    };
+
+    auto emit = [&](Opcode op, uint32_t dst = 0, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0) {
+        code.insts.push_back({nullptr, op, dst, a, b, c});
+    };
+
+    for (auto* bb : func->get_basic_blocks())
+    {
+        block_pc[bb] = static_cast<uint32_t>(code.insts.size());
+        int cost = 0;
+        for (auto* instr : bb->get_instructions()) cost += ::get_execute_cost(instr);
+        if (cost != 0) emit(COST, 0, static_cast<uint32_t>(cost));
+
+        for (auto* instr : bb->get_instructions())
+        {
+            auto dst = instr->is_void() ? discard : slot_of.at(instr);
+            auto op0 = [&]() { return operand(instr->get_operand(0)); };
+            auto op1 = [&]() { return operand(instr->get_operand(1)); };
+            switch (instr->get_instr_type())
+            {
+                case Instruction::ret:
+                    if (instr->get_num_operand() == 0)
+                        emit(RET_VOID);
+                    else
+                        emit(RET, 0, op0());
+                    break;
+                case Instruction::br:
+                {
+                    auto* br = dynamic_cast<BranchInst*>(instr);
+                    if (br->is_cond_br())
+                    {
+                        auto cond = operand(br->get_condition());
+                        auto t = make_edge(bb, dynamic_cast<BasicBlock*>(br->get_operand(1)));
+                        auto f = make_edge(bb, dynamic_cast<BasicBlock*>(br->get_operand(2)));
+                        emit(COND_BR, 0, cond, t, f);
+                    }
+                    else
+                    {
+                        emit(BR, 0, make_edge(bb, dynamic_cast<BasicBlock*>(br->get_operand(0))));
+                    }
+                    break;
+                }
+                case Instruction::add: emit(ADD, dst, op0(), op1()); break;
+                case Instruction::sub: emit(SUB, dst, op0(), op1()); break;
+                case Instruction::mul: emit(MUL, dst, op0(), op1()); break;
+                case Instruction::sdiv: emit(SDIV, dst, op0(), op1()); break;
+                case Instruction::fadd: emit(FADD, dst, op0(), op1()); break;
+                case Instruction::fsub: emit(FSUB, dst, op0(), op1()); break;
+                case Instruction::fmul: emit(FMUL, dst, op0(), op1()); break;
+                case Instruction::fdiv: emit(FDIV, dst, op0(), op1()); break;
+                case Instruction::alloca:
+                {
+                    emit(ALLOCA, dst, code.alloca_size);
+                    auto size = dynamic_cast<AllocaInst*>(instr)->get_alloca_type()->get_size();
+                    code.alloca_size = ALIGN(code.alloca_size + size, 8);
+                    break;
+                }
+                case Instruction::load:
+                {
+                    auto width = memory_width(instr->get_type());
+                    emit(width == 1 ? LOAD_B : width == 8 ? LOAD_D : LOAD_W, dst, op0());
+                    break;
+                }
+                case Instruction::store:
+                {
+                    auto width = memory_width(instr->get_operand(0)->get_type());
+                    emit(width == 1 ? STORE_B : width == 8 ? STORE_D : STORE_W, 0, op0(), op1());
+                    break;
+                }
+                case Instruction::ge: emit(ICMP_GE, dst, op0(), op1()); break;
+                case Instruction::gt: emit(ICMP_GT, dst, op0(), op1()); break;
+                case Instruction::le: emit(ICMP_LE, dst, op0(), op1()); break;
+                case Instruction::lt: emit(ICMP_LT, dst, op0(), op1()); break;
+                case Instruction::eq: emit(ICMP_EQ, dst, op0(), op1()); break;
+                case Instruction::ne: emit(ICMP_NE, dst, op0(), op1()); break;
+                case Instruction::fge: emit(FCMP_GE, dst, op0(), op1()); break;
+                case Instruction::fgt: emit(FCMP_GT, dst, op0(), op1()); break;
+                case Instruction::fle: emit(FCMP_LE, dst, op0(), op1()); break;
+                case Instruction::flt: emit(FCMP_LT, dst, op0(), op1()); break;
+                case Instruction::feq: emit(FCMP_EQ, dst, op0(), op1()); break;
+                case Instruction::fne: emit(FCMP_NE, dst, op0(), op1()); break;
+                case Instruction::phi: break;
+                case Instruction::call:
+                {
+                    auto* callee = dynamic_cast<Function*>(instr->get_operand(0));
+                    auto num_args = instr->get_num_operand() - 1;
+                    if (not callee->is_declaration())
+                    {
+                        auto args_begin = static_cast<uint32_t>(code.call_args.size());
+                        for (unsigned i = 1; i <= num_args; i++) code.call_args.push_back(operand(instr->get_operand(i)));
+                        auto& callee_code = codes.at(callee);
+                        auto index = std::find(callees.begin(), callees.end(), &callee_code) - callees.begin();
+                        if (index == static_cast<long>(callees.size())) callees.push_back(&callee_code);
+                        emit(CALL, dst, static_cast<uint32_t>(index), args_begin, num_args);
+                    }
+                    else if (callee->get_name() == "input")
+                        emit(CALL_INPUT, dst);
+                    else if (callee->get_name() == "output")
+                        emit(CALL_OUTPUT, dst, op1());
+                    else if (callee->get_name() == "outputFloat")
+                        emit(CALL_OUTPUT_FLOAT, dst, op1());
+                    else if (callee->get_name() == "add_lab4_flag")
+                        emit(CALL_ADD_FLAG, dst, op1(), operand(instr->get_operand(2)));
+                    else
+                        throw std::runtime_error("interpreter: undefined function " + callee->get_name());
+                    break;
+                }
+                case Instruction::getelementptr:
+                {
+                    // 与后端相同，只有最后一个下标参与地址计算
+                    auto* gep = dynamic_cast<GetElementPtrInst*>(instr);
+                    auto* element_type = gep->get_element_type();
+                    bool word = element_type->is_float_type() or element_type->is_int32_type();
+                    emit(word ? GEP_W : GEP_D, dst, op0(), operand(gep->get_operand(gep->get_num_operand() - 1)));
+                    break;
+                }
+                case Instruction::zext: emit(ZEXT, dst, op0()); break;
+                case Instruction::fptosi: emit(FPTOSI, dst, op0()); break;
+                case Instruction::sitofp: emit(SITOFP, dst, op0()); break;
+                case Instruction::select:
+                    emit(SELECT, dst, op0(), op1(), operand(instr->get_operand(2)));
+                    break;
+            }
+        }
+    }
+    for (auto& [index, bb] : edge_targets) code.edges[index].target = block_pc.at(bb);
+}
+
+Interpreter::Slot Interpreter::execute(FunctionCode* entry)
+{
+    // 顺序与 Opcode 一致
+    static const void* const handlers[] = {
+        &&L_ADD,     &&L_SUB,     &&L_MUL,     &&L_SDIV,    &&L_FADD,    &&L_FSUB,    &&L_FMUL,
+        &&L_FDIV,    &&L_ALLOCA,  &&L_LOAD_B,  &&L_LOAD_W,  &&L_LOAD_D,  &&L_STORE_B, &&L_STORE_W,
+        &&L_STORE_D, &&L_ICMP_GE, &&L_ICMP_GT, &&L_ICMP_LE, &&L_ICMP_LT, &&L_ICMP_EQ, &&L_ICMP_NE,
+        &&L_FCMP_GE, &&L_FCMP_GT, &&L_FCMP_LE, &&L_FCMP_LT, &&L_FCMP_EQ, &&L_FCMP_NE, &&L_ZEXT,
+        &&L_FPTOSI,  &&L_SITOFP,  &&L_SELECT,  &&L_GEP_W,   &&L_GEP_D,   &&L_COST,    &&L_BR,
+        &&L_COND_BR, &&L_RET,     &&L_RET_VOID, &&L_CALL,   &&L_CALL_INPUT, &&L_CALL_OUTPUT,
+        &&L_CALL_OUTPUT_FLOAT, &&L_CALL_ADD_FLAG,
+    };
+    static_assert(sizeof(handlers) / sizeof(handlers[0]) == CALL_ADD_FLAG + 1, "handlers 与 Opcode 不一致");
+
+    FunctionCode* code = nullptr;
+    const Inst* insts = nullptr;
+    const Inst* pc = nullptr;
+    Slot* frame = nullptr;
+    uint8_t* mem = nullptr;
+    Slot ret{};
+    call_stack.clear();
+
+    // 在 slot_top 处建立 callee 的栈帧，参数已经放好
+    auto enter = [&](FunctionCode* callee) {
+        if (callee->num_slots() > static_cast<size_t>(slot_limit - slot_top) or
+            callee->alloca_size > static_cast<size_t>(mem_limit - mem_top))
+            throw std::runtime_error("interpreter: stack overflow");
+        if (not callee->threaded)
+        {
+            for (auto& inst : callee->insts) inst.handler = handlers[inst.op];
+            callee->threaded = true;
+        }
+        code = callee;
+        insts = code->insts.data();
+        pc = insts;
+        frame = slot_top;
+        slot_top = frame + code->num_slots();
+        std::copy(code->consts.begin(), code->consts.end(), frame + code->num_values);
+        mem = mem_top;
+        mem_top = mem + code->alloca_size;
+    };
+
+    // 沿控制流边跳转：先做边上 phi 的并行复制，多于一个复制时经过暂存区
+    auto take_edge = [&](uint32_t index) {
+        const auto& edge = code->edges[index];
+        if (edge.copy_end - edge.copy_begin == 1)
+        {
+            const auto& copy = code->copies[edge.copy_begin];
+            frame[copy.first] = frame[copy.second];
+        }
+        else if (edge.copy_end != edge.copy_begin)
+        {
+            for (auto i = edge.copy_begin; i < edge.copy_end; i++) phi_temp[i - edge.copy_begin] = frame[code->copies[i].second];
+            for (auto i = edge.copy_begin; i < edge.copy_end; i++) frame[code->copies[i].first] = phi_temp[i - edge.copy_begin];
+        }
+        return insts + edge.target;
+    };
+
+#define DISPATCH() goto *pc->handler
+#define NEXT()                                                                                                         \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        ++pc;                                                                                                          \
+        DISPATCH();                                                                                                    \
+    } while (0)
+#define A frame[pc->a]
+#define B frame[pc->b]
+#define C frame[pc->c]
+#define D frame[pc->dst]
+
+    enter(entry);
+    DISPATCH();
+
+L_ADD: D.i = wrap_add(A.i, B.i); NEXT();
+L_SUB: D.i = wrap_sub(A.i, B.i); NEXT();
+L_MUL: D.i = wrap_mul(A.i, B.i); NEXT();
+L_SDIV: D.i = safe_div(A.i, B.i); NEXT();
+L_FADD: D.f = A.f + B.f; NEXT();
+L_FSUB: D.f = A.f - B.f; NEXT();
+L_FMUL: D.f = A.f * B.f; NEXT();
+L_FDIV: D.f = A.f / B.f; NEXT();
+L_ALLOCA: D.p = mem + pc->a; NEXT();
+L_LOAD_B: D.i = *A.p; NEXT();
+L_LOAD_W: std::memcpy(&D.i, A.p, 4); NEXT();
+L_LOAD_D: std::memcpy(&D.p, A.p, 8); NEXT();
+L_STORE_B: *B.p = static_cast<uint8_t>(A.i); NEXT();
+L_STORE_W: std::memcpy(B.p, &A.i, 4); NEXT();
+L_STORE_D: std::memcpy(B.p, &A.p, 8); NEXT();
+L_ICMP_GE: D.i = A.i >= B.i; NEXT();
+L_ICMP_GT: D.i = A.i > B.i; NEXT();
+L_ICMP_LE: D.i = A.i <= B.i; NEXT();
+L_ICMP_LT: D.i = A.i < B.i; NEXT();
+L_ICMP_EQ: D.i = A.i == B.i; NEXT();
+L_ICMP_NE: D.i = A.i != B.i; NEXT();
+// 与后端相同，有 NaN 时所有比较都为假
+L_FCMP_GE: D.i = A.f >= B.f; NEXT();
+L_FCMP_GT: D.i = A.f > B.f; NEXT();
+L_FCMP_LE: D.i = A.f <= B.f; NEXT();
+L_FCMP_LT: D.i = A.f < B.f; NEXT();
+L_FCMP_EQ: D.i = A.f == B.f; NEXT();
+L_FCMP_NE: D.i = A.f < B.f or A.f > B.f; NEXT();
+L_ZEXT: D.i = A.i; NEXT();
+L_FPTOSI: D.i = safe_fptosi(A.f); NEXT();
+L_SITOFP: D.f = static_cast<float>(A.i); NEXT();
+L_SELECT: D = A.i ? B : C; NEXT();
+L_GEP_W: D.p = A.p + static_cast<int64_t>(B.i) * 4; NEXT();
+L_GEP_D: D.p = A.p + static_cast<int64_t>(B.i) * 8; NEXT();
+L_COST: flags[1] = wrap_add(flags[1], static_cast<int32_t>(pc->a)); NEXT();
+L_BR: pc = take_edge(pc->a); DISPATCH();
+L_COND_BR: pc = take_edge(A.i ? pc->b : pc->c); DISPATCH();
+L_RET: ret = A; goto L_EXIT;
+L_RET_VOID: goto L_EXIT;
+L_CALL:
+    if (pc->c > static_cast<size_t>(slot_limit - slot_top)) throw std::runtime_error("interpreter: stack overflow");
+    for (uint32_t i = 0; i < pc->c; i++) slot_top[i] = frame[code->call_args[pc->b + i]];
+    call_stack.push_back({code, pc, frame, mem});
+    enter(callees[pc->a]);
+    DISPATCH();
+L_CALL_INPUT:
+{
+    int val = 0;
+    if (std::scanf("%d", &val) != 1) val = 0;
+    gettimeofday(&time_start, nullptr);
+    end_set = false;
+    D.i = val;
+    NEXT();
+}
+L_CALL_OUTPUT:
+    if (not end_set)
+    {
+        gettimeofday(&time_end, nullptr);
+        end_set = true;
+    }
+    std::printf("%d\n", A.i);
+    NEXT();
+L_CALL_OUTPUT_FLOAT:
+    if (not end_set)
+    {
+        gettimeofday(&time_end, nullptr);
+        end_set = true;
+    }
+    std::printf("%f\n", A.f);
+    NEXT();
+L_CALL_ADD_FLAG:
+    if (A.i == 0 or A.i == 1) flags[A.i] = wrap_add(flags[A.i], B.i);
+    NEXT();
+
+#undef DISPATCH
+#undef NEXT
+#undef A
+#undef B
+#undef C
+#undef D
+
+// 返回到调用者，返回值写入 call 指令的结果槽位
+L_EXIT:
+    slot_top = frame;
+    mem_top = mem;
+    if (call_stack.empty()) return ret;
+    code = call_stack.back().code;
+    insts = code->insts.data();
+    pc = call_stack.back().pc;
+    frame = call_stack.back().frame;
+    mem = call_stack.back().mem;
+    call_stack.pop_back();
+    frame[pc->dst] = ret;
+    ++pc;
+    goto *pc->handler;
+}
+
+int Interpreter::run()
+{
+    Function* main_func = nullptr;
+    for (auto* func : m->get_functions())
+    {
+        if (func->get_name() == "main" and not func->is_declaration()) main_func = func;
+    }
+    if (main_func == nullptr) throw std::runtime_error("interpreter: no main function");
+
+    flags[0] = 0;
+    flags[1] = 0;
+    end_set = false;
+    gettimeofday(&time_start, nullptr);
+
+    // 与后端在 main 开头统计的一致
+    flags[0] = ::get_allocate_size(m);
+    auto ret = execute(&codes.at(main_func));
+
+    std::fflush(stdout);
+    if (not end_set) gettimeofday(&time_end, nullptr);
+    long time_us = 1000000L * (time_end.tv_sec - time_start.tv_sec) + time_end.tv_usec - time_start.tv_usec;
+    std::fprintf(stderr, "Allocate Size (bytes):\n%d\n", flags[0]);
+    std::fprintf(stderr, "Execute Cost:\n%d\n", flags[1]);
+    std::fprintf(stderr, "Take Times (us):\n%ld\n", time_us);
+    return main_func->get_return_type()->is_void_type() ? 0 : ret.i;
+}
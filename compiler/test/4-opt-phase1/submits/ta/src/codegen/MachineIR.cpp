@@ -0,0 +1,310 @@
+#include "MachineIR.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+#include "CodeGenUtil.hpp"
+#include "Function.hpp"
+
+namespace
+{
+enum OpcodeFlag : uint8_t
+{
+    DEF = 1,      // 第一个操作数是目的寄存器
+    LOAD = 2,     // (数据寄存器, 基址, 偏移)
+    STORE = 4,    // (数据寄存器, 基址, 偏移)
+    COND_BR = 8,  // 最后一个操作数是目标基本块
+};
+
+struct OpcodeInfo
+{
+    const char* name;
+    uint8_t flags;
+};
+
+// 顺序与 MachineInstr::Opcode 一致
+const OpcodeInfo opcode_info[] = {
+    { "#", 0 },
+    { "add.w", DEF }, { "add.d", DEF }, { "sub.w", DEF }, { "sub.d", DEF },
+    { "mul.w", DEF }, { "mul.d", DEF }, { "mulh.w", DEF }, { "div.w", DEF },
+    { "addi.w", DEF }, { "addi.d", DEF }, { "slt", DEF }, { "sltu", DEF }, { "slti", DEF },
+    { "and", DEF }, { "or", DEF }, { "xor", DEF }, { "andi", DEF }, { "ori", DEF }, { "xori", DEF },
+    { "slli.w", DEF }, { "srli.w", DEF }, { "srai.w", DEF }, { "slli.d", DEF },
+    { "lu12i.w", DEF }, { "lu32i.d", DEF }, { "lu52i.d", DEF },
+    { "bstrpick.w", DEF }, { "maskeqz", DEF }, { "masknez", DEF }, { "la.local", DEF },
+    { "ld.b", DEF | LOAD }, { "ld.w", DEF | LOAD }, { "ld.d", DEF | LOAD },
+    { "st.b", STORE }, { "st.w", STORE }, { "st.d", STORE },
+    { "fld.s", DEF | LOAD }, { "fst.s", STORE }, { "fld.d", DEF | LOAD }, { "fst.d", STORE },
+    { "fadd.s", DEF }, { "fsub.s", DEF }, { "fmul.s", DEF }, { "fdiv.s", DEF },
+    { "fcmp.slt.s", DEF }, { "fcmp.sle.s", DEF }, { "fcmp.seq.s", DEF }, { "fcmp.sne.s", DEF },
+    { "fmov.s", DEF }, { "movgr2fr.w", DEF }, { "movfr2gr.s", DEF }, { "movgr2cf", DEF }, { "movcf2gr", DEF },
+    { "ffint.s.w", DEF }, { "ftintrz.w.s", DEF }, { "fsel", DEF },
+    { "b", 0 }, { "bl", 0 }, { "jr", 0 },
+    { "beqz", COND_BR }, { "bnez", COND_BR }, { "beq", COND_BR }, { "bne", COND_BR },
+    { "blt", COND_BR }, { "bge", COND_BR }, { "bltu", COND_BR }, { "bgeu", COND_BR },
+    { "bceqz", COND_BR }, { "bcnez", COND_BR },
+};
+
+static_assert(sizeof(opcode_info) / sizeof(opcode_info[0]) == MachineInstr::BCNEZ + 1,
+              "opcode_info 与 MachineInstr::Opcode 不一致");
+} // namespace
+
+MachineOperand MachineOperand::create_imm(int64_t val)
+{
+    MachineOperand op(imm);
+    op.imm_ = val;
+    return op;
+}
+
+MachineOperand MachineOperand::create_symbol(const std::string& name)
+{
+    MachineOperand op(symbol);
+    op.symbol_ = name;
+    return op;
+}
+
+MachineOperand MachineOperand::create_frame_index(int index)
+{
+    MachineOperand op(frame_index);
+    op.id_ = static_cast<unsigned>(index);
+    return op;
+}
+
+unsigned MachineOperand::get_reg_unit() const
+{
+    switch (kind_)
+    {
+        case greg: return id_;
+        case freg: return 32 + id_;
+        case cfreg: return 64 + id_;
+        default: assert(false && "not a register"); return 0;
+    }
+}
+
+bool MachineOperand::operator==(const MachineOperand& other) const
+{
+    if (kind_ != other.kind_) return false;
+    switch (kind_)
+    {
+        case imm: return imm_ == other.imm_;
+        case block: return block_ == other.block_;
+        case symbol: return symbol_ == other.symbol_;
+        default: return id_ == other.id_;
+    }
+}
+
+std::string MachineOperand::print() const
+{
+    switch (kind_)
+    {
+        case greg: return get_reg().print();
+        case freg: return get_freg().print();
+        case cfreg: return get_cfreg().print();
+        case imm: return std::to_string(imm_);
+        case block: return block_->get_name();
+        case symbol: return symbol_;
+        case frame_index: return "<fi#" + std::to_string(id_) + ">";
+    }
+    assert(false && "unreachable");
+    return "";
+}
+
+MachineInstr* MachineInstr::create(Opcode op, std::vector<MachineOperand> operands, MachineBasicBlock* bb)
+{
+    auto* instr = new MachineInstr(op, std::move(operands));
+    if (bb != nullptr) bb->add_instruction(instr);
+    return instr;
+}
+
+MachineInstr* MachineInstr::create_comment(const std::string& text, MachineBasicBlock* bb)
+{
+    auto* instr = create(COMMENT, {}, bb);
+    instr->comment_ = text;
+    return instr;
+}
+
+bool MachineInstr::is_load() const { return opcode_info[op_].flags & LOAD; }
+
+bool MachineInstr::is_store() const { return opcode_info[op_].flags & STORE; }
+
+bool MachineInstr::is_cond_branch() const { return opcode_info[op_].flags & COND_BR; }
+
+bool MachineInstr::has_def() const { return opcode_info[op_].flags & DEF; }
+
+bool MachineInstr::is_use_operand(unsigned i) const
+{
+    auto& op = operands_.at(i);
+    if (not op.is_greg() and not op.is_freg() and not op.is_cfreg()) return false;
+    return i != 0 or not has_def();
+}
+
+std::vector<MachineOperand> MachineInstr::get_defs() const
+{
+    if (op_ == BL)
+    {
+        // 调用者保存的寄存器
+        std::vector<MachineOperand> defs{ Reg::ra(), CFReg(0) };
+        for (unsigned i = 0; i <= 7; i++) defs.emplace_back(Reg::a(i));
+        for (unsigned i = 0; i <= 8; i++) defs.emplace_back(Reg::t(i));
+        for (unsigned i = 0; i <= 7; i++) defs.emplace_back(FReg::fa(i));
+        for (unsigned i = 0; i <= 15; i++) defs.emplace_back(FReg::ft(i));
+        return defs;
+    }
+    if (has_def()) return { operands_[0] };
+    return {};
+}
+
+std::vector<MachineOperand> MachineInstr::get_uses() const
+{
+    std::vector<MachineOperand> uses;
+    for (unsigned i = 0; i < operands_.size(); i++)
+    {
+        if (is_use_operand(i)) uses.push_back(operands_[i]);
+    }
+    if (op_ == BL)
+    {
+        for (unsigned i = 0; i <= 7; i++) uses.emplace_back(Reg::a(i));
+        for (unsigned i = 0; i <= 7; i++) uses.emplace_back(FReg::fa(i));
+    }
+    else if (op_ == JR)
+    {
+        uses.emplace_back(Reg::a(0));
+        uses.emplace_back(FReg::fa(0));
+    }
+    return uses;
+}
+
+const char* MachineInstr::get_name(Opcode op) { return opcode_info[op].name; }
+
+std::string MachineInstr::print() const
+{
+    if (is_comment()) return "# " + comment_;
+    std::string result = "\t";
+    result += get_name(op_);
+    for (unsigned i = 0; i < operands_.size(); i++)
+    {
+        result += i == 0 ? " " : ", ";
+        result += operands_[i].print();
+    }
+    return result;
+}
+
+MachineBasicBlock::~MachineBasicBlock()
+{
+    for (auto* instr : instr_list_) delete instr;
+}
+
+MachineBasicBlock* MachineBasicBlock::create(const std::string& name, MachineFunction* parent, BasicBlock* bb)
+{
+    auto* mbb = new MachineBasicBlock(name, parent, bb);
+    parent->add_basic_block(mbb);
+    return mbb;
+}
+
+void MachineBasicBlock::add_instruction(MachineInstr* instr)
+{
+    instr->set_parent(this);
+    instr_list_.push_back(instr);
+}
+
+void MachineBasicBlock::insert_instr(std::list<MachineInstr*>::iterator pos, MachineInstr* instr)
+{
+    instr->set_parent(this);
+    instr_list_.insert(pos, instr);
+}
+
+void MachineBasicBlock::erase_instr(MachineInstr* instr)
+{
+    instr_list_.remove(instr);
+    delete instr;
+}
+
+void MachineBasicBlock::add_succ_basic_block(MachineBasicBlock* succ)
+{
+    if (std::find(succ_bbs_.begin(), succ_bbs_.end(), succ) != succ_bbs_.end()) return;
+    succ_bbs_.push_back(succ);
+    succ->pre_bbs_.push_back(this);
+}
+
+void MachineBasicBlock::remove_succ_basic_block(MachineBasicBlock* succ)
+{
+    succ_bbs_.erase(std::remove(succ_bbs_.begin(), succ_bbs_.end(), succ), succ_bbs_.end());
+    succ->pre_bbs_.erase(std::remove(succ->pre_bbs_.begin(), succ->pre_bbs_.end(), this), succ->pre_bbs_.end());
+}
+
+std::string MachineBasicBlock::print() const
+{
+    std::string result = name_ + ":\n";
+    for (auto* instr : instr_list_) result += instr->print() + "\n";
+    return result;
+}
+
+MachineFunction::~MachineFunction()
+{
+    for (auto* bb : basic_blocks_) delete bb;
+}
+
+std::string MachineFunction::get_name() const { return func_->get_name(); }
+
+void MachineFunction::move_basic_block_after(MachineBasicBlock* bb, MachineBasicBlock* pos)
+{
+    basic_blocks_.remove(bb);
+    auto it = std::find(basic_blocks_.begin(), basic_blocks_.end(), pos);
+    assert(it != basic_blocks_.end());
+    basic_blocks_.insert(std::next(it), bb);
+}
+
+MachineBasicBlock* MachineFunction::get_next_basic_block(MachineBasicBlock* bb) const
+{
+    auto it = std::find(basic_blocks_.begin(), basic_blocks_.end(), bb);
+    if (it == basic_blocks_.end() or std::next(it) == basic_blocks_.end()) return nullptr;
+    return *std::next(it);
+}
+
+void MachineFunction::erase_basic_block(MachineBasicBlock* bb)
+{
+    assert(bb->get_pre_basic_blocks().empty() and bb->get_succ_basic_blocks().empty());
+    basic_blocks_.remove(bb);
+    if (exit_block_ == bb) exit_block_ = nullptr;
+    delete bb;
+}
+
+bool MachineFunction::has_call() const
+{
+    for (auto* bb : basic_blocks_)
+    {
+        for (auto* instr : bb->get_instructions())
+        {
+            if (instr->is_call()) return true;
+        }
+    }
+    return false;
+}
+
+unsigned MachineFunction::layout_frame()
+{
+    unsigned offset = 0;
+    for (auto& object : frame_objects_)
+    {
+        offset = ALIGN(offset, object.align_);
+        object.offset_ = static_cast<int>(offset);
+        offset += object.size_;
+    }
+    if (has_call()) offset += PROLOGUE_OFFSET_BASE;
+    frame_size_ = ALIGN(offset, PROLOGUE_ALIGN);
+    return frame_size_;
+}
+
+int MachineFunction::create_frame_object(unsigned size, unsigned align)
+{
+    frame_objects_.push_back({ size, align, 0 });
+    return static_cast<int>(frame_objects_.size()) - 1;
+}
+
+std::string MachineFunction::print() const
+{
+    std::string result = "\t.globl " + get_name() + "\n";
+    result += "\t.type " + get_name() + ", @function\n";
+    for (auto* bb : basic_blocks_) result += bb->print();
+    return result;
+}
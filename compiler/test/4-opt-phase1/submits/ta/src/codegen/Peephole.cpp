@@ -0,0 +1,495 @@
+#include "Peephole.hpp"
+
+#include <algorithm>
+#include <bitset>
+#include <map>
+#include <optional>
+#include <unordered_map>
+
+#include "CodeGenUtil.hpp"
+#include "logging.hpp"
+
+using Op = MachineInstr::Opcode;
+
+namespace
+{
+using RegSet = std::bitset<MachineOperand::NUM_REG_UNITS>;
+
+// $zero $ra $tp $sp $fp 不参与优化
+bool is_reserved(const MachineOperand& op)
+{
+    if (not op.is_greg()) return false;
+    auto id = op.get_reg().id;
+    return id <= 3 or id == Reg::fp().id;
+}
+
+bool fits_imm12(int64_t x) { return x >= IMM_12_MIN and x <= IMM_12_MAX; }
+
+int64_t sext32(uint64_t x) { return static_cast<int32_t>(static_cast<uint32_t>(x)); }
+
+// 访存指令访问的栈帧对象及偏移
+using Slot = std::pair<int, int64_t>;
+
+bool get_slot(MachineInstr* instr, Slot& slot)
+{
+    if (not instr->is_load() and not instr->is_store()) return false;
+    auto& base = instr->get_operand(1);
+    if (not base.is_frame_index()) return false;
+    slot = { base.get_frame_index(), instr->get_operand(2).get_imm() };
+    return true;
+}
+
+// 与存储配对的读取
+Op load_of(Op store)
+{
+    switch (store)
+    {
+        case Op::ST_B: return Op::LD_B;
+        case Op::ST_W: return Op::LD_W;
+        case Op::ST_D: return Op::LD_D;
+        case Op::FST_S: return Op::FLD_S;
+        default: assert(false && "not a store"); return store;
+    }
+}
+
+using ConstMap = std::unordered_map<unsigned, int64_t>;
+
+bool value_of(const MachineOperand& op, const ConstMap& consts, int64_t& value)
+{
+    if (not op.is_greg()) return false;
+    if (op.get_reg().id == 0)
+    {
+        value = 0;
+        return true;
+    }
+    auto it = consts.find(op.get_reg().id);
+    if (it == consts.end()) return false;
+    value = it->second;
+    return true;
+}
+
+// 所有寄存器操作数都是已知常量时指令的结果
+std::optional<int64_t> evaluate(MachineInstr* instr, const ConstMap& consts)
+{
+    auto& ops = instr->get_operands();
+    int64_t a = 0, b = 0;
+    auto reg_reg = [&]() { return value_of(ops[1], consts, a) and value_of(ops[2], consts, b); };
+    auto reg_imm = [&]() {
+        b = ops[2].get_imm();
+        return value_of(ops[1], consts, a);
+    };
+    auto ua = [&]() { return static_cast<uint64_t>(a); };
+    auto ub = [&]() { return static_cast<uint64_t>(b); };
+    switch (instr->get_opcode())
+    {
+        case Op::LU12I_W: return sext32(static_cast<uint64_t>(ops[1].get_imm()) << 12);
+        case Op::ADDI_W: if (reg_imm()) return sext32(ua() + ub()); break;
+        case Op::ADDI_D: if (reg_imm()) return static_cast<int64_t>(ua() + ub()); break;
+        case Op::ANDI: if (reg_imm()) return a & b; break;
+        case Op::ORI: if (reg_imm()) return a | b; break;
+        case Op::XORI: if (reg_imm()) return a ^ b; break;
+        case Op::SLTI: if (reg_imm()) return a < b; break;
+        case Op::SLLI_W: if (reg_imm()) return sext32(ua() << b); break;
+        case Op::SLLI_D: if (reg_imm()) return static_cast<int64_t>(ua() << b); break;
+        case Op::ADD_W: if (reg_reg()) return sext32(ua() + ub()); break;
+        case Op::SUB_W: if (reg_reg()) return sext32(ua() - ub()); break;
+        case Op::MUL_W: if (reg_reg()) return sext32(ua() * ub()); break;
+        case Op::ADD_D: if (reg_reg()) return static_cast<int64_t>(ua() + ub()); break;
+        case Op::SUB_D: if (reg_reg()) return static_cast<int64_t>(ua() - ub()); break;
+        case Op::MUL_D: if (reg_reg()) return static_cast<int64_t>(ua() * ub()); break;
+        case Op::AND: if (reg_reg()) return a & b; break;
+        case Op::OR: if (reg_reg()) return a | b; break;
+        case Op::XOR: if (reg_reg()) return a ^ b; break;
+        case Op::SLT: if (reg_reg()) return a < b; break;
+        case Op::SLTU: if (reg_reg()) return ua() < ub(); break;
+        default: break;
+    }
+    return std::nullopt;
+}
+
+int log2_exact(int64_t c)
+{
+    if (c <= 0 or (c & (c - 1)) != 0) return -1;
+    int k = 0;
+    while ((int64_t{ 1 } << k) != c) k++;
+    return k;
+}
+
+// 一个源操作数为已知常量时改用立即数形式，成功时返回 true
+bool fold_imm(MachineInstr* instr, const ConstMap& consts)
+{
+    auto& ops = instr->get_operands();
+    if (ops.size() != 3 or not ops[1].is_greg() or not ops[2].is_greg()) return false;
+    auto op = instr->get_opcode();
+    bool commutative = op == Op::ADD_W or op == Op::ADD_D or op == Op::MUL_W or op == Op::MUL_D or
+                       op == Op::AND or op == Op::OR or op == Op::XOR;
+    for (int swap = 0; swap < (commutative ? 2 : 1); swap++)
+    {
+        auto src = ops[swap ? 2 : 1];
+        auto& const_op = ops[swap ? 1 : 2];
+        int64_t c;
+        if (const_op.get_reg().id == 0 or not value_of(const_op, consts, c)) continue;
+        Op new_op;
+        int64_t imm;
+        switch (op)
+        {
+            case Op::ADD_W:
+            case Op::ADD_D:
+                if (not fits_imm12(c)) continue;
+                new_op = op == Op::ADD_W ? Op::ADDI_W : Op::ADDI_D;
+                imm = c;
+                break;
+            case Op::SUB_W:
+            case Op::SUB_D:
+                if (not fits_imm12(-c)) continue;
+                new_op = op == Op::SUB_W ? Op::ADDI_W : Op::ADDI_D;
+                imm = -c;
+                break;
+            case Op::MUL_W:
+            case Op::MUL_D:
+                imm = log2_exact(op == Op::MUL_W ? sext32(c) : c);
+                if (imm < 0 or imm >= (op == Op::MUL_W ? 32 : 64)) continue;
+                new_op = op == Op::MUL_W ? Op::SLLI_W : Op::SLLI_D;
+                break;
+            case Op::AND:
+            case Op::OR:
+            case Op::XOR:
+                if (c < 0 or c > 0xFFF) continue;
+                new_op = op == Op::AND ? Op::ANDI : op == Op::OR ? Op::ORI : Op::XORI;
+                imm = c;
+                break;
+            case Op::SLT:
+                if (not fits_imm12(c)) continue;
+                new_op = Op::SLTI;
+                imm = c;
+                break;
+            default:
+                return false;
+        }
+        // 乘 1 即复制
+        if ((new_op == Op::SLLI_W or new_op == Op::SLLI_D) and imm == 0)
+        {
+            instr->set_opcode(Op::OR);
+            ops = { ops[0], src, Reg::zero() };
+            return true;
+        }
+        instr->set_opcode(new_op);
+        ops = { ops[0], src, MachineOperand::create_imm(imm) };
+        return true;
+    }
+    return false;
+}
+
+bool is_move(MachineInstr* instr)
+{
+    if (instr->get_opcode() == Op::FMOV_S) return true;
+    auto& ops = instr->get_operands();
+    return instr->get_opcode() == Op::OR and ops[2].is_greg() and ops[2].get_reg().id == 0 and
+           ops[1].get_reg().id != 0;
+}
+} // namespace
+
+void Peephole::run()
+{
+    for (auto* func : funcs_) run_on_function(func);
+    LOG_INFO << "peephole: " << forwarded_loads_ << " loads forwarded, " << dead_stores_ << " dead stores, "
+             << redundant_consts_ << " redundant constants, " << folded_imms_ << " immediates folded, "
+             << dead_instrs_ << " dead instructions, " << fallthrough_branches_ << " fall-through branches removed";
+}
+
+void Peephole::run_on_function(MachineFunction* func)
+{
+    address_taken_.clear();
+    for (auto* bb : func->get_basic_blocks())
+    {
+        for (auto* instr : bb->get_instructions())
+        {
+            if (instr->is_load() or instr->is_store()) continue;
+            for (auto& op : instr->get_operands())
+            {
+                if (op.is_frame_index()) address_taken_.insert(op.get_frame_index());
+            }
+        }
+    }
+
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (auto* bb : func->get_basic_blocks()) changed |= forward_in_block(bb);
+        changed |= remove_dead_stores(func);
+        changed |= remove_dead_instrs(func);
+    }
+    remove_fallthrough_branches(func);
+}
+
+bool Peephole::forward_in_block(MachineBasicBlock* bb)
+{
+    bool changed = false;
+    ConstMap consts;
+    // 寄存器 -> 它所复制的寄存器
+    std::unordered_map<unsigned, MachineOperand> copies;
+    // 栈帧对象 -> 保存着其中的值的寄存器，以及读出该值的指令
+    std::map<Slot, std::pair<MachineOperand, Op>> slot_vals;
+    // 栈帧对象 -> 块内最近一次还没有被读过的存储
+    std::map<Slot, MachineInstr*> last_store;
+
+    auto& instrs = bb->get_instructions();
+    for (auto it = instrs.begin(); it != instrs.end();)
+    {
+        auto* instr = *it;
+        if (instr->is_comment())
+        {
+            ++it;
+            continue;
+        }
+        for (unsigned i = 0; i < instr->get_num_operand(); i++)
+        {
+            if (not instr->is_use_operand(i)) continue;
+            auto copy = copies.find(instr->get_operand(i).get_reg_unit());
+            if (copy == copies.end()) continue;
+            instr->get_operand(i) = copy->second;
+            changed = true;
+        }
+
+        Slot slot;
+        bool tracked = get_slot(instr, slot) and not address_taken_.count(slot.first);
+        if (instr->is_load() and tracked)
+        {
+            auto val = slot_vals.find(slot);
+            if (val != slot_vals.end() and val->second.second == instr->get_opcode())
+            {
+                auto src = val->second.first;
+                auto dst = instr->get_operand(0);
+                forwarded_loads_++;
+                changed = true;
+                if (src == dst)
+                {
+                    it = instrs.erase(it);
+                    delete instr;
+                    continue;
+                }
+                tracked = false;
+                if (dst.is_freg())
+                {
+                    instr->set_opcode(Op::FMOV_S);
+                    instr->get_operands() = { dst, src };
+                }
+                else
+                {
+                    instr->set_opcode(Op::OR);
+                    instr->get_operands() = { dst, src, Reg::zero() };
+                }
+            }
+        }
+
+        auto value = evaluate(instr, consts);
+        bool const_def = value.has_value() and instr->get_operand(0).is_greg() and
+                         not is_reserved(instr->get_operand(0));
+        if (const_def)
+        {
+            auto rd = instr->get_operand(0).get_reg().id;
+            auto known = consts.find(rd);
+            auto next = std::next(it);
+            // lu12i.w 与 ori 一起装入一个常量
+            if (instr->get_opcode() == Op::LU12I_W and next != instrs.end() and
+                (*next)->get_opcode() == Op::ORI and (*next)->get_operand(0) == instr->get_operand(0) and
+                (*next)->get_operand(1) == instr->get_operand(0))
+            {
+                auto full = *value | (*next)->get_operand(2).get_imm();
+                if (known != consts.end() and known->second == full)
+                {
+                    delete *next;
+                    instrs.erase(next);
+                    it = instrs.erase(it);
+                    delete instr;
+                    redundant_consts_++;
+                    changed = true;
+                    continue;
+                }
+            }
+            else if (known != consts.end() and known->second == *value)
+            {
+                it = instrs.erase(it);
+                delete instr;
+                redundant_consts_++;
+                changed = true;
+                continue;
+            }
+            // 运算结果是常量时直接装入
+            bool is_li = instr->get_opcode() == Op::ADDI_W and instr->get_operand(1).get_reg().id == 0;
+            if (not is_li and instr->get_opcode() != Op::LU12I_W and instr->get_opcode() != Op::ORI and
+                fits_imm12(*value))
+            {
+                instr->set_opcode(Op::ADDI_W);
+                instr->get_operands() = { instr->get_operand(0), Reg::zero(), MachineOperand::create_imm(*value) };
+                folded_imms_++;
+                changed = true;
+            }
+        }
+        else if (fold_imm(instr, consts))
+        {
+            folded_imms_++;
+            changed = true;
+        }
+
+        if (instr->is_store() and tracked)
+        {
+            auto prev = last_store.find(slot);
+            if (prev != last_store.end())
+            {
+                bb->erase_instr(prev->second);
+                dead_stores_++;
+                changed = true;
+            }
+            last_store[slot] = instr;
+        }
+        else if (instr->is_load() and tracked)
+        {
+            last_store.erase(slot);
+        }
+
+        auto kill = [&](unsigned unit) {
+            consts.erase(unit);
+            copies.erase(unit);
+            for (auto copy = copies.begin(); copy != copies.end();)
+            {
+                if (copy->second.get_reg_unit() == unit) copy = copies.erase(copy);
+                else ++copy;
+            }
+            for (auto val = slot_vals.begin(); val != slot_vals.end();)
+            {
+                if (val->second.first.get_reg_unit() == unit) val = slot_vals.erase(val);
+                else ++val;
+            }
+        };
+        for (auto& def : instr->get_defs()) kill(def.get_reg_unit());
+        // 栈帧布局可能在这条指令前用 $t8 计算地址
+        if (instr->has_frame_index()) kill(MachineOperand(Reg::t(8)).get_reg_unit());
+        if (const_def) consts[instr->get_operand(0).get_reg().id] = *value;
+        else if (is_move(instr) and instr->get_operand(0) != instr->get_operand(1))
+        {
+            copies.emplace(instr->get_operand(0).get_reg_unit(), instr->get_operand(1));
+        }
+        if (tracked and instr->is_store() and not is_reserved(instr->get_operand(0)))
+        {
+            slot_vals.insert_or_assign(slot, std::make_pair(instr->get_operand(0), load_of(instr->get_opcode())));
+        }
+        else if (tracked and instr->is_load())
+        {
+            slot_vals.insert_or_assign(slot, std::make_pair(instr->get_operand(0), instr->get_opcode()));
+        }
+        ++it;
+    }
+    return changed;
+}
+
+bool Peephole::remove_dead_stores(MachineFunction* func)
+{
+    std::unordered_set<int> read;
+    for (auto* bb : func->get_basic_blocks())
+    {
+        for (auto* instr : bb->get_instructions())
+        {
+            Slot slot;
+            if (instr->is_load() and get_slot(instr, slot)) read.insert(slot.first);
+        }
+    }
+    bool changed = false;
+    for (auto* bb : func->get_basic_blocks())
+    {
+        auto& instrs = bb->get_instructions();
+        for (auto it = instrs.begin(); it != instrs.end();)
+        {
+            Slot slot;
+            if ((*it)->is_store() and get_slot(*it, slot) and not address_taken_.count(slot.first) and
+                not read.count(slot.first))
+            {
+                delete *it;
+                it = instrs.erase(it);
+                dead_stores_++;
+                changed = true;
+            }
+            else ++it;
+        }
+    }
+    return changed;
+}
+
+// 寄存器的活跃分析，删除结果不活跃且没有副作用的指令
+bool Peephole::remove_dead_instrs(MachineFunction* func)
+{
+    auto transfer = [](MachineInstr* instr, RegSet& live) {
+        for (auto& def : instr->get_defs()) live.reset(def.get_reg_unit());
+        for (auto& use : instr->get_uses()) live.set(use.get_reg_unit());
+    };
+    std::unordered_map<MachineBasicBlock*, RegSet> live_in;
+    // 尾声在栈帧布局时才插入，出口块之后返回值仍然活跃
+    auto live_out = [&live_in](MachineBasicBlock* bb) {
+        RegSet live;
+        if (bb->get_succ_basic_blocks().empty())
+        {
+            live.set(MachineOperand(Reg::a(0)).get_reg_unit());
+            live.set(MachineOperand(FReg::fa(0)).get_reg_unit());
+        }
+        for (auto* succ : bb->get_succ_basic_blocks()) live |= live_in[succ];
+        return live;
+    };
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (auto bb = func->get_basic_blocks().rbegin(); bb != func->get_basic_blocks().rend(); ++bb)
+        {
+            auto live = live_out(*bb);
+            auto& instrs = (*bb)->get_instructions();
+            for (auto it = instrs.rbegin(); it != instrs.rend(); ++it) transfer(*it, live);
+            if (live != live_in[*bb])
+            {
+                live_in[*bb] = live;
+                changed = true;
+            }
+        }
+    }
+
+    bool removed = false;
+    for (auto* bb : func->get_basic_blocks())
+    {
+        auto live = live_out(bb);
+        auto& instrs = bb->get_instructions();
+        for (auto it = instrs.end(); it != instrs.begin();)
+        {
+            auto* instr = *--it;
+            if (instr->has_def() and not instr->is_call() and not is_reserved(instr->get_operand(0)) and
+                not live.test(instr->get_operand(0).get_reg_unit()))
+            {
+                it = instrs.erase(it);
+                delete instr;
+                dead_instrs_++;
+                removed = true;
+                continue;
+            }
+            transfer(instr, live);
+        }
+    }
+    return removed;
+}
+
+void Peephole::remove_fallthrough_branches(MachineFunction* func)
+{
+    for (auto* bb : func->get_basic_blocks())
+    {
+        auto* next = func->get_next_basic_block(bb);
+        auto& instrs = bb->get_instructions();
+        auto last = std::find_if(instrs.rbegin(), instrs.rend(), [](MachineInstr* instr) {
+            return not instr->is_comment();
+        });
+        if (next == nullptr or last == instrs.rend() or (*last)->get_opcode() != Op::B or
+            (*last)->get_operand(0).get_block() != next)
+        {
+            continue;
+        }
+        bb->erase_instr(*last);
+        fallthrough_branches_++;
+    }
+}
@@ -23,6 +23,9 @@ std::string Reg::print() const {
     if (id == 22) {
         return "$fp";
     }
+    if (23 <= id and id <= 31) {
+        return "$s" + std::to_string(id - 23);
+    }
     assert(false);
 }
 
@@ -49,6 +52,9 @@ std::string Reg::safe_print() const
     if (id == 22) {
         return "$fp";
     }
+    if (23 <= id and id <= 31) {
+        return "$s" + std::to_string(id - 23);
+    }
     return "<error id " + std::to_string(id) + ">";
 }
 
@@ -0,0 +1,205 @@
+#include "StackColoring.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <map>
+#include <unordered_set>
+
+#include "BlockFrequency.hpp"
+#include "logging.hpp"
+
+using Op = MachineInstr::Opcode;
+
+namespace
+{
+// 访存指令访问的栈帧对象，不是时返回 -1
+int get_frame_index(MachineInstr* instr)
+{
+    if (not instr->is_load() and not instr->is_store()) return -1;
+    auto& base = instr->get_operand(1);
+    return base.is_frame_index() ? base.get_frame_index() : -1;
+}
+
+unsigned store_width(Op op)
+{
+    switch (op)
+    {
+        case Op::ST_B: return 1;
+        case Op::ST_W:
+        case Op::FST_S: return 4;
+        case Op::ST_D:
+        case Op::FST_D: return 8;
+        default: assert(false && "not a store"); return 0;
+    }
+}
+
+using SlotSet = std::vector<bool>;
+
+// 对象集合的并，返回是否有变化
+bool merge(SlotSet& dst, const SlotSet& src)
+{
+    bool changed = false;
+    for (size_t i = 0; i < dst.size(); i++)
+    {
+        if (src[i] and not dst[i]) dst[i] = changed = true;
+    }
+    return changed;
+}
+} // namespace
+
+void StackColoring::run()
+{
+    for (auto* func : funcs_) run_on_function(func);
+}
+
+std::vector<double> StackColoring::compute_weights(MachineFunction* func)
+{
+    BlockFrequency freq(func);
+    std::vector<double> weights(func->get_frame_objects().size(), 0);
+    for (auto* bb : func->get_basic_blocks())
+    {
+        for (auto* instr : bb->get_instructions())
+        {
+            int fi = get_frame_index(instr);
+            if (fi >= 0) weights[fi] += freq.get_frequency(bb);
+        }
+    }
+    return weights;
+}
+
+void StackColoring::run_on_function(MachineFunction* func)
+{
+    auto& objects = func->get_frame_objects();
+    const auto num_objects = objects.size();
+    if (num_objects == 0) return;
+    unsigned before = func->layout_frame();
+
+    // alloca 的空间，可能经指针访问，不参与共享
+    std::unordered_set<int> address_taken;
+    for (auto* bb : func->get_basic_blocks())
+    {
+        for (auto* instr : bb->get_instructions())
+        {
+            if (instr->is_load() or instr->is_store()) continue;
+            for (auto& op : instr->get_operands())
+            {
+                if (op.is_frame_index()) address_taken.insert(op.get_frame_index());
+            }
+        }
+    }
+
+    // 写满整个对象的存储才是定值，只写一部分的存储不结束之前的生命期
+    auto kills = [&](MachineInstr* instr, int fi) {
+        return instr->is_store() and instr->get_operand(2).get_imm() == 0 and
+               store_width(instr->get_opcode()) >= objects[fi].size_;
+    };
+
+    // 栈帧对象的活跃分析
+    std::map<MachineBasicBlock*, SlotSet> live_in, live_out;
+    for (auto* bb : func->get_basic_blocks())
+    {
+        live_in[bb] = SlotSet(num_objects, false);
+        live_out[bb] = SlotSet(num_objects, false);
+    }
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        auto& blocks = func->get_basic_blocks();
+        for (auto it = blocks.rbegin(); it != blocks.rend(); ++it)
+        {
+            auto* bb = *it;
+            for (auto* succ : bb->get_succ_basic_blocks()) changed |= merge(live_out[bb], live_in[succ]);
+            auto live = live_out[bb];
+            auto& instrs = bb->get_instructions();
+            for (auto rit = instrs.rbegin(); rit != instrs.rend(); ++rit)
+            {
+                int fi = get_frame_index(*rit);
+                if (fi < 0) continue;
+                if (kills(*rit, fi))
+                    live[fi] = false;
+                else if ((*rit)->is_load())
+                    live[fi] = true;
+            }
+            changed |= merge(live_in[bb], live);
+        }
+    }
+
+    // 冲突：写一个对象时仍活跃的其他对象
+    std::vector<SlotSet> conflicts(num_objects, SlotSet(num_objects, false));
+    for (auto* bb : func->get_basic_blocks())
+    {
+        auto live = live_out[bb];
+        auto& instrs = bb->get_instructions();
+        for (auto rit = instrs.rbegin(); rit != instrs.rend(); ++rit)
+        {
+            int fi = get_frame_index(*rit);
+            if (fi < 0) continue;
+            if ((*rit)->is_store())
+            {
+                for (unsigned other = 0; other < num_objects; other++)
+                {
+                    if (live[other] and other != static_cast<unsigned>(fi))
+                        conflicts[fi][other] = conflicts[other][fi] = true;
+                }
+            }
+            if (kills(*rit, fi))
+                live[fi] = false;
+            else if ((*rit)->is_load())
+                live[fi] = true;
+        }
+    }
+
+    // 按权重从高到低分配共享栈槽，先建立的栈槽离 $sp 近
+    auto weights = compute_weights(func);
+    std::vector<int> order;
+    for (unsigned i = 0; i < num_objects; i++)
+    {
+        if (not address_taken.count(i)) order.push_back(i);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return weights[a] > weights[b]; });
+
+    std::vector<MachineFunction::FrameObject> slots;
+    std::vector<std::vector<int>> members;
+    std::vector<int> remap(num_objects, -1);
+    for (int fi : order)
+    {
+        unsigned color = 0;
+        for (; color < slots.size(); color++)
+        {
+            bool ok = std::none_of(members[color].begin(), members[color].end(),
+                                   [&](int other) { return conflicts[fi][other]; });
+            if (ok) break;
+        }
+        if (color == slots.size())
+        {
+            slots.push_back({ 0, 1, 0 });
+            members.emplace_back();
+        }
+        slots[color].size_ = std::max(slots[color].size_, objects[fi].size_);
+        slots[color].align_ = std::max(slots[color].align_, objects[fi].align_);
+        members[color].push_back(fi);
+        remap[fi] = static_cast<int>(color);
+    }
+    for (unsigned i = 0; i < num_objects; i++)
+    {
+        if (not address_taken.count(i)) continue;
+        remap[i] = static_cast<int>(slots.size());
+        slots.push_back(objects[i]);
+    }
+
+    for (auto* bb : func->get_basic_blocks())
+    {
+        for (auto* instr : bb->get_instructions())
+        {
+            for (auto& op : instr->get_operands())
+            {
+                if (op.is_frame_index()) op = MachineOperand::create_frame_index(remap[op.get_frame_index()]);
+            }
+        }
+    }
+    objects = std::move(slots);
+    unsigned after = func->layout_frame();
+    LOG_INFO << "stack coloring: " << func->get_name() << " " << num_objects << " frame objects -> "
+             << objects.size() << " slots, frame size " << before << " -> " << after;
+}
@@ -0,0 +1,747 @@
+#include "X86CodeGen.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+#include "BasicBlock.hpp"
+#include "CodeGenUtil.hpp"
+#include "ExecuteCost.hpp"
+#include "Function.hpp"
+#include "Instruction.hpp"
+#include "Type.hpp"
+#include <string>
+
+using GReg = X86CodeGen::GReg;
+
+namespace
+{
+const GReg RAX{"%rax", "%eax", "%al"};
+const GReg RCX{"%rcx", "%ecx", "%cl"};
+const GReg RDX{"%rdx", "%edx", "%dl"};
+
+// System V ABI 的整数参数寄存器，浮点参数依次使用 %xmm0-%xmm7
+const GReg ARG_REGS[] = {
+    {"%rdi", "%edi", "%dil"}, {"%rsi", "%esi", "%sil"}, {"%rdx", "%edx", "%dl"},
+    {"%rcx", "%ecx", "%cl"},  {"%r8", "%r8d", "%r8b"},  {"%r9", "%r9d", "%r9b"},
+};
+const unsigned NUM_ARG_REGS = 6;
+const unsigned NUM_XMM_ARG_REGS = 8;
+
+const char* const FLOAT_POOL_LABEL = ".LCF";
+
+std::string xmm(unsigned i) { return "%xmm" + std::to_string(i); }
+
+std::string imm(int64_t val) { return "$" + std::to_string(val); }
+} // namespace
+
+void X86CodeGen::allocate()
+{
+    // 每个值占一个 8 字节的栈槽，整数和 i1 按 32 位存放
+    unsigned offset = 0;
+    for (auto& arg : context.func->get_args())
+    {
+        offset += 8;
+        context.offset_map[arg] = -static_cast<int>(offset);
+    }
+    unsigned max_phis = 0;
+    for (auto& bb : context.func->get_basic_blocks())
+    {
+        unsigned phis = 0;
+        for (auto& instr : bb->get_instructions())
+        {
+            if (instr->is_phi()) phis++;
+            if (not instr->is_void())
+            {
+                offset += 8;
+                context.offset_map[instr] = -static_cast<int>(offset);
+            }
+            if (instr->is_alloca())
+            {
+                auto* alloca_inst = dynamic_cast<AllocaInst*>(instr);
+                offset = ALIGN(offset + alloca_inst->get_alloca_type()->get_size(), 8);
+                context.alloca_map[alloca_inst] = -static_cast<int>(offset);
+            }
+        }
+        max_phis = std::max(max_phis, phis);
+    }
+    offset += 8 * max_phis;
+    context.phi_temp_offset = -static_cast<int>(offset);
+    context.frame_size = ALIGN(offset, PROLOGUE_ALIGN);
+}
+
+std::string X86CodeGen::slot(Value* val) const { return std::to_string(context.offset_map.at(val)) + "(%rbp)"; }
+
+std::string X86CodeGen::label(BasicBlock* bb) const
+{
+    return ".L" + bb->get_parent()->get_name() + "_" + bb->get_name();
+}
+
+std::string X86CodeGen::float_const(float val)
+{
+    uint32_t bytes = 0;
+    memcpy(&bytes, &val, sizeof(float));
+    auto it = std::find(float_pool.begin(), float_pool.end(), bytes);
+    auto offset = std::distance(float_pool.begin(), it) * 4;
+    if (it == float_pool.end()) float_pool.push_back(bytes);
+    return std::string(FLOAT_POOL_LABEL) + "+" + std::to_string(offset) + "(%rip)";
+}
+
+void X86CodeGen::load_to_greg(Value* val, const GReg& reg)
+{
+    assert(val->get_type()->is_integer_type() ||
+        val->get_type()->is_pointer_type());
+
+    if (auto* constant = dynamic_cast<ConstantInt*>(val))
+    {
+        append_inst("movl", {imm(constant->get_value()), reg.l});
+    }
+    else if (auto* global = dynamic_cast<GlobalVariable*>(val))
+    {
+        append_inst("leaq", {global->get_name() + "(%rip)", reg.q});
+    }
+    else if (val->get_type()->is_pointer_type())
+    {
+        append_inst("movq", {slot(val), reg.q});
+    }
+    else
+    {
+        append_inst("movl", {slot(val), reg.l});
+    }
+}
+
+void X86CodeGen::load_to_xmm(Value* val, const std::string& reg)
+{
+    assert(val->get_type()->is_float_type());
+    if (auto* constant = dynamic_cast<ConstantFP*>(val))
+    {
+        append_inst("movss", {float_const(constant->get_value()), reg});
+    }
+    else
+    {
+        append_inst("movss", {slot(val), reg});
+    }
+}
+
+void X86CodeGen::store_from_greg(Value* val, const GReg& reg)
+{
+    if (val->get_type()->is_pointer_type())
+    {
+        append_inst("movq", {reg.q, slot(val)});
+    }
+    else
+    {
+        append_inst("movl", {reg.l, slot(val)});
+    }
+}
+
+void X86CodeGen::store_from_xmm(Value* val, const std::string& reg) { append_inst("movss", {reg, slot(val)}); }
+
+bool X86CodeGen::has_phi_copy(BasicBlock* succ) const
+{
+    for (auto& inst : succ->get_instructions())
+    {
+        if (not inst->is_phi()) break;
+        for (unsigned i = 1; i < inst->get_operands().size(); i += 2)
+        {
+            if (inst->get_operand(i) == context.bb and inst->get_operand(i - 1) != inst) return true;
+        }
+    }
+    return false;
+}
+
+void X86CodeGen::copy_stmt(BasicBlock* succ)
+{
+    std::vector<std::pair<Instruction*, Value*>> copies;
+    for (auto& inst : succ->get_instructions())
+    {
+        if (not inst->is_phi()) break;
+        for (unsigned i = 1; i < inst->get_operands().size(); i += 2)
+        {
+            if (inst->get_operand(i) == context.bb)
+            {
+                auto* src = inst->get_operand(i - 1);
+                if (src != inst) copies.emplace_back(inst, src);
+                break;
+            }
+        }
+    }
+    // 多于一个复制时先把源值全部读入暂存区，再写入各个 phi，不必考虑复制的顺序
+    bool via_temp = copies.size() > 1;
+    for (unsigned i = 0; i < copies.size(); i++)
+    {
+        auto [phi, src] = copies[i];
+        auto temp = std::to_string(context.phi_temp_offset + 8 * static_cast<int>(i)) + "(%rbp)";
+        if (phi->get_type()->is_float_type())
+        {
+            load_to_xmm(src, "%xmm0");
+            if (via_temp) append_inst("movss", {"%xmm0", temp});
+            else store_from_xmm(phi, "%xmm0");
+        }
+        else
+        {
+            load_to_greg(src, RAX);
+            if (via_temp) append_inst("movq", {"%rax", temp});
+            else store_from_greg(phi, RAX);
+        }
+    }
+    if (not via_temp) return;
+    for (unsigned i = 0; i < copies.size(); i++)
+    {
+        auto* phi = copies[i].first;
+        auto temp = std::to_string(context.phi_temp_offset + 8 * static_cast<int>(i)) + "(%rbp)";
+        if (phi->get_type()->is_float_type())
+        {
+            append_inst("movss", {temp, "%xmm0"});
+            store_from_xmm(phi, "%xmm0");
+        }
+        else
+        {
+            append_inst("movq", {temp, "%rax"});
+            store_from_greg(phi, RAX);
+        }
+    }
+}
+
+void X86CodeGen::gen_prologue()
+{
+    append_inst("pushq %rbp");
+    append_inst("movq", {"%rsp", "%rbp"});
+    if (context.frame_size > 0) append_inst("subq", {imm(context.frame_size), "%rsp"});
+
+    // 寄存器放不下的参数由调用者按顺序压栈，位于返回地址和旧 %rbp 之上
+    unsigned gregs = 0;
+    unsigned xmms = 0;
+    int stack_offset = 16;
+    for (auto arg : context.func->get_args())
+    {
+        bool is_float = arg->get_type()->is_float_type();
+        if (is_float and xmms < NUM_XMM_ARG_REGS)
+        {
+            store_from_xmm(arg, xmm(xmms++));
+        }
+        else if (not is_float and gregs < NUM_ARG_REGS)
+        {
+            store_from_greg(arg, ARG_REGS[gregs++]);
+        }
+        else
+        {
+            append_inst("movq", {std::to_string(stack_offset) + "(%rbp)", "%rax"});
+            append_inst("movq", {"%rax", slot(arg)});
+            stack_offset += 8;
+        }
+    }
+
+    if (context.func->get_name() == "main")
+    {
+        auto allocate_size = get_allocate_size(context.func->get_parent());
+
+        // 总是访问 flags，静态链接时才会带上 io 运行时，在程序结束时输出统计
+        append_inst("addl", {imm(allocate_size), "flags(%rip)"});
+    }
+}
+
+void X86CodeGen::gen_ret()
+{
+    auto* retInst = dynamic_cast<ReturnInst*>(context.inst);
+    auto* retType = context.func->get_return_type();
+    if (retType->is_void_type())
+    {
+        append_inst("movl", {imm(0), "%eax"});
+    }
+    else if (retType->is_float_type())
+    {
+        load_to_xmm(retInst->get_operand(0), "%xmm0");
+    }
+    else
+    {
+        load_to_greg(retInst->get_operand(0), RAX);
+    }
+    append_inst("leave");
+    append_inst("ret");
+}
+
+void X86CodeGen::gen_br()
+{
+    auto* branchInst = dynamic_cast<BranchInst*>(context.inst);
+    if (not branchInst->is_cond_br() or branchInst->get_operand(1) == branchInst->get_operand(2))
+    {
+        auto* succ = dynamic_cast<BasicBlock*>(branchInst->get_operand(branchInst->is_cond_br() ? 1 : 0));
+        copy_stmt(succ);
+        append_inst("jmp", {label(succ)});
+        return;
+    }
+    auto* truebb = dynamic_cast<BasicBlock*>(branchInst->get_operand(1));
+    auto* falsebb = dynamic_cast<BasicBlock*>(branchInst->get_operand(2));
+    load_to_greg(branchInst->get_condition(), RAX);
+    append_inst("testl", {"%eax", "%eax"});
+    if (not has_phi_copy(truebb))
+    {
+        append_inst("jne", {label(truebb)});
+        copy_stmt(falsebb);
+        append_inst("jmp", {label(falsebb)});
+        return;
+    }
+    // 真分支的边上有复制时，假分支的边放在单独的标号之后
+    auto false_edge = ".Ledge" + std::to_string(edge_count++);
+    append_inst("je", {false_edge});
+    copy_stmt(truebb);
+    append_inst("jmp", {label(truebb)});
+    append_inst(false_edge, ASMInstruction::Label);
+    copy_stmt(falsebb);
+    append_inst("jmp", {label(falsebb)});
+}
+
+void X86CodeGen::gen_binary()
+{
+    load_to_greg(context.inst->get_operand(0), RAX);
+    load_to_greg(context.inst->get_operand(1), RCX);
+    switch (context.inst->get_instr_type())
+    {
+        case Instruction::add:
+            append_inst("addl", {"%ecx", "%eax"});
+            break;
+        case Instruction::sub:
+            append_inst("subl", {"%ecx", "%eax"});
+            break;
+        case Instruction::mul:
+            append_inst("imull", {"%ecx", "%eax"});
+            break;
+        case Instruction::sdiv:
+            append_inst("cltd");
+            append_inst("idivl %ecx");
+            break;
+        default:
+            assert(false);
+    }
+    store_from_greg(context.inst, RAX);
+}
+
+void X86CodeGen::gen_float_binary()
+{
+    load_to_xmm(context.inst->get_operand(0), "%xmm0");
+    load_to_xmm(context.inst->get_operand(1), "%xmm1");
+    switch (context.inst->get_instr_type())
+    {
+        case Instruction::fadd:
+            append_inst("addss", {"%xmm1", "%xmm0"});
+            break;
+        case Instruction::fsub:
+            append_inst("subss", {"%xmm1", "%xmm0"});
+            break;
+        case Instruction::fmul:
+            append_inst("mulss", {"%xmm1", "%xmm0"});
+            break;
+        case Instruction::fdiv:
+            append_inst("divss", {"%xmm1", "%xmm0"});
+            break;
+        default:
+            assert(false);
+    }
+    store_from_xmm(context.inst, "%xmm0");
+}
+
+void X86CodeGen::gen_alloca()
+{
+    auto* allocaInst = dynamic_cast<AllocaInst*>(context.inst);
+    append_inst("leaq", {std::to_string(context.alloca_map.at(allocaInst)) + "(%rbp)", "%rax"});
+    store_from_greg(allocaInst, RAX);
+}
+
+void X86CodeGen::gen_load()
+{
+    auto* type = context.inst->get_type();
+    load_to_greg(context.inst->get_operand(0), RAX);
+    if (type->is_float_type())
+    {
+        append_inst("movss", {"(%rax)", "%xmm0"});
+        store_from_xmm(context.inst, "%xmm0");
+    }
+    else if (type->is_int32_type())
+    {
+        append_inst("movl", {"(%rax)", "%eax"});
+        store_from_greg(context.inst, RAX);
+    }
+    else if (type->is_int1_type())
+    {
+        append_inst("movzbl", {"(%rax)", "%eax"});
+        store_from_greg(context.inst, RAX);
+    }
+    else
+    {
+        append_inst("movq", {"(%rax)", "%rax"});
+        store_from_greg(context.inst, RAX);
+    }
+}
+
+void X86CodeGen::gen_store()
+{
+    auto* storeInst = dynamic_cast<StoreInst*>(context.inst);
+    auto* value = storeInst->get_operand(0);
+    load_to_greg(storeInst->get_operand(1), RAX);
+    if (value->get_type()->is_float_type())
+    {
+        load_to_xmm(value, "%xmm0");
+        append_inst("movss", {"%xmm0", "(%rax)"});
+    }
+    else if (value->get_type()->is_int32_type())
+    {
+        load_to_greg(value, RCX);
+        append_inst("movl", {"%ecx", "(%rax)"});
+    }
+    else if (value->get_type()->is_int1_type())
+    {
+        load_to_greg(value, RCX);
+        append_inst("movb", {"%cl", "(%rax)"});
+    }
+    else
+    {
+        load_to_greg(value, RCX);
+        append_inst("movq", {"%rcx", "(%rax)"});
+    }
+}
+
+void X86CodeGen::gen_icmp()
+{
+    load_to_greg(context.inst->get_operand(0), RAX);
+    load_to_greg(context.inst->get_operand(1), RCX);
+    append_inst("cmpl", {"%ecx", "%eax"});
+    switch (context.inst->get_instr_type())
+    {
+        case Instruction::ge:
+            append_inst("setge %al");
+            break;
+        case Instruction::gt:
+            append_inst("setg %al");
+            break;
+        case Instruction::le:
+            append_inst("setle %al");
+            break;
+        case Instruction::lt:
+            append_inst("setl %al");
+            break;
+        case Instruction::eq:
+            append_inst("sete %al");
+            break;
+        case Instruction::ne:
+            append_inst("setne %al");
+            break;
+        default:
+            assert(false);
+    }
+    append_inst("movzbl", {"%al", "%eax"});
+    store_from_greg(context.inst, RAX);
+}
+
+void X86CodeGen::gen_fcmp()
+{
+    // 与 fcmp.s*.s 相同，有 NaN 时所有比较都为假；ucomiss 在无序时置 ZF、PF、CF
+    load_to_xmm(context.inst->get_operand(0), "%xmm0");
+    load_to_xmm(context.inst->get_operand(1), "%xmm1");
+    switch (context.inst->get_instr_type())
+    {
+        case Instruction::fge:
+            append_inst("ucomiss", {"%xmm1", "%xmm0"});
+            append_inst("setae %al");
+            break;
+        case Instruction::fgt:
+            append_inst("ucomiss", {"%xmm1", "%xmm0"});
+            append_inst("seta %al");
+            break;
+        case Instruction::fle:
+            append_inst("ucomiss", {"%xmm0", "%xmm1"});
+            append_inst("setae %al");
+            break;
+        case Instruction::flt:
+            append_inst("ucomiss", {"%xmm0", "%xmm1"});
+            append_inst("seta %al");
+            break;
+        case Instruction::feq:
+            append_inst("ucomiss", {"%xmm1", "%xmm0"});
+            append_inst("sete %al");
+            append_inst("setnp %cl");
+            append_inst("andb", {"%cl", "%al"});
+            break;
+        case Instruction::fne:
+            append_inst("ucomiss", {"%xmm1", "%xmm0"});
+            append_inst("setne %al");
+            append_inst("setnp %cl");
+            append_inst("andb", {"%cl", "%al"});
+            break;
+        default:
+            assert(false);
+    }
+    append_inst("movzbl", {"%al", "%eax"});
+    store_from_greg(context.inst, RAX);
+}
+
+void X86CodeGen::gen_zext()
+{
+    // i1 在栈槽中已经按 32 位存放
+    load_to_greg(context.inst->get_operand(0), RAX);
+    store_from_greg(context.inst, RAX);
+}
+
+void X86CodeGen::gen_call()
+{
+    auto* callInst = dynamic_cast<CallInst*>(context.inst);
+    auto* functionType = static_cast<FunctionType*>(callInst->get_function_type());
+    auto argsNum = functionType->get_num_of_args();
+
+    // 先把寄存器放不下的参数逆序压栈，调用时 %rsp 保持 16 字节对齐
+    std::vector<Value*> stack_args;
+    unsigned gregs = 0;
+    unsigned xmms = 0;
+    for (unsigned i = 0; i < argsNum; i++)
+    {
+        auto* arg = callInst->get_operand(i + 1);
+        bool is_float = functionType->get_param_type(i)->is_float_type();
+        if (is_float ? xmms++ >= NUM_XMM_ARG_REGS : gregs++ >= NUM_ARG_REGS) stack_args.push_back(arg);
+    }
+    int stack_size = static_cast<int>(ALIGN(8 * stack_args.size(), 16));
+    if (stack_size > static_cast<int>(8 * stack_args.size())) append_inst("subq", {imm(8), "%rsp"});
+    for (auto it = stack_args.rbegin(); it != stack_args.rend(); ++it)
+    {
+        if ((*it)->get_type()->is_float_type())
+        {
+            load_to_xmm(*it, "%xmm0");
+            append_inst("movd", {"%xmm0", "%eax"});
+        }
+        else
+        {
+            load_to_greg(*it, RAX);
+        }
+        append_inst("pushq %rax");
+    }
+
+    gregs = 0;
+    xmms = 0;
+    for (unsigned i = 0; i < argsNum; i++)
+    {
+        auto* arg = callInst->get_operand(i + 1);
+        if (functionType->get_param_type(i)->is_float_type())
+        {
+            if (xmms < NUM_XMM_ARG_REGS) load_to_xmm(arg, xmm(xmms));
+            xmms++;
+        }
+        else
+        {
+            if (gregs < NUM_ARG_REGS) load_to_greg(arg, ARG_REGS[gregs]);
+            gregs++;
+        }
+    }
+    auto* func = dynamic_cast<Function*>(callInst->get_operand(0));
+    append_inst("call", {func->get_name()});
+    if (stack_size > 0) append_inst("addq", {imm(stack_size), "%rsp"});
+
+    auto* retType = functionType->get_return_type();
+    if (retType->is_integer_type())
+    {
+        store_from_greg(context.inst, RAX);
+    }
+    else if (retType->is_float_type())
+    {
+        store_from_xmm(context.inst, "%xmm0");
+    }
+}
+
+void X86CodeGen::gen_gep()
+{
+    auto* getElementPtrInst = dynamic_cast<GetElementPtrInst*>(context.inst);
+    unsigned int num = getElementPtrInst->get_num_operand();
+    load_to_greg(getElementPtrInst->get_operand(0), RAX);
+    load_to_greg(getElementPtrInst->get_operand(num - 1), RCX);
+    append_inst("movslq", {"%ecx", "%rcx"});
+    auto elementType = getElementPtrInst->get_element_type();
+    if (elementType->is_float_type() || elementType->is_int32_type())
+    {
+        append_inst("leaq", {"(%rax,%rcx,4)", "%rax"});
+    }
+    else
+    {
+        append_inst("leaq", {"(%rax,%rcx,8)", "%rax"});
+    }
+    store_from_greg(context.inst, RAX);
+}
+
+void X86CodeGen::gen_sitofp()
+{
+    load_to_greg(context.inst->get_operand(0), RAX);
+    append_inst("cvtsi2ssl", {"%eax", "%xmm0"});
+    store_from_xmm(context.inst, "%xmm0");
+}
+
+void X86CodeGen::gen_fptosi()
+{
+    load_to_xmm(context.inst->get_operand(0), "%xmm0");
+    append_inst("cvttss2si", {"%xmm0", "%eax"});
+    store_from_greg(context.inst, RAX);
+}
+
+void X86CodeGen::gen_select()
+{
+    auto* selectInst = dynamic_cast<SelectInst*>(context.inst);
+    if (selectInst->get_type()->is_float_type())
+    {
+        // 浮点数按位模式在通用寄存器中选择
+        load_to_xmm(selectInst->get_true_value(), "%xmm0");
+        load_to_xmm(selectInst->get_false_value(), "%xmm1");
+        append_inst("movd", {"%xmm0", "%ecx"});
+        append_inst("movd", {"%xmm1", "%edx"});
+        load_to_greg(selectInst->get_condition(), RAX);
+        append_inst("testl", {"%eax", "%eax"});
+        append_inst("cmovnel", {"%ecx", "%edx"});
+        append_inst("movd", {"%edx", "%xmm0"});
+        store_from_xmm(context.inst, "%xmm0");
+    }
+    else
+    {
+        load_to_greg(selectInst->get_true_value(), RCX);
+        load_to_greg(selectInst->get_false_value(), RDX);
+        load_to_greg(selectInst->get_condition(), RAX);
+        append_inst("testl", {"%eax", "%eax"});
+        append_inst("cmovneq", {"%rcx", "%rdx"});
+        store_from_greg(context.inst, RDX);
+    }
+}
+
+void X86CodeGen::run()
+{
+    m->set_print_name();
+    if (!m->get_global_variable().empty())
+    {
+        append_inst("Global variables", ASMInstruction::Comment);
+        append_inst(".bss", ASMInstruction::Attribute);
+        for (auto global : m->get_global_variable())
+        {
+            auto size = std::to_string(global->get_type()->get_pointer_element_type()->get_size());
+            append_inst(".globl " + global->get_name(), ASMInstruction::Attribute);
+            append_inst(".align 8", ASMInstruction::Attribute);
+            append_inst(".type " + global->get_name() + ", @object", ASMInstruction::Attribute);
+            append_inst(".size " + global->get_name() + ", " + size, ASMInstruction::Attribute);
+            append_inst(global->get_name(), ASMInstruction::Label);
+            append_inst(".zero " + size, ASMInstruction::Attribute);
+        }
+    }
+
+    append_inst(".text", ASMInstruction::Attribute);
+    for (auto func : m->get_functions())
+    {
+        if (func->is_declaration()) continue;
+        context.clear();
+        context.func = func;
+
+        append_inst(".globl " + func->get_name(), ASMInstruction::Attribute);
+        append_inst(".type " + func->get_name() + ", @function", ASMInstruction::Attribute);
+        append_inst(func->get_name(), ASMInstruction::Label);
+
+        allocate();
+        gen_prologue();
+
+        for (auto& bb : func->get_basic_blocks())
+        {
+            context.bb = bb;
+            append_inst(label(bb), ASMInstruction::Label);
+            auto block_start = std::prev(output.end());
+            for (auto& instr : bb->get_instructions())
+            {
+                context.inst = instr;
+                context.cost += get_execute_cost(instr);
+                append_inst(instr->print(), ASMInstruction::Comment);
+                switch (instr->get_instr_type())
+                {
+                    case Instruction::ret:
+                        gen_ret();
+                        break;
+                    case Instruction::br:
+                        gen_br();
+                        break;
+                    case Instruction::add:
+                    case Instruction::sub:
+                    case Instruction::mul:
+                    case Instruction::sdiv:
+                        gen_binary();
+                        break;
+                    case Instruction::fadd:
+                    case Instruction::fsub:
+                    case Instruction::fmul:
+                    case Instruction::fdiv:
+                        gen_float_binary();
+                        break;
+                    case Instruction::alloca:
+                        gen_alloca();
+                        break;
+                    case Instruction::load:
+                        gen_load();
+                        break;
+                    case Instruction::store:
+                        gen_store();
+                        break;
+                    case Instruction::ge:
+                    case Instruction::gt:
+                    case Instruction::le:
+                    case Instruction::lt:
+                    case Instruction::eq:
+                    case Instruction::ne:
+                        gen_icmp();
+                        break;
+                    case Instruction::fge:
+                    case Instruction::fgt:
+                    case Instruction::fle:
+                    case Instruction::flt:
+                    case Instruction::feq:
+                    case Instruction::fne:
+                        gen_fcmp();
+                        break;
+                    case Instruction::phi:
+                        break;
+                    case Instruction::call:
+                        gen_call();
+                        break;
+                    case Instruction::getelementptr:
+                        gen_gep();
+                        break;
+                    case Instruction::zext:
+                        gen_zext();
+                        break;
+                    case Instruction::fptosi:
+                        gen_fptosi();
+                        break;
+                    case Instruction::sitofp:
+                        gen_sitofp();
+                        break;
+                    case Instruction::select:
+                        gen_select();
+                        break;
+                }
+            }
+            // 进入基本块后总会执行到末尾，在块开头一次加上整块的代价
+            if (context.cost != 0)
+            {
+                output.emplace(std::next(block_start), "addl " + imm(context.cost) + ", flags+4(%rip)");
+                context.cost = 0;
+            }
+        }
+        append_inst(".size " + func->get_name() + ", .-" + func->get_name(), ASMInstruction::Attribute);
+    }
+
+    if (not float_pool.empty())
+    {
+        append_inst("Float constants", ASMInstruction::Comment);
+        append_inst(".section .rodata", ASMInstruction::Attribute);
+        append_inst(".align 4", ASMInstruction::Attribute);
+        append_inst(FLOAT_POOL_LABEL, ASMInstruction::Label);
+        for (auto bits : float_pool) append_inst(".long " + std::to_string(bits), ASMInstruction::Attribute);
+    }
+    append_inst(".section .note.GNU-stack,\"\",@progbits", ASMInstruction::Attribute);
+}
+
+std::string X86CodeGen::print() const
+{
+    std::string result;
+    for (const auto& inst : output)
+    {
+        result += inst.format();
+    }
+    return result;
+}
@@ -140,6 +140,8 @@ static const char* safe_print_instr_op_name(Instruction::OpID id) {
         return "fptosi";
     case Instruction::sitofp:
         return "sitofp";
+    case Instruction::select:
+        return "select";
     }
     return "inst<unknown>";
 }
@@ -208,6 +210,8 @@ std::string print_instr_op_name(Instruction::OpID id) {
         return "fptosi";
     case Instruction::sitofp:
         return "sitofp";
+    case Instruction::select:
+        return "select";
     }
     assert(false && "Must be bug");
 }
@@ -435,6 +439,20 @@ std::string Instruction::safe_print() const
                 instr_ir += safe_print_op_as_op(this, 0, true);
                 return instr_ir;
             }
+        case select:
+            {
+                std::string instr_ir;
+                instr_ir += safe_print_as_op(this, true);
+                instr_ir += " = ";
+                instr_ir += safe_print_instr_op_name(get_instr_type());
+                instr_ir += " ";
+                instr_ir += safe_print_op_as_op(this, 0, true);
+                instr_ir += ", ";
+                instr_ir += safe_print_op_as_op(this, 1, true);
+                instr_ir += ", ";
+                instr_ir += safe_print_op_as_op(this, 2, true);
+                return instr_ir;
+            }
     }
     std::string str;
     str += safe_print_as_op(this, true);
@@ -656,6 +674,21 @@ std::string SiToFpInst::print() {
     return instr_ir;
 }
 
+std::string SelectInst::print() {
+    std::string instr_ir;
+    instr_ir += "%";
+    instr_ir += this->get_name();
+    instr_ir += " = ";
+    instr_ir += get_instr_op_name();
+    instr_ir += " ";
+    instr_ir += print_as_op(this->get_operand(0), true);
+    instr_ir += ", ";
+    instr_ir += print_as_op(this->get_operand(1), true);
+    instr_ir += ", ";
+    instr_ir += print_as_op(this->get_operand(2), true);
+    return instr_ir;
+}
+
 std::string PhiInst::print() {
     std::string instr_ir;
     instr_ir += "%";
@@ -367,6 +367,21 @@ SiToFpInst *SiToFpInst::create_sitofp(Value *val, BasicBlock *bb, const std::str
     return new SiToFpInst(val, bb->get_module()->get_float_type(), bb, name);
 }
 
+SelectInst::SelectInst(Value *cond, Value *if_true, Value *if_false, BasicBlock *bb, const std::string& name)
+    : Instruction(if_true->get_type(), select, name, bb) {
+    assert(cond->get_type()->is_int1_type() && "SelectInst condition is not i1");
+    assert(if_true->get_type() == if_false->get_type() &&
+           "SelectInst operands are not the same type");
+    add_operand(cond);
+    add_operand(if_true);
+    add_operand(if_false);
+}
+
+SelectInst *SelectInst::create_select(Value *cond, Value *if_true, Value *if_false,
+                                      BasicBlock *bb, const std::string& name) {
+    return new SelectInst(cond, if_true, if_false, bb, name);
+}
+
 PhiInst::PhiInst(Type *ty, const std::vector<Value *>& vals,
                  const std::vector<BasicBlock *>& val_bbs, BasicBlock *bb, const std::string& name)
     : Instruction(ty, phi, name, bb) {
@@ -0,0 +1,198 @@
+#include "AliasAnalysis.hpp"
+
+#include <algorithm>
+
+#include "Constant.hpp"
+#include "Function.hpp"
+#include "GlobalVariable.hpp"
+#include "Instruction.hpp"
+
+void AliasAnalysis::run()
+{
+    arg_objects_.clear();
+    unknown_args_.clear();
+    // 形参指向的对象来自所有调用点的实参；实参是调用者的形参时取其指向的对象，迭代到不动点
+    std::vector<Argument*> args;
+    for (auto func : m_->get_functions())
+    {
+        if (func->is_declaration()) continue;
+        for (auto arg : func->get_args())
+        {
+            if (!arg->get_type()->is_pointer_type()) continue;
+            args.emplace_back(arg);
+            arg_objects_[arg];
+            // 没有调用点的函数（例如 main）无法确定实参
+            if (func->get_use_list().empty()) unknown_args_.emplace(arg);
+        }
+    }
+    bool changed;
+    do
+    {
+        changed = false;
+        for (auto arg : args)
+        {
+            if (unknown_args_.count(arg)) continue;
+            auto& objects = arg_objects_[arg];
+            auto old_size = objects.size();
+            for (auto& use : arg->get_parent()->get_use_list())
+            {
+                auto call = dynamic_cast<CallInst*>(use.val_);
+                auto obj = get_underlying_object(call->get_operand(arg->get_arg_no() + 1));
+                auto caller_arg = dynamic_cast<Argument*>(obj);
+                if (obj == nullptr || (caller_arg != nullptr && unknown_args_.count(caller_arg)))
+                {
+                    unknown_args_.emplace(arg);
+                    changed = true;
+                    break;
+                }
+                if (caller_arg == nullptr) objects.emplace(obj);
+                else if (caller_arg != arg)
+                {
+                    for (auto o : arg_objects_[caller_arg]) objects.emplace(o);
+                }
+            }
+            changed |= objects.size() != old_size;
+        }
+    }
+    while (changed);
+}
+
+Value* AliasAnalysis::get_underlying_object(Value* ptr)
+{
+    while (true)
+    {
+        if (dynamic_cast<GlobalVariable*>(ptr) != nullptr || dynamic_cast<Argument*>(ptr) != nullptr) return ptr;
+        auto inst = dynamic_cast<Instruction*>(ptr);
+        if (inst == nullptr) return nullptr;
+        if (inst->is_alloca()) return inst;
+        if (!inst->is_gep()) return nullptr;
+        ptr = inst->get_operand(0);
+    }
+}
+
+AliasAnalysis::Decomposed AliasAnalysis::decompose(Value* ptr)
+{
+    Decomposed ret{ nullptr, 0, {} };
+    auto add_index = [&ret](Value* idx, long long scale) {
+        if (auto c = dynamic_cast<ConstantInt*>(idx))
+        {
+            ret.offset_ += c->get_value() * scale;
+            return;
+        }
+        // idx = x + c 分解为变量 x 和常量 c
+        auto inst = dynamic_cast<Instruction*>(idx);
+        if (inst != nullptr && inst->is_add())
+        {
+            auto c = dynamic_cast<ConstantInt*>(inst->get_operand(1));
+            if (c != nullptr)
+            {
+                idx = inst->get_operand(0);
+                ret.offset_ += c->get_value() * scale;
+            }
+        }
+        for (auto& [var, var_scale] : ret.vars_)
+        {
+            if (var == idx)
+            {
+                var_scale += scale;
+                return;
+            }
+        }
+        ret.vars_.emplace_back(idx, scale);
+    };
+    while (true)
+    {
+        auto inst = dynamic_cast<Instruction*>(ptr);
+        if (inst == nullptr || !inst->is_gep()) break;
+        auto type = inst->get_operand(0)->get_type()->get_pointer_element_type();
+        add_index(inst->get_operand(1), type->get_size());
+        for (unsigned i = 2; i < inst->get_num_operand(); i++)
+        {
+            type = type->get_array_element_type();
+            add_index(inst->get_operand(i), type->get_size());
+        }
+        ptr = inst->get_operand(0);
+    }
+    ret.base_ = get_underlying_object(ptr);
+    ret.vars_.erase(std::remove_if(ret.vars_.begin(), ret.vars_.end(), [](auto& v) { return v.second == 0; }),
+                    ret.vars_.end());
+    std::sort(ret.vars_.begin(), ret.vars_.end());
+    return ret;
+}
+
+bool AliasAnalysis::arg_may_point_to(Argument* arg, Value* obj) const
+{
+    if (unknown_args_.count(arg)) return true;
+    auto it = arg_objects_.find(arg);
+    return it == arg_objects_.end() || it->second.count(obj);
+}
+
+bool AliasAnalysis::may_alias_object(Value* p1, Value* p2) const
+{
+    auto o1 = get_underlying_object(p1);
+    auto o2 = get_underlying_object(p2);
+    if (o1 == nullptr || o2 == nullptr || o1 == o2) return true;
+    auto a1 = dynamic_cast<Argument*>(o1);
+    auto a2 = dynamic_cast<Argument*>(o2);
+    if (a1 == nullptr && a2 == nullptr) return false;
+    if (a1 != nullptr && a2 != nullptr)
+    {
+        if (unknown_args_.count(a1) || unknown_args_.count(a2)) return true;
+        for (auto obj : arg_objects_.at(a1))
+        {
+            if (arg_objects_.at(a2).count(obj)) return true;
+        }
+        return false;
+    }
+    if (a1 == nullptr) std::swap(o1, o2), std::swap(a1, a2);
+    // 形参不会指向本函数的 alloca
+    if (dynamic_cast<AllocaInst*>(o2) != nullptr) return false;
+    return arg_may_point_to(a1, o2);
+}
+
+AliasAnalysis::AliasResult AliasAnalysis::alias(Value* p1, Value* p2) const
+{
+    if (p1 == p2) return MustAlias;
+    if (!may_alias_object(p1, p2)) return NoAlias;
+    auto d1 = decompose(p1);
+    auto d2 = decompose(p2);
+    if (d1.base_ == nullptr || d1.base_ != d2.base_ || d1.vars_ != d2.vars_) return MayAlias;
+    long long size1 = p1->get_type()->get_pointer_element_type()->get_size();
+    long long size2 = p2->get_type()->get_pointer_element_type()->get_size();
+    if (d1.offset_ == d2.offset_ && size1 == size2) return MustAlias;
+    if (d1.offset_ + size1 <= d2.offset_ || d2.offset_ + size2 <= d1.offset_) return NoAlias;
+    return MayAlias;
+}
+
+AliasAnalysis::AliasResult AliasAnalysis::alias_across_iterations(Value* p1, Value* p2) const
+{
+    if (!may_alias_object(p1, p2)) return NoAlias;
+    // 常量偏移和形参下标在各次迭代中不变，这时与同一次迭代中的结果相同
+    auto varies = [](Value* p) {
+        for (auto& [var, scale] : decompose(p).vars_)
+        {
+            if (dynamic_cast<Instruction*>(var) != nullptr) return true;
+        }
+        return false;
+    };
+    if (varies(p1) || varies(p2)) return MayAlias;
+    return alias(p1, p2);
+}
+
+bool AliasAnalysis::may_mod(const CallInst* call, Value* ptr) const
+{
+    for (auto obj : func_info_->get_stores(call))
+    {
+        if (may_alias_object(obj, ptr)) return true;
+    }
+    return false;
+}
+
+bool AliasAnalysis::may_ref(const CallInst* call, Value* ptr) const
+{
+    for (auto obj : func_info_->get_loads(call))
+    {
+        if (may_alias_object(obj, ptr)) return true;
+    }
+    return false;
+}
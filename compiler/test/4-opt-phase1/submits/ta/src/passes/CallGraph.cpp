@@ -0,0 +1,76 @@
+#include "CallGraph.hpp"
+
+#include <algorithm>
+
+#include "BasicBlock.hpp"
+#include "Function.hpp"
+
+void CallGraph::run()
+{
+    call_sites_.clear();
+    callees_.clear();
+    sccs_.clear();
+    scc_index_.clear();
+    for (auto func : m_->get_functions())
+    {
+        auto& sites = call_sites_[func];
+        auto& callees = callees_[func];
+        for (auto bb : func->get_basic_blocks())
+        {
+            for (auto inst : bb->get_instructions())
+            {
+                if (!inst->is_call()) continue;
+                sites.emplace_back(inst->as<CallInst>());
+                auto callee = inst->get_operand(0)->as<Function>();
+                if (std::find(callees.begin(), callees.end(), callee) == callees.end()) callees.emplace_back(callee);
+            }
+        }
+    }
+
+    dfn_.clear();
+    low_.clear();
+    on_stack_.clear();
+    for (auto func : m_->get_functions())
+    {
+        if (!dfn_.count(func)) tarjan(func);
+    }
+}
+
+bool CallGraph::is_recursive(Function* func) const
+{
+    if (sccs_[scc_index_.at(func)].size() > 1) return true;
+    auto& callees = callees_.at(func);
+    return std::find(callees.begin(), callees.end(), func) != callees.end();
+}
+
+void CallGraph::tarjan(Function* func)
+{
+    unsigned index = static_cast<unsigned>(dfn_.size());
+    dfn_[func] = low_[func] = index;
+    stack_.emplace_back(func);
+    on_stack_[func] = true;
+    for (auto callee : callees_[func])
+    {
+        if (!dfn_.count(callee))
+        {
+            tarjan(callee);
+            low_[func] = std::min(low_[func], low_[callee]);
+        }
+        else if (on_stack_[callee]) low_[func] = std::min(low_[func], dfn_[callee]);
+    }
+    if (low_[func] != dfn_[func]) return;
+
+    // func 是分量的根，分量在其所有被调分量之后完成，因此 sccs_ 自然是自底向上的顺序
+    std::vector<Function*> scc;
+    Function* top;
+    do
+    {
+        top = stack_.back();
+        stack_.pop_back();
+        on_stack_[top] = false;
+        scc_index_[top] = static_cast<unsigned>(sccs_.size());
+        scc.emplace_back(top);
+    }
+    while (top != func);
+    sccs_.emplace_back(std::move(scc));
+}
@@ -0,0 +1,154 @@
+#include "Cloner.hpp"
+
+#include "BasicBlock.hpp"
+#include "Module.hpp"
+
+Value* Cloner::lookup(Value* val) const
+{
+    auto it = value_map_.find(val);
+    return it == value_map_.end() ? val : it->second;
+}
+
+Instruction* Cloner::clone_instr(Instruction* inst, BasicBlock* bb)
+{
+    auto op = [inst](unsigned i) { return inst->get_operand(i); };
+    switch (inst->get_instr_type())
+    {
+        case Instruction::ret:
+            if (inst->get_num_operand() == 0 || bb->get_parent()->get_return_type()->is_void_type())
+                return ReturnInst::create_void_ret(bb);
+            return ReturnInst::create_ret(op(0), bb);
+        case Instruction::br:
+            if (inst->get_num_operand() == 1) return BranchInst::create_br(op(0)->as<BasicBlock>(), bb);
+            return BranchInst::create_cond_br(op(0), op(1)->as<BasicBlock>(), op(2)->as<BasicBlock>(), bb);
+        case Instruction::add: return IBinaryInst::create_add(op(0), op(1), bb);
+        case Instruction::sub: return IBinaryInst::create_sub(op(0), op(1), bb);
+        case Instruction::mul: return IBinaryInst::create_mul(op(0), op(1), bb);
+        case Instruction::sdiv: return IBinaryInst::create_sdiv(op(0), op(1), bb);
+        case Instruction::fadd: return FBinaryInst::create_fadd(op(0), op(1), bb);
+        case Instruction::fsub: return FBinaryInst::create_fsub(op(0), op(1), bb);
+        case Instruction::fmul: return FBinaryInst::create_fmul(op(0), op(1), bb);
+        case Instruction::fdiv: return FBinaryInst::create_fdiv(op(0), op(1), bb);
+        case Instruction::alloca: return AllocaInst::create_alloca(inst->as<AllocaInst>()->get_alloca_type(), bb);
+        case Instruction::load: return LoadInst::create_load(op(0), bb);
+        case Instruction::store: return StoreInst::create_store(op(0), op(1), bb);
+        case Instruction::ge: return ICmpInst::create_ge(op(0), op(1), bb);
+        case Instruction::gt: return ICmpInst::create_gt(op(0), op(1), bb);
+        case Instruction::le: return ICmpInst::create_le(op(0), op(1), bb);
+        case Instruction::lt: return ICmpInst::create_lt(op(0), op(1), bb);
+        case Instruction::eq: return ICmpInst::create_eq(op(0), op(1), bb);
+        case Instruction::ne: return ICmpInst::create_ne(op(0), op(1), bb);
+        case Instruction::fge: return FCmpInst::create_fge(op(0), op(1), bb);
+        case Instruction::fgt: return FCmpInst::create_fgt(op(0), op(1), bb);
+        case Instruction::fle: return FCmpInst::create_fle(op(0), op(1), bb);
+        case Instruction::flt: return FCmpInst::create_flt(op(0), op(1), bb);
+        case Instruction::feq: return FCmpInst::create_feq(op(0), op(1), bb);
+        case Instruction::fne: return FCmpInst::create_fne(op(0), op(1), bb);
+        case Instruction::phi:
+            {
+                std::vector<Value*> vals;
+                std::vector<BasicBlock*> bbs;
+                for (auto [val, pre] : inst->as<PhiInst>()->get_phi_pairs())
+                {
+                    vals.emplace_back(val);
+                    bbs.emplace_back(pre);
+                }
+                return PhiInst::create_phi(inst->get_type(), bb, vals, bbs);
+            }
+        case Instruction::call:
+            {
+                std::vector<Value*> args(inst->get_operands().begin() + 1, inst->get_operands().end());
+                return CallInst::create_call(op(0)->as<Function>(), args, bb);
+            }
+        case Instruction::getelementptr:
+            {
+                std::vector<Value*> idxs(inst->get_operands().begin() + 1, inst->get_operands().end());
+                return GetElementPtrInst::create_gep(op(0), idxs, bb);
+            }
+        case Instruction::zext: return ZextInst::create_zext(op(0), inst->get_type(), bb);
+        case Instruction::fptosi: return FpToSiInst::create_fptosi(op(0), inst->get_type(), bb);
+        case Instruction::sitofp: return SiToFpInst::create_sitofp(op(0), bb);
+        case Instruction::select: return SelectInst::create_select(op(0), op(1), op(2), bb);
+    }
+    assert(false && "unknown instruction");
+    return nullptr;
+}
+
+void Cloner::remap(Instruction* inst) const
+{
+    if (inst->is_br())
+    {
+        // 通过 replace_all_bb_match 同时维护前驱后继关系
+        auto br = inst->as<BranchInst>();
+        std::vector<BasicBlock*> targets;
+        for (auto op : br->get_operands())
+        {
+            auto bb = dynamic_cast<BasicBlock*>(op);
+            if (bb != nullptr) targets.emplace_back(bb);
+        }
+        if (br->is_cond_br()) br->set_operand(0, lookup(br->get_operand(0)));
+        for (auto bb : targets) br->replace_all_bb_match(bb, dynamic_cast<BasicBlock*>(lookup(bb)));
+        return;
+    }
+    for (unsigned i = 0; i < inst->get_num_operand(); i++)
+    {
+        auto op = inst->get_operand(i);
+        auto to = lookup(op);
+        if (to != op) inst->set_operand(i, to);
+    }
+}
+
+std::vector<BasicBlock*> Cloner::clone_blocks(const std::vector<BasicBlock*>& blocks, Function* func)
+{
+    auto m = func->get_parent();
+    std::vector<BasicBlock*> ret;
+    for (auto bb : blocks)
+    {
+        auto nbb = BasicBlock::create(m, "", func);
+        value_map_[bb] = nbb;
+        ret.emplace_back(nbb);
+    }
+    std::vector<Instruction*> insts;
+    for (unsigned i = 0; i < blocks.size(); i++)
+    {
+        for (auto inst : blocks[i]->get_instructions())
+        {
+            Instruction* ninst;
+            if (inst->is_ret() && return_block_ != nullptr)
+            {
+                ninst = BranchInst::create_br(return_block_, ret[i]);
+                returns_.emplace_back(inst->get_num_operand() == 0 ? nullptr : inst->get_operand(0), ret[i]);
+            }
+            else ninst = clone_instr(inst, ret[i]);
+            value_map_[inst] = ninst;
+            insts.emplace_back(ninst);
+        }
+    }
+    for (auto inst : insts) remap(inst);
+    for (auto& [val, bb] : returns_)
+    {
+        if (val != nullptr) val = lookup(val);
+    }
+    return ret;
+}
+
+Function* Cloner::clone_function(Function* func, const std::string& name)
+{
+    auto nfunc = Function::create(func->get_function_type(), name, func->get_parent());
+    auto it = nfunc->get_args().begin();
+    for (auto arg : func->get_args())
+    {
+        // 已经预先指定了替换值的形参保持原映射
+        if (!value_map_.count(arg)) value_map_[arg] = *it;
+        ++it;
+    }
+    clone_body(func, nfunc);
+    return nfunc;
+}
+
+void Cloner::clone_body(Function* func, Function* into)
+{
+    assert(into->is_declaration() && "clone into a function with body");
+    std::vector<BasicBlock*> blocks(func->get_basic_blocks().begin(), func->get_basic_blocks().end());
+    clone_blocks(blocks, into);
+}
@@ -0,0 +1,112 @@
+#include "DeadArgElim.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#include "Cloner.hpp"
+#include "logging.hpp"
+
+void DeadArgumentElimination::run()
+{
+    bool changed;
+    do
+    {
+        changed = false;
+        std::vector<Function*> funcs(m_->get_functions().begin(), m_->get_functions().end());
+        for (auto func : funcs)
+        {
+            if (func->is_declaration() || func->get_name() == "main") continue;
+            changed |= run_on_function(func);
+        }
+    }
+    while (changed);
+}
+
+// 在 pos 之前插入对 func 的调用
+static CallInst* create_call_before(Function* func, const std::vector<Value*>& args, Instruction* pos)
+{
+    auto bb = pos->get_parent();
+    auto& insts = bb->get_instructions();
+    auto terminator = insts.back();
+    insts.pop_back();
+    auto call = CallInst::create_call(func, args, bb);
+    insts.pop_back();
+    insts.insert(std::find(insts.begin(), insts.end(), pos), call);
+    insts.push_back(terminator);
+    return call;
+}
+
+bool DeadArgumentElimination::run_on_function(Function* func)
+{
+    // 形参是否有用：除了传给自身递归调用的同一位置之外还有其它使用
+    std::vector<bool> arg_live;
+    for (auto arg : func->get_args())
+    {
+        bool live = false;
+        for (auto& use : arg->get_use_list())
+        {
+            auto call = dynamic_cast<CallInst*>(use.val_);
+            if (call == nullptr || call->get_operand(0) != func || use.arg_no_ != arg->get_arg_no() + 1) live = true;
+        }
+        arg_live.emplace_back(live);
+    }
+    // 返回值是否有用：除了作为自身的返回值之外还有其它使用
+    bool ret_live = false;
+    if (!func->get_return_type()->is_void_type())
+    {
+        for (auto& use : func->get_use_list())
+        {
+            for (auto& ret_use : dynamic_cast<CallInst*>(use.val_)->get_use_list())
+            {
+                auto ret = dynamic_cast<ReturnInst*>(ret_use.val_);
+                if (ret == nullptr || ret->get_function() != func) ret_live = true;
+            }
+        }
+    }
+    bool ret_dead = !func->get_return_type()->is_void_type() && !ret_live;
+    if (!ret_dead && std::all_of(arg_live.begin(), arg_live.end(), [](bool live) { return live; })) return false;
+
+    // 按新的函数类型创建同名函数，放在原函数的位置
+    std::vector<Type*> params;
+    for (auto arg : func->get_args())
+        if (arg_live[arg->get_arg_no()]) params.emplace_back(arg->get_type());
+    auto ret_type = ret_dead ? m_->get_void_type() : func->get_return_type();
+    auto new_func = Function::create(FunctionType::get(ret_type, params), func->get_name(), m_);
+    auto& funcs = m_->get_functions();
+    funcs.pop_back();
+    funcs.insert(std::find(funcs.begin(), funcs.end(), func), new_func);
+
+    Cloner cloner;
+    auto new_arg = new_func->get_args().begin();
+    for (auto arg : func->get_args())
+    {
+        if (!arg_live[arg->get_arg_no()]) continue;
+        cloner.value_map_[arg] = *new_arg;
+        ++new_arg;
+    }
+    cloner.clone_body(func, new_func);
+
+    // 改写调用点，包括新函数体中的递归调用；原函数体内的调用随原函数删除
+    std::vector<CallInst*> calls;
+    for (auto& use : func->get_use_list())
+    {
+        auto call = dynamic_cast<CallInst*>(use.val_);
+        if (call->get_function() != func) calls.emplace_back(call);
+    }
+    for (auto call : calls)
+    {
+        std::vector<Value*> args;
+        for (auto arg : func->get_args())
+            if (arg_live[arg->get_arg_no()]) args.emplace_back(call->get_operand(arg->get_arg_no() + 1));
+        auto new_call = create_call_before(new_func, args, call);
+        if (!ret_dead) call->replace_all_use_with(new_call);
+        call->get_parent()->erase_instr(call);
+    }
+
+    LOG_INFO << "dead argument elimination: " << func->get_name() << " "
+             << std::count(arg_live.begin(), arg_live.end(), false) << " args removed"
+             << (ret_dead ? ", return value removed" : "");
+    funcs.remove(func);
+    delete func;
+    return true;
+}
@@ -1,10 +1,12 @@
 #include "DeadCode.hpp"
 
 #include <queue>
+#include <set>
 #include <unordered_set>
 #include <vector>
 
 #include "FuncInfo.hpp"
+#include "PostDominators.hpp"
 #include "logging.hpp"
 
 // 处理流程：两趟处理，mark 标记有用变量，sweep 删除无用指令
@@ -17,8 +19,15 @@ void DeadCode::run() {
         for (auto func : m_->get_functions()) {
             if (func->is_declaration()) continue;
             if (remove_bb_) changed |= clear_basic_blocks(func);
+            if (aggressive_)
+            {
+                post_dominators_ = new PostDominators(func);
+                post_dominators_->run();
+            }
             mark(func);
             changed |= sweep(func);
+            delete post_dominators_;
+            post_dominators_ = nullptr;
         }
     } while (changed);
     delete func_info;
@@ -96,6 +105,7 @@ bool DeadCode::clear_basic_blocks(Function *func) {
 void DeadCode::mark(Function *func) {
     work_list.clear();
     marked.clear();
+    live_blocks_.clear();
 
     for (auto bb : func->get_basic_blocks()) {
         for (auto ins : bb->get_instructions()) {
@@ -106,12 +116,26 @@ void DeadCode::mark(Function *func) {
         }
     }
 
-    while (work_list.empty() == false) {
-        auto now = work_list.front();
-        work_list.pop_front();
+    bool again;
+    do {
+        while (work_list.empty() == false) {
+            auto now = work_list.front();
+            work_list.pop_front();
 
-        mark(now);
-    }
+            mark(now);
+        }
+        // 找不到有用后必经节点的无用条件跳转无法改写，保留它以及它依赖的指令
+        again = false;
+        if (!aggressive_) break;
+        for (auto bb : func->get_basic_blocks()) {
+            auto br = dynamic_cast<BranchInst *>(bb->get_terminator());
+            if (br == nullptr || !br->is_cond_br() || marked[br]) continue;
+            if (live_post_dominator(bb) != nullptr) continue;
+            marked[br] = true;
+            work_list.push_back(br);
+            again = true;
+        }
+    } while (again);
 }
 
 void DeadCode::mark(const Instruction *ins) {
@@ -126,23 +150,67 @@ void DeadCode::mark(const Instruction *ins) {
         marked[def] = true;
         work_list.push_back(def);
     }
+    if (!aggressive_) return;
+    // 有用指令所在基本块控制依赖的跳转有用；phi 需要区分来源，所以来源基本块的跳转也有用
+    auto mark_terminator = [this](BasicBlock *bb) {
+        auto terminator = bb->get_terminator();
+        if (marked[terminator]) return;
+        marked[terminator] = true;
+        work_list.push_back(terminator);
+    };
+    auto bb = const_cast<BasicBlock *>(ins->get_parent());
+    if (live_blocks_.insert(bb).second) {
+        for (auto dep : post_dominators_->get_control_dependence(bb))
+            mark_terminator(dep);
+    }
+    if (ins->is_phi()) {
+        for (auto [val, pre] : dynamic_cast<const PhiInst *>(ins)->get_phi_pairs())
+            mark_terminator(pre);
+    }
 }
 
 bool DeadCode::sweep(Function *func) {
     bool rm = false; // changed
-    std::unordered_set<Instruction *> wait_del;
+    if (aggressive_) rm |= redirect_dead_branches(func);
+    std::set<Instruction *> wait_del;
     for (auto bb : func->get_basic_blocks()) {
         for (auto inst : bb->get_instructions()) {
             if (marked[inst]) continue; 
+            // ADCE 中剩下的无用跳转都是无条件跳转，保留
+            if (inst->is_br()) continue;
             wait_del.emplace(inst);
         }
-        bb->get_instructions().remove_if([&wait_del](Instruction* i) -> bool {return wait_del.count(i); });
         if (!wait_del.empty()) rm = true;
+        // delete 被删除的指令，使它们不再留在操作数的 use_list 中
+        bb->erase_instrs(wait_del);
         wait_del.clear();
     }
     return rm;
 }
 
+bool DeadCode::redirect_dead_branches(Function *func) {
+    bool changed = false;
+    for (auto bb : func->get_basic_blocks()) {
+        auto br = dynamic_cast<BranchInst *>(bb->get_terminator());
+        if (br == nullptr || !br->is_cond_br() || marked[br]) continue;
+        // 没有有用指令依赖这个分支，两条路径到最近的有用后必经节点之间都没有有用指令
+        auto target = live_post_dominator(bb);
+        // mark 已经保留了没有有用后必经节点的跳转
+        if (target == nullptr) continue;
+        bb->erase_instr(br);
+        BranchInst::create_br(target, bb);
+        changed = true;
+    }
+    return changed;
+}
+
+BasicBlock *DeadCode::live_post_dominator(BasicBlock *bb) const {
+    auto target = post_dominators_->get_ipdom(bb);
+    while (target != nullptr && !live_blocks_.count(target))
+        target = post_dominators_->get_ipdom(target);
+    return target;
+}
+
 bool DeadCode::is_critical(Instruction *ins) const {
     // 对纯函数的无用调用也可以在删除之列
     if (ins->is_call()) {
@@ -152,33 +220,11 @@ bool DeadCode::is_critical(Instruction *ins) const {
             return false;
         return true;
     }
-    if (ins->is_br() || ins->is_ret())
+    if (ins->is_ret())
         return true;
+    if (ins->is_br())
+        return !aggressive_ || !post_dominators_->reach_exit(ins->get_parent());
     if (ins->is_store())
         return true;
     return false;
 }
-
-void DeadCode::sweep_globally() const {
-    std::vector<Function *> unused_funcs;
-    std::vector<GlobalVariable *> unused_globals;
-    for (auto f_r : m_->get_functions()) {
-        if (f_r->get_use_list().empty() and f_r->get_name() != "main")
-            unused_funcs.push_back(f_r);
-    }
-    for (auto glob_var_r : m_->get_global_variable()) {
-        if (glob_var_r->get_use_list().empty())
-            unused_globals.push_back(glob_var_r);
-    }
-    // changed |= unused_funcs.size() or unused_globals.size();
-    for (auto func : unused_funcs)
-    {
-        m_->get_functions().remove(func);
-        delete func;
-    }
-    for (auto glob : unused_globals)
-    {
-        m_->get_global_variable().remove(glob);
-        delete glob;
-    }
-}
@@ -2,50 +2,94 @@
 
 #include <deque>
 #include <queue>
+#include <unordered_set>
 
+#include "CallGraph.hpp"
 #include "Function.hpp"
 #include "logging.hpp"
 
-void FuncInfo::UseMessage::add(Value* val)
+bool FuncInfo::BitSet::set(unsigned i)
 {
-    auto g = dynamic_cast<GlobalVariable*>(val);
-    if (g != nullptr)
+    if (i / 64 >= words_.size()) words_.resize(i / 64 + 1, 0);
+    auto bit = uint64_t{ 1 } << (i % 64);
+    bool changed = !(words_[i / 64] & bit);
+    words_[i / 64] |= bit;
+    return changed;
+}
+
+bool FuncInfo::BitSet::test(unsigned i) const
+{
+    return i / 64 < words_.size() && (words_[i / 64] >> (i % 64) & 1);
+}
+
+bool FuncInfo::BitSet::unite(const BitSet& other)
+{
+    if (other.words_.size() > words_.size()) words_.resize(other.words_.size(), 0);
+    bool changed = false;
+    for (unsigned i = 0; i < other.words_.size(); i++)
+    {
+        auto word = words_[i] | other.words_[i];
+        changed |= word != words_[i];
+        words_[i] = word;
+    }
+    return changed;
+}
+
+bool FuncInfo::BitSet::empty() const
+{
+    for (auto word : words_)
     {
-        globals_.emplace(g);
-        return;
+        if (word != 0) return false;
     }
-    auto arg = dynamic_cast<Argument*>(val);
-    arguments_.emplace(arg);
+    return true;
 }
 
-bool FuncInfo::UseMessage::have(Value* val) const
+unsigned FuncInfo::BitSet::find_next(unsigned i) const
 {
-    auto g = dynamic_cast<GlobalVariable*>(val);
-    if (g != nullptr) return globals_.count(g);
-    return arguments_.count(dynamic_cast<Argument*>(val));
+    while (i < size())
+    {
+        auto word = words_[i / 64] >> (i % 64);
+        if (word != 0)
+        {
+            while (!(word & 1))
+            {
+                word >>= 1;
+                i++;
+            }
+            return i;
+        }
+        i = (i / 64 + 1) * 64;
+    }
+    return size();
 }
 
-bool FuncInfo::UseMessage::empty() const
+bool FuncInfo::add_use(UseMessage& msg, Value* var)
 {
-    return globals_.empty() && arguments_.empty();
+    auto g = dynamic_cast<GlobalVariable*>(var);
+    if (g != nullptr) return msg.globals_.set(global_index_.at(g));
+    return msg.arguments_.set(dynamic_cast<Argument*>(var)->get_arg_no());
 }
 
 void FuncInfo::run()
 {
+    globals_.clear();
+    global_index_.clear();
+    for (auto glob : m_->get_global_variable())
+    {
+        global_index_[glob] = static_cast<unsigned>(globals_.size());
+        globals_.emplace_back(glob);
+    }
+
     std::unordered_map<Value*, Value*> val_to_var;
     // 计算对全局变量的 load/store
     for (auto glob : m_->get_global_variable())
         cal_val_2_var(glob, val_to_var);
-    std::queue<Function*> worklist;
-    std::unordered_set<Function*> in_worklist;
     // 计算对函数参数的 load/store
     // 本质上来说，对局部变量的 load/store 不会在函数外产生副作用，它也不会被用作 func_info 的信息
     for (auto func : m_->get_functions())
     {
         if (func->is_declaration()) continue;
         use_libs[func] = false;
-        worklist.emplace(func);
-        in_worklist.emplace(func);
         for (auto arg : func->get_args())
         {
             if (arg->get_type()->is_pointer_type())
@@ -55,98 +99,64 @@ void FuncInfo::run()
         }
     }
 
-    // 处理函数相互调用导致的隐式 load/store
-    while (!worklist.empty())
+    // 自底向上处理函数相互调用导致的隐式 load/store，以及调用库函数（IO）导致的非纯
+    CallGraph call_graph(m_);
+    call_graph.run();
+    for (auto& scc : call_graph.get_sccs())
     {
-        // 被调用的函数
-        auto calleeF = worklist.front();
-        worklist.pop();
-        in_worklist.erase(calleeF);
-        for (auto& use : calleeF->get_use_list())
+        bool recursive = call_graph.is_recursive(scc.front());
+        bool changed;
+        do
         {
-            // 函数调用指令
-            auto inst = dynamic_cast<CallInst*>(use.val_);
-            // 调用 f 的函数
-            auto callerF = inst->get_parent()->get_parent();
-            auto& callerLoads = loads[callerF];
-            auto& calleeLoads = loads[calleeF];
-            auto& callerStores = stores[callerF];
-            auto& calleeStores = stores[calleeF];
-            // caller 的 load store 数量
-            auto caller_old_load_store_count = callerLoads.globals_.size() + callerLoads.arguments_.size() +
-                                               callerStores.globals_.size() + callerStores.arguments_.size();
-            // caller 同时 load 了 callee load 的全局变量
-            for (auto i : calleeLoads.globals_) callerLoads.globals_.emplace(i);
-            // caller 同时 store 了 callee store 的全局变量
-            for (auto i : calleeStores.globals_) callerStores.globals_.emplace(i);
-            auto& ops = inst->get_operands();
-            // 形式参数
-            for (auto calleArg : calleeF->get_args())
+            changed = false;
+            for (auto func : scc)
             {
-                if (calleArg->get_type()->is_pointer_type())
+                if (func->is_declaration()) continue;
+                for (auto call : call_graph.get_call_sites(func))
                 {
-                    // 传入的实参
-                    auto trueArg = ops[calleArg->get_arg_no() + 1];
-                    // 实参来自哪个临时变量
-                    auto trueArgVar = val_to_var.find(trueArg);
-                    // 来自局部变量，跳过，因为对局部变量的 load/store 不会在函数外产生副作用
-                    if (trueArgVar == val_to_var.end()) continue;
-                    auto trace = trueArgVar->second;
-                    // 添加 load
-                    if (calleeLoads.have(calleArg)) callerLoads.add(trace);
-                    // 添加 store
-                    if (calleeStores.have(calleArg)) callerStores.add(trace);
-                }
-            }
-            // caller f 的 load/store 产生了变化，可能会影响其它调用 f 的函数的 load/store
-            if (callerLoads.globals_.size() + callerLoads.arguments_.size() + callerStores.globals_.size() +
-                callerStores.arguments_.size() != caller_old_load_store_count)
-            {
-                if (!in_worklist.count(callerF))
-                {
-                    in_worklist.emplace(callerF);
-                    worklist.emplace(callerF);
+                    auto callee = call->get_operand(0)->as<Function>();
+                    bool callee_use_libs = callee->is_declaration() || use_libs[callee];
+                    if (callee_use_libs && !use_libs[func])
+                    {
+                        use_libs[func] = true;
+                        changed = true;
+                    }
+                    if (!callee->is_declaration()) changed |= merge_callee(call, val_to_var);
                 }
             }
         }
+        while (recursive && changed);
     }
+    log();
+}
 
-    // 没有 load/store，但是调用了库函数的函数是非纯函数（因为库函数是 IO）
-    for (auto& func : m_->get_functions())
-    {
-        if (func->is_declaration())
-        {
-            for (auto& use : func->get_use_list())
-            {
-                auto call = dynamic_cast<CallInst*>(use.val_);
-                use_libs[call->get_parent()->get_parent()] = true;
-            }
-        }
-        worklist.emplace(func);
-        in_worklist.emplace(func);
-    }
-    while (!worklist.empty())
+bool FuncInfo::merge_callee(CallInst* call, const std::unordered_map<Value*, Value*>& val_2_var)
+{
+    auto calleeF = call->get_operand(0)->as<Function>();
+    auto callerF = call->get_function();
+    auto& callerLoads = loads[callerF];
+    auto& calleeLoads = loads[calleeF];
+    auto& callerStores = stores[callerF];
+    auto& calleeStores = stores[calleeF];
+    // caller 同时 load/store 了 callee load/store 的全局变量
+    bool changed = callerLoads.globals_.unite(calleeLoads.globals_);
+    changed |= callerStores.globals_.unite(calleeStores.globals_);
+    // 形式参数
+    for (auto calleArg : calleeF->get_args())
     {
-        auto f = worklist.front();
-        worklist.pop();
-        in_worklist.erase(f);
-        if (use_libs[f])
-            for (auto& use : f->get_use_list())
-            {
-                auto inst = dynamic_cast<CallInst*>(use.val_);
-                auto cf = inst->get_parent()->get_parent();
-                if (!use_libs[cf])
-                {
-                    use_libs[cf] = true;
-                    if (!in_worklist.count(cf))
-                    {
-                        in_worklist.emplace(cf);
-                        worklist.emplace(cf);
-                    }
-                }
-            }
+        unsigned arg_no = calleArg->get_arg_no();
+        bool load = calleeLoads.arguments_.test(arg_no);
+        bool store = calleeStores.arguments_.test(arg_no);
+        if (!load && !store) continue;
+        // 实参来自哪个变量；来自局部变量时跳过，因为对局部变量的 load/store 不会在函数外产生副作用
+        auto trueArgVar = val_2_var.find(call->get_operand(arg_no + 1));
+        if (trueArgVar == val_2_var.end()) continue;
+        auto trace = trueArgVar->second;
+        // 添加 load / store
+        if (load) changed |= add_use(callerLoads, trace);
+        if (store) changed |= add_use(callerStores, trace);
     }
-    log();
+    return changed;
 }
 
 Value* FuncInfo::store_ptr(const StoreInst* st)
@@ -159,34 +169,75 @@ Value* FuncInfo::load_ptr(const LoadInst* ld)
     return trace_ptr(ld->get_operand(0));
 }
 
-std::unordered_set<Value*> FuncInfo::get_stores(const CallInst* call)
+FuncInfo::AccessView FuncInfo::get_view(const std::unordered_map<Function*, UseMessage>& msgs,
+                                        const CallInst* call) const
 {
     auto func = call->get_operand(0)->as<Function>();
-    if (func->is_declaration()) return {};
-    std::unordered_set<Value*> ret;
-    for (auto i : stores[func].globals_) ret.emplace(i);
-    for (auto arg : stores[func].arguments_)
+    auto it = msgs.find(func);
+    if (func->is_declaration() || it == msgs.end()) return { this, nullptr, call };
+    return { this, &it->second, call };
+}
+
+FuncInfo::AccessView FuncInfo::get_stores(const CallInst* call) const
+{
+    return get_view(stores, call);
+}
+
+FuncInfo::AccessView FuncInfo::get_loads(const CallInst* call) const
+{
+    return get_view(loads, call);
+}
+
+unsigned FuncInfo::AccessView::next(unsigned pos) const
+{
+    unsigned global_bits = msg_->globals_.size();
+    if (pos < global_bits)
     {
-        int arg_no = static_cast<int>(arg->get_arg_no());
-        auto in = call->get_operand(arg_no + 1);
-        ret.emplace(trace_ptr(in));
+        pos = msg_->globals_.find_next(pos);
+        if (pos < global_bits) return pos;
     }
-    return ret;
+    return global_bits + msg_->arguments_.find_next(pos - global_bits);
 }
 
-std::unordered_set<Value*> FuncInfo::get_loads(const CallInst* call)
+FuncInfo::AccessView::iterator FuncInfo::AccessView::begin() const
 {
-    auto func = call->get_operand(0)->as<Function>();
-    if (func->is_declaration()) return {};
-    std::unordered_set<Value*> ret;
-    for (auto i : loads[func].globals_) ret.emplace(i);
-    for (auto arg : loads[func].arguments_)
+    if (msg_ == nullptr) return end();
+    return { this, next(0) };
+}
+
+FuncInfo::AccessView::iterator FuncInfo::AccessView::end() const
+{
+    if (msg_ == nullptr) return { this, 0 };
+    return { this, msg_->globals_.size() + msg_->arguments_.size() };
+}
+
+bool FuncInfo::AccessView::count(Value* var) const
+{
+    if (msg_ == nullptr) return false;
+    auto g = dynamic_cast<GlobalVariable*>(var);
+    if (g != nullptr)
     {
-        int arg_no = static_cast<int>(arg->get_arg_no());
-        auto in = call->get_operand(arg_no + 1);
-        ret.emplace(trace_ptr(in));
+        auto it = info_->global_index_.find(g);
+        return it != info_->global_index_.end() && msg_->globals_.test(it->second);
     }
-    return ret;
+    for (auto arg : *this)
+    {
+        if (arg == var) return true;
+    }
+    return false;
+}
+
+Value* FuncInfo::AccessView::iterator::operator*() const
+{
+    unsigned global_bits = view_->msg_->globals_.size();
+    if (pos_ < global_bits) return view_->info_->globals_[pos_];
+    return trace_ptr(view_->call_->get_operand(pos_ - global_bits + 1));
+}
+
+FuncInfo::AccessView::iterator& FuncInfo::AccessView::iterator::operator++()
+{
+    pos_ = view_->next(pos_ + 1);
+    return *this;
 }
 
 void FuncInfo::log() const
@@ -218,12 +269,12 @@ void FuncInfo::cal_val_2_var(Value* var, std::unordered_map<Value*, Value*>& val
             {
                 case Instruction::load:
                     {
-                        loads[f].add(var);
+                        add_use(loads[f], var);
                         break;
                     }
                 case Instruction::store:
                     {
-                        stores[f].add(var);
+                        add_use(stores[f], var);
                         break;
                     }
                 case Instruction::getelementptr:
@@ -243,8 +294,8 @@ void FuncInfo::cal_val_2_var(Value* var, std::unordered_map<Value*, Value*>& val
                 // auto callF = dynamic_cast<Function*>(inst->get_operand(0));
                 // if (callF->is_declaration())
                 // {
-                //     stores[f].add(var);
-                //     loads[f].add(var);
+                //     add_use(stores[f], var);
+                //     add_use(loads[f], var);
                 // }
                 // break;
                 // }
@@ -0,0 +1,147 @@
+#include "FunctionInline.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+#include "BasicBlock.hpp"
+#include "CallGraph.hpp"
+#include "Cloner.hpp"
+#include "Function.hpp"
+
+static int get_num_of_instr(Function* func)
+{
+    int size = 0;
+    for (auto bb : func->get_basic_blocks()) size += bb->get_num_of_instr();
+    return size;
+}
+
+void FunctionInline::run()
+{
+    find_recursive();
+    for (auto func : m_->get_functions())
+    {
+        if (func->is_declaration()) continue;
+        // 内联进来的函数体中可能还有可以内联的调用
+        bool changed;
+        do
+        {
+            changed = false;
+            std::vector<CallInst*> calls;
+            for (auto bb : func->get_basic_blocks())
+            {
+                for (auto inst : bb->get_instructions())
+                {
+                    if (inst->is_call()) calls.emplace_back(inst->as<CallInst>());
+                }
+            }
+            for (auto call : calls)
+            {
+                if (!should_inline(call)) continue;
+                inline_call(call);
+                changed = true;
+            }
+        }
+        while (changed);
+    }
+}
+
+void FunctionInline::find_recursive()
+{
+    recursive_.clear();
+    CallGraph call_graph(m_);
+    call_graph.run();
+    for (auto func : m_->get_functions())
+    {
+        if (call_graph.is_recursive(func)) recursive_.emplace(func);
+    }
+}
+
+bool FunctionInline::should_inline(CallInst* call) const
+{
+    auto caller = call->get_function();
+    auto callee = call->get_operand(0)->as<Function>();
+    if (callee->is_declaration() || callee == caller || recursive_.count(callee)) return false;
+    // 入口块有前驱时无法直接从调用处跳入
+    if (!callee->get_entry_block()->get_pre_basic_blocks().empty()) return false;
+    // 没有 ret 的函数（死循环）没有可以替换调用的返回值
+    bool has_ret = false;
+    for (auto bb : callee->get_basic_blocks())
+    {
+        if (bb->is_terminated() && bb->get_terminator()->is_ret()) has_ret = true;
+    }
+    if (!has_ret) return false;
+    int size = get_num_of_instr(callee);
+    if (get_num_of_instr(caller) + size > INLINE_CALLER_SIZE) return false;
+    if (size <= INLINE_SIZE) return true;
+    return callee->get_use_list().size() == 1 && size <= INLINE_SINGLE_SITE_SIZE;
+}
+
+void FunctionInline::inline_call(CallInst* call)
+{
+    auto bb = call->get_parent();
+    auto func = bb->get_parent();
+    auto callee = call->get_operand(0)->as<Function>();
+
+    // 调用之后的指令移到新块 cont，bb 原来的后继改为 cont 的后继
+    auto cont = BasicBlock::create(m_, "", func);
+    auto& insts = bb->get_instructions();
+    auto& cont_insts = cont->get_instructions();
+    auto call_pos = std::find(insts.begin(), insts.end(), call);
+    cont_insts.splice(cont_insts.end(), insts, std::next(call_pos), insts.end());
+    for (auto inst : cont_insts) inst->set_parent(cont);
+    for (auto succ : bb->get_succ_basic_blocks())
+    {
+        succ->remove_pre_basic_block(bb);
+        succ->add_pre_basic_block(cont);
+        cont->add_succ_basic_block(succ);
+        for (auto inst : succ->get_instructions())
+        {
+            if (!inst->is_phi()) break;
+            for (unsigned i = 1; i < inst->get_num_operand(); i += 2)
+            {
+                if (inst->get_operand(i) == bb) inst->set_operand(i, cont);
+            }
+        }
+    }
+    bb->get_succ_basic_blocks().clear();
+
+    Cloner cloner;
+    for (auto arg : callee->get_args()) cloner.value_map_[arg] = call->get_operand(arg->get_arg_no() + 1);
+    cloner.return_block_ = cont;
+    std::vector<BasicBlock*> blocks(callee->get_basic_blocks().begin(), callee->get_basic_blocks().end());
+    auto new_blocks = cloner.clone_blocks(blocks, func);
+
+    // alloca 统一放在入口块
+    auto entry = func->get_entry_block();
+    for (auto nbb : new_blocks)
+    {
+        std::vector<Instruction*> allocas;
+        for (auto inst : nbb->get_instructions())
+        {
+            if (inst->is_alloca()) allocas.emplace_back(inst);
+        }
+        for (auto inst : allocas)
+        {
+            nbb->remove_instr(inst);
+            inst->set_parent(entry);
+            entry->add_instruction(inst);
+        }
+    }
+
+    bb->remove_instr(call);
+    BranchInst::create_br(new_blocks.front(), bb);
+    if (!call->get_type()->is_void_type())
+    {
+        Value* ret_val;
+        if (cloner.returns_.size() == 1) ret_val = cloner.returns_.front().first;
+        else
+        {
+            auto phi = PhiInst::create_phi(call->get_type(), cont);
+            for (auto [val, pre] : cloner.returns_) phi->add_phi_pair_operand(val, pre);
+            ret_val = phi;
+        }
+        call->replace_all_use_with(ret_val);
+    }
+    delete call;
+}
@@ -0,0 +1,107 @@
+#include "GlobalDCE.hpp"
+
+#include <unordered_set>
+#include <vector>
+
+#include "BasicBlock.hpp"
+#include "DeadArgElim.hpp"
+#include "DeadCode.hpp"
+#include "Function.hpp"
+#include "FunctionInline.hpp"
+#include "GlobalVariable.hpp"
+#include "logging.hpp"
+
+void GlobalDeadCodeElimination::run()
+{
+    while (sweep() && (inline_funcs_ || dead_args_))
+    {
+        if (inline_funcs_)
+        {
+            FunctionInline inliner(m_);
+            inliner.run();
+        }
+        if (dead_args_)
+        {
+            DeadArgumentElimination dae(m_);
+            dae.run();
+        }
+        DeadCode dce(m_, true);
+        dce.run();
+    }
+    LOG_INFO << "global dead code elimination: " << removed_funcs_ << " functions, " << removed_bytes_
+             << " bytes of globals removed";
+}
+
+bool GlobalDeadCodeElimination::sweep()
+{
+    Function* main_func = nullptr;
+    for (auto func : m_->get_functions())
+    {
+        if (func->get_name() == "main") main_func = func;
+    }
+    if (main_func == nullptr) return false;
+
+    // 标记从 main 可达的函数和全局变量
+    std::unordered_set<Value*> live{ main_func };
+    std::vector<Function*> worklist{ main_func };
+    while (!worklist.empty())
+    {
+        auto func = worklist.back();
+        worklist.pop_back();
+        for (auto bb : func->get_basic_blocks())
+        {
+            for (auto inst : bb->get_instructions())
+            {
+                for (auto op : inst->get_operands())
+                {
+                    if (auto callee = dynamic_cast<Function*>(op))
+                    {
+                        if (live.emplace(callee).second) worklist.emplace_back(callee);
+                    }
+                    else if (dynamic_cast<GlobalVariable*>(op) != nullptr) live.emplace(op);
+                }
+            }
+        }
+    }
+
+    std::vector<Function*> dead_funcs;
+    for (auto func : m_->get_functions())
+    {
+        if (!func->is_declaration() && !live.count(func)) dead_funcs.emplace_back(func);
+    }
+    std::vector<GlobalVariable*> dead_globals;
+    for (auto glob : m_->get_global_variable())
+    {
+        if (!live.count(glob)) dead_globals.emplace_back(glob);
+    }
+    if (dead_funcs.empty() && dead_globals.empty()) return false;
+
+    // 不可达的函数之间可能互相引用，先断开全部引用；跳转指令析构时要维护前驱后继，在基本块删除前单独删除
+    for (auto func : dead_funcs)
+    {
+        for (auto bb : func->get_basic_blocks())
+        {
+            for (auto inst : bb->get_instructions())
+            {
+                if (!inst->is_br()) inst->remove_all_operands();
+            }
+        }
+    }
+    for (auto func : dead_funcs)
+    {
+        for (auto bb : func->get_basic_blocks())
+        {
+            if (bb->is_terminated()) bb->erase_instr(bb->get_terminator());
+        }
+        m_->get_functions().remove(func);
+        delete func;
+    }
+    for (auto glob : dead_globals)
+    {
+        removed_bytes_ += glob->get_type()->get_pointer_element_type()->get_size();
+        m_->get_global_variable().remove(glob);
+        delete glob;
+    }
+    removed_funcs_ += static_cast<int>(dead_funcs.size());
+    return true;
+}
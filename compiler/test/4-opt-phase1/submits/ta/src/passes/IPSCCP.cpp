@@ -0,0 +1,440 @@
+#include "IPSCCP.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <map>
+
+#include "Cloner.hpp"
+#include "logging.hpp"
+
+// 函数是否参与过程间传播：main 的参数和返回值来自外部，库函数没有函数体
+static bool is_tracked(Function* func)
+{
+    return !func->is_declaration() && func->get_name() != "main";
+}
+
+bool IPSCCP::LatticeValue::merge(const LatticeValue& other)
+{
+    if (other.kind_ == UNDEF || kind_ == OVERDEF) return false;
+    if (kind_ == UNDEF)
+    {
+        *this = other;
+        return true;
+    }
+    if (other.kind_ == CONST && other.const_ == const_) return false;
+    kind_ = OVERDEF;
+    const_ = nullptr;
+    return true;
+}
+
+void IPSCCP::run()
+{
+    solve();
+    bool changed = rewrite();
+    if (specialize_ && specialize())
+    {
+        solve();
+        changed |= rewrite();
+    }
+    if (changed) LOG_INFO << "ipsccp changed module";
+}
+
+IPSCCP::LatticeValue IPSCCP::get_value(Value* val)
+{
+    LatticeValue lv;
+    if (auto c = dynamic_cast<ConstantInt*>(val))
+    {
+        lv.kind_ = LatticeValue::CONST;
+        lv.const_ = c;
+        return lv;
+    }
+    if (auto c = dynamic_cast<ConstantFP*>(val))
+    {
+        lv.kind_ = LatticeValue::CONST;
+        lv.const_ = c;
+        return lv;
+    }
+    if (dynamic_cast<Instruction*>(val) != nullptr || dynamic_cast<Argument*>(val) != nullptr
+        || dynamic_cast<Function*>(val) != nullptr)
+    {
+        auto it = values_.find(val);
+        if (it != values_.end()) return it->second;
+        return lv;
+    }
+    // 全局变量地址等
+    lv.kind_ = LatticeValue::OVERDEF;
+    return lv;
+}
+
+void IPSCCP::update(Value* val, const LatticeValue& lv)
+{
+    if (values_[val].merge(lv)) value_work_list_.emplace_back(val);
+}
+
+void IPSCCP::mark_executable(BasicBlock* bb)
+{
+    if (executable_.insert(bb).second) bb_work_list_.emplace_back(bb);
+}
+
+void IPSCCP::mark_edge(BasicBlock* from, BasicBlock* to)
+{
+    if (!executable_edges_.emplace(from, to).second) return;
+    if (executable_.count(to))
+    {
+        // 新的可执行边只影响 to 中的 phi
+        for (auto inst : to->get_instructions())
+        {
+            if (!inst->is_phi()) break;
+            visit(inst);
+        }
+    }
+    else mark_executable(to);
+}
+
+void IPSCCP::solve()
+{
+    values_.clear();
+    executable_.clear();
+    executable_edges_.clear();
+    call_sites_.clear();
+    bb_work_list_.clear();
+    value_work_list_.clear();
+
+    for (auto func : m_->get_functions())
+    {
+        if (func->is_declaration()) continue;
+        if (!is_tracked(func))
+        {
+            LatticeValue over;
+            over.kind_ = LatticeValue::OVERDEF;
+            for (auto arg : func->get_args()) values_[arg] = over;
+            mark_executable(func->get_entry_block());
+        }
+    }
+
+    while (!bb_work_list_.empty() || !value_work_list_.empty())
+    {
+        while (!value_work_list_.empty())
+        {
+            auto val = value_work_list_.front();
+            value_work_list_.pop_front();
+            if (auto func = dynamic_cast<Function*>(val))
+            {
+                // 返回值改变，重新计算调用点
+                for (auto call : call_sites_[func]) update(call, values_[func]);
+                continue;
+            }
+            for (auto& use : val->get_use_list())
+            {
+                auto inst = dynamic_cast<Instruction*>(use.val_);
+                if (inst != nullptr && executable_.count(inst->get_parent())) visit(inst);
+            }
+        }
+        while (!bb_work_list_.empty())
+        {
+            auto bb = bb_work_list_.front();
+            bb_work_list_.pop_front();
+            for (auto inst : bb->get_instructions()) visit(inst);
+        }
+    }
+}
+
+void IPSCCP::visit_call(CallInst* call)
+{
+    auto callee = call->get_operand(0)->as<Function>();
+    LatticeValue over;
+    over.kind_ = LatticeValue::OVERDEF;
+    if (!is_tracked(callee))
+    {
+        if (!call->is_void()) update(call, over);
+        return;
+    }
+    auto& sites = call_sites_[callee];
+    if (std::find(sites.begin(), sites.end(), call) == sites.end()) sites.emplace_back(call);
+    for (auto arg : callee->get_args())
+    {
+        update(arg, get_value(call->get_operand(arg->get_arg_no() + 1)));
+    }
+    mark_executable(callee->get_entry_block());
+    if (!call->is_void()) update(call, get_value(callee));
+}
+
+void IPSCCP::visit(Instruction* inst)
+{
+    LatticeValue over;
+    over.kind_ = LatticeValue::OVERDEF;
+    auto bb = inst->get_parent();
+    switch (inst->get_instr_type())
+    {
+        case Instruction::phi:
+            {
+                LatticeValue lv;
+                for (auto [val, pre] : inst->as<PhiInst>()->get_phi_pairs())
+                {
+                    if (executable_edges_.count({pre, bb})) lv.merge(get_value(val));
+                }
+                update(inst, lv);
+                return;
+            }
+        case Instruction::br:
+            {
+                auto br = inst->as<BranchInst>();
+                if (!br->is_cond_br())
+                {
+                    mark_edge(bb, br->get_operand(0)->as<BasicBlock>());
+                    return;
+                }
+                auto cond = get_value(br->get_condition());
+                if (cond.kind_ == LatticeValue::UNDEF) return;
+                auto if_true = br->get_operand(1)->as<BasicBlock>();
+                auto if_false = br->get_operand(2)->as<BasicBlock>();
+                if (cond.kind_ == LatticeValue::OVERDEF)
+                {
+                    mark_edge(bb, if_true);
+                    mark_edge(bb, if_false);
+                }
+                else mark_edge(bb, dynamic_cast<ConstantInt*>(cond.const_)->get_value() ? if_true : if_false);
+                return;
+            }
+        case Instruction::ret:
+            {
+                auto func = bb->get_parent();
+                if (inst->get_num_operand() != 0 && is_tracked(func)) update(func, get_value(inst->get_operand(0)));
+                return;
+            }
+        case Instruction::call:
+            visit_call(inst->as<CallInst>());
+            return;
+        case Instruction::store:
+            return;
+        case Instruction::select:
+            {
+                auto sel = inst->as<SelectInst>();
+                auto cond = get_value(sel->get_condition());
+                if (cond.kind_ == LatticeValue::UNDEF) return;
+                if (cond.kind_ == LatticeValue::CONST)
+                {
+                    bool taken = dynamic_cast<ConstantInt*>(cond.const_)->get_value();
+                    update(inst, get_value(taken ? sel->get_true_value() : sel->get_false_value()));
+                    return;
+                }
+                // 条件不确定时取两侧的交
+                LatticeValue lv = get_value(sel->get_true_value());
+                lv.merge(get_value(sel->get_false_value()));
+                update(inst, lv);
+                return;
+            }
+        case Instruction::alloca:
+        case Instruction::load:
+        case Instruction::getelementptr:
+            // 不跟踪内存中的值
+            update(inst, over);
+            return;
+        default:
+            break;
+    }
+
+    // 运算指令：有不确定的操作数则不确定，全为常量则折叠
+    std::vector<Constant*> ops;
+    for (auto op : inst->get_operands())
+    {
+        auto lv = get_value(op);
+        if (lv.kind_ == LatticeValue::OVERDEF)
+        {
+            update(inst, over);
+            return;
+        }
+        if (lv.kind_ == LatticeValue::UNDEF) return;
+        ops.emplace_back(lv.const_);
+    }
+    auto c = fold(inst, ops);
+    if (c == nullptr)
+    {
+        update(inst, over);
+        return;
+    }
+    LatticeValue lv;
+    lv.kind_ = LatticeValue::CONST;
+    lv.const_ = c;
+    update(inst, lv);
+}
+
+Constant* IPSCCP::fold(Instruction* inst, const std::vector<Constant*>& ops) const
+{
+    auto int_of = [&](int i) { return dynamic_cast<ConstantInt*>(ops[i])->get_value(); };
+    auto float_of = [&](int i) { return dynamic_cast<ConstantFP*>(ops[i])->get_value(); };
+    // 按 32 位补码回绕
+    auto wrap = [](long long v) { return static_cast<int>(static_cast<unsigned>(v)); };
+    // 负零和 NaN 在常量池中无法区分，不折叠
+    auto make_float = [this](float v) -> Constant* {
+        if (std::isnan(v) || (v == 0 && std::signbit(v))) return nullptr;
+        return ConstantFP::get(v, m_);
+    };
+    switch (inst->get_instr_type())
+    {
+        case Instruction::add: return ConstantInt::get(wrap(static_cast<long long>(int_of(0)) + int_of(1)), m_);
+        case Instruction::sub: return ConstantInt::get(wrap(static_cast<long long>(int_of(0)) - int_of(1)), m_);
+        case Instruction::mul: return ConstantInt::get(wrap(static_cast<long long>(int_of(0)) * int_of(1)), m_);
+        case Instruction::sdiv:
+            // 除零和溢出保留到运行时
+            if (int_of(1) == 0 || (int_of(0) == INT_MIN && int_of(1) == -1)) return nullptr;
+            return ConstantInt::get(int_of(0) / int_of(1), m_);
+        case Instruction::fadd: return make_float(float_of(0) + float_of(1));
+        case Instruction::fsub: return make_float(float_of(0) - float_of(1));
+        case Instruction::fmul: return make_float(float_of(0) * float_of(1));
+        case Instruction::fdiv: return make_float(float_of(0) / float_of(1));
+        case Instruction::ge: return ConstantInt::get(int_of(0) >= int_of(1), m_);
+        case Instruction::gt: return ConstantInt::get(int_of(0) > int_of(1), m_);
+        case Instruction::le: return ConstantInt::get(int_of(0) <= int_of(1), m_);
+        case Instruction::lt: return ConstantInt::get(int_of(0) < int_of(1), m_);
+        case Instruction::eq: return ConstantInt::get(int_of(0) == int_of(1), m_);
+        case Instruction::ne: return ConstantInt::get(int_of(0) != int_of(1), m_);
+        case Instruction::fge: return ConstantInt::get(float_of(0) >= float_of(1), m_);
+        case Instruction::fgt: return ConstantInt::get(float_of(0) > float_of(1), m_);
+        case Instruction::fle: return ConstantInt::get(float_of(0) <= float_of(1), m_);
+        case Instruction::flt: return ConstantInt::get(float_of(0) < float_of(1), m_);
+        case Instruction::feq: return ConstantInt::get(float_of(0) == float_of(1), m_);
+        case Instruction::fne: return ConstantInt::get(float_of(0) != float_of(1), m_);
+        case Instruction::zext: return ConstantInt::get(int_of(0), m_);
+        case Instruction::sitofp: return make_float(static_cast<float>(int_of(0)));
+        case Instruction::fptosi:
+            {
+                float v = float_of(0);
+                if (!(v > -2147483904.0F && v < 2147483648.0F)) return nullptr;
+                return ConstantInt::get(static_cast<int>(v), m_);
+            }
+        default:
+            return nullptr;
+    }
+}
+
+bool IPSCCP::rewrite()
+{
+    bool changed = false;
+    auto const_of = [this](Value* val) -> Constant* {
+        auto it = values_.find(val);
+        if (it == values_.end() || it->second.kind_ != LatticeValue::CONST) return nullptr;
+        return it->second.const_;
+    };
+    for (auto func : m_->get_functions())
+    {
+        if (func->is_declaration() || !executable_.count(func->get_entry_block())) continue;
+        for (auto arg : func->get_args())
+        {
+            auto c = const_of(arg);
+            if (c != nullptr && !arg->get_use_list().empty())
+            {
+                arg->replace_all_use_with(c);
+                changed = true;
+            }
+        }
+        for (auto bb : func->get_basic_blocks())
+        {
+            if (!executable_.count(bb)) continue;
+            std::set<Instruction*> erased;
+            for (auto inst : bb->get_instructions())
+            {
+                auto c = const_of(inst);
+                if (c != nullptr)
+                {
+                    if (!inst->get_use_list().empty())
+                    {
+                        inst->replace_all_use_with(c);
+                        changed = true;
+                    }
+                    // 调用可能有副作用，只替换其返回值
+                    if (!inst->is_call()) erased.emplace(inst);
+                }
+            }
+            bb->erase_instrs(erased);
+            changed |= !erased.empty();
+
+            // 只有一条出边可执行的条件跳转改为无条件跳转
+            auto br = dynamic_cast<BranchInst*>(bb->get_terminator());
+            if (br == nullptr || !br->is_cond_br()) continue;
+            auto if_true = br->get_operand(1)->as<BasicBlock>();
+            auto if_false = br->get_operand(2)->as<BasicBlock>();
+            bool true_live = executable_edges_.count({bb, if_true});
+            bool false_live = executable_edges_.count({bb, if_false});
+            if (true_live == false_live || if_true == if_false) continue;
+            auto target = true_live ? if_true : if_false;
+            auto dead = true_live ? if_false : if_true;
+            for (auto inst : dead->get_instructions())
+            {
+                if (!inst->is_phi()) break;
+                for (int i = static_cast<int>(inst->get_num_operand()) - 1; i > 0; i -= 2)
+                {
+                    if (inst->get_operand(i) == bb)
+                    {
+                        inst->remove_operand(i);
+                        inst->remove_operand(i - 1);
+                    }
+                }
+            }
+            bb->erase_instr(br);
+            BranchInst::create_br(target, bb);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+/**
+ * @brief 按常量实参组合复制函数
+ *
+ * 统计每个函数的调用点中常量实参的组合，对调用次数最多的组合优先特化。
+ * 只有被特化函数体中确实使用了这些形参，且组合没有覆盖该函数的全部调用点时才复制
+ * （覆盖全部调用点时 IPSCCP 本身就能传播这些常量）。
+ */
+bool IPSCCP::specialize()
+{
+    int budget = SPECIALIZE_BUDGET;
+    bool changed = false;
+    std::vector<Function*> funcs(m_->get_functions().begin(), m_->get_functions().end());
+    for (auto func : funcs)
+    {
+        if (!is_tracked(func)) continue;
+        int size = 0;
+        for (auto bb : func->get_basic_blocks()) size += bb->get_num_of_instr();
+        if (size > SPECIALIZE_FUNC_SIZE) continue;
+
+        // 常量实参组合（形参序号 -> 常量） -> 调用点
+        std::map<std::vector<std::pair<unsigned, Value*>>, std::vector<CallInst*>> groups;
+        int call_count = 0;
+        for (auto& use : func->get_use_list())
+        {
+            auto call = dynamic_cast<CallInst*>(use.val_);
+            if (call == nullptr || use.arg_no_ != 0) continue;
+            // 递归调用不特化，避免重复复制
+            if (call->get_function() == func) continue;
+            call_count++;
+            std::vector<std::pair<unsigned, Value*>> key;
+            for (auto arg : func->get_args())
+            {
+                auto actual = call->get_operand(arg->get_arg_no() + 1);
+                if (arg->get_use_list().empty()) continue;
+                if (dynamic_cast<ConstantInt*>(actual) != nullptr || dynamic_cast<ConstantFP*>(actual) != nullptr)
+                    key.emplace_back(arg->get_arg_no(), actual);
+            }
+            if (!key.empty()) groups[key].emplace_back(call);
+        }
+
+        std::vector<std::pair<std::vector<std::pair<unsigned, Value*>>, std::vector<CallInst*>>> order(groups.begin(), groups.end());
+        std::stable_sort(order.begin(), order.end(), [](const auto& a, const auto& b) { return a.second.size() > b.second.size(); });
+        int count = 0;
+        for (auto& [key, calls] : order)
+        {
+            if (count >= SPECIALIZE_PER_FUNC || budget < size) break;
+            if (static_cast<int>(calls.size()) == call_count) continue;
+            Cloner cloner;
+            auto spec = cloner.clone_function(func, func->get_name() + "_spec" + std::to_string(count));
+            for (auto call : calls) call->set_operand(0, spec);
+            budget -= size;
+            count++;
+            changed = true;
+            LOG_INFO << "specialize " << func->get_name() << " as " << spec->get_name() << " for " << calls.size() << " calls";
+        }
+    }
+    return changed;
+}
@@ -0,0 +1,236 @@
+#include "IfConversion.hpp"
+
+#include <vector>
+
+#include "BasicBlock.hpp"
+#include "Function.hpp"
+#include "Instruction.hpp"
+
+void IfConversion::run()
+{
+    for (auto func : m_->get_functions())
+    {
+        if (func->is_declaration()) continue;
+        // 转换会删除基本块，每次成功后重新扫描
+        bool changed;
+        do
+        {
+            changed = false;
+            for (auto bb : func->get_basic_blocks())
+            {
+                if (convert(bb))
+                {
+                    changed = true;
+                    break;
+                }
+            }
+        }
+        while (changed);
+    }
+}
+
+static Value* get_incoming(PhiInst* phi, BasicBlock* pre)
+{
+    for (auto [val, bb] : phi->get_phi_pairs())
+    {
+        if (bb == pre) return val;
+    }
+    return nullptr;
+}
+
+static void remove_incoming(PhiInst* phi, BasicBlock* pre)
+{
+    int opc = static_cast<int>(phi->get_num_operand());
+    for (int i = opc - 1; i >= 0; i -= 2)
+    {
+        if (phi->get_operand(i) == pre)
+        {
+            phi->remove_operand(i);
+            phi->remove_operand(i - 1);
+        }
+    }
+}
+
+static std::vector<PhiInst*> get_phis(BasicBlock* bb)
+{
+    std::vector<PhiInst*> phis;
+    for (auto inst : bb->get_instructions())
+    {
+        if (!inst->is_phi()) break;
+        phis.emplace_back(inst->as<PhiInst>());
+    }
+    return phis;
+}
+
+static BasicBlock* get_single_succ(BasicBlock* bb)
+{
+    auto& succs = bb->get_succ_basic_blocks();
+    return succs.size() == 1 ? succs.front() : nullptr;
+}
+
+bool IfConversion::is_speculatable_arm(BasicBlock* bb, BasicBlock* pred, BasicBlock* succ)
+{
+    if (bb == pred || bb == succ) return false;
+    if (bb->get_pre_basic_blocks().size() != 1 || bb->get_pre_basic_blocks().front() != pred) return false;
+    if (get_single_succ(bb) != succ) return false;
+    int count = 0;
+    for (auto inst : bb->get_instructions())
+    {
+        switch (inst->get_instr_type())
+        {
+            case Instruction::br:
+                break;
+            case Instruction::add:
+            case Instruction::sub:
+            case Instruction::mul:
+            case Instruction::fadd:
+            case Instruction::fsub:
+            case Instruction::fmul:
+            case Instruction::ge:
+            case Instruction::gt:
+            case Instruction::le:
+            case Instruction::lt:
+            case Instruction::eq:
+            case Instruction::ne:
+            case Instruction::fge:
+            case Instruction::fgt:
+            case Instruction::fle:
+            case Instruction::flt:
+            case Instruction::feq:
+            case Instruction::fne:
+            case Instruction::zext:
+            case Instruction::fptosi:
+            case Instruction::sitofp:
+            case Instruction::select:
+                if (++count > SPECULATE_LIMIT) return false;
+                break;
+            default:
+                // 访存、调用、除法以及 phi 不推测执行
+                return false;
+        }
+    }
+    return true;
+}
+
+bool IfConversion::convert(BasicBlock* bb)
+{
+    if (!bb->is_terminated()) return false;
+    auto br = dynamic_cast<BranchInst*>(bb->get_terminator());
+    if (br == nullptr || !br->is_cond_br()) return false;
+    auto cond = br->get_condition();
+    auto if_true = br->get_operand(1)->as<BasicBlock>();
+    auto if_false = br->get_operand(2)->as<BasicBlock>();
+    if (if_true == if_false) return false;
+
+    // 找出汇合块，以及条件为真/假时进入汇合块的前驱
+    BasicBlock* merge = nullptr;
+    BasicBlock* true_from = nullptr;
+    BasicBlock* false_from = nullptr;
+    std::vector<BasicBlock*> arms;
+    auto true_succ = get_single_succ(if_true);
+    if (true_succ != nullptr && is_speculatable_arm(if_true, bb, true_succ) &&
+        is_speculatable_arm(if_false, bb, true_succ))
+    {
+        merge = true_succ;
+        true_from = if_true;
+        false_from = if_false;
+        arms = { if_true, if_false };
+    }
+    else if (is_speculatable_arm(if_true, bb, if_false))
+    {
+        merge = if_false;
+        true_from = if_true;
+        false_from = bb;
+        arms = { if_true };
+    }
+    else if (is_speculatable_arm(if_false, bb, if_true))
+    {
+        merge = if_true;
+        true_from = bb;
+        false_from = if_false;
+        arms = { if_false };
+    }
+    if (merge == nullptr || merge == bb) return false;
+    auto phis = get_phis(merge);
+    for (auto phi : phis)
+    {
+        if (!phi->get_type()->is_integer_type() && !phi->get_type()->is_float_type()) return false;
+    }
+
+    // 暂时取下终止指令，把分支中的指令依次移到 bb 末尾，再为每个 phi 生成 select
+    auto& insts = bb->get_instructions();
+    insts.pop_back();
+    for (auto arm : arms)
+    {
+        auto& arm_insts = arm->get_instructions();
+        while (arm_insts.size() > 1)
+        {
+            auto inst = arm_insts.front();
+            arm_insts.pop_front();
+            inst->set_parent(bb);
+            bb->add_instruction(inst);
+        }
+    }
+    for (auto phi : phis)
+    {
+        auto true_val = get_incoming(phi, true_from);
+        auto false_val = get_incoming(phi, false_from);
+        Value* val = true_val;
+        if (true_val != false_val) val = SelectInst::create_select(cond, true_val, false_val, bb);
+        remove_incoming(phi, true_from);
+        remove_incoming(phi, false_from);
+        phi->add_phi_pair_operand(val, bb);
+    }
+    delete br;
+    BranchInst::create_br(merge, bb);
+    for (auto arm : arms)
+    {
+        arm->erase_from_parent();
+        delete arm;
+    }
+
+    merge_into_pred(bb);
+    return true;
+}
+
+bool IfConversion::merge_into_pred(BasicBlock* bb)
+{
+    auto succ = get_single_succ(bb);
+    if (succ == nullptr || succ == bb || succ->get_pre_basic_blocks().size() != 1) return false;
+    auto func = bb->get_parent();
+    if (succ == func->get_entry_block()) return false;
+
+    bb->erase_instr(bb->get_terminator());
+    // 唯一前驱的 phi 只有一个取值
+    for (auto phi : get_phis(succ))
+    {
+        phi->replace_all_use_with(phi->get_operand(0));
+        succ->erase_instr(phi);
+    }
+    auto& succ_insts = succ->get_instructions();
+    for (auto inst : succ_insts)
+    {
+        inst->set_parent(bb);
+        bb->get_instructions().emplace_back(inst);
+    }
+    succ_insts.clear();
+
+    // 原来 succ 的后继改为 bb 的后继
+    for (auto next : succ->get_succ_basic_blocks())
+    {
+        next->remove_pre_basic_block(succ);
+        next->add_pre_basic_block(bb);
+        bb->add_succ_basic_block(next);
+        for (auto phi : get_phis(next))
+        {
+            for (unsigned i = 1; i < phi->get_num_operand(); i += 2)
+            {
+                if (phi->get_operand(i) == succ) phi->set_operand(i, bb);
+            }
+        }
+    }
+    succ->get_succ_basic_blocks().clear();
+    succ->erase_from_parent();
+    delete succ;
+    return true;
+}
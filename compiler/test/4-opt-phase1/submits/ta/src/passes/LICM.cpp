@@ -1,6 +1,9 @@
 #include "LICM.hpp"
 
+#include <algorithm>
+#include <functional>
 #include <memory>
+#include <set>
 #include <vector>
 
 #include "BasicBlock.hpp"
@@ -16,19 +19,27 @@ void LoopInvariantCodeMotion::run()
 {
     func_info_ = new FuncInfo(m_);
     func_info_->run();
+    alias_analysis_ = new AliasAnalysis(m_, func_info_);
+    alias_analysis_->run();
     for (auto func : m_->get_functions())
     {
         if (func->is_declaration()) continue;
         loop_detection_ = new LoopDetection(func);
         loop_detection_->run();
+        memory_ssa_ = new MemorySSA(func, func_info_, alias_analysis_);
+        memory_ssa_->run();
         for (auto loop : loop_detection_->get_loops())
         {
             // 遍历处理顶层循环
             if (loop->get_parent() == nullptr) traverse_loop(loop);
         }
+        delete memory_ssa_;
+        memory_ssa_ = nullptr;
         delete loop_detection_;
         loop_detection_ = nullptr;
     }
+    delete alias_analysis_;
+    alias_analysis_ = nullptr;
     delete func_info_;
     func_info_ = nullptr;
 }
@@ -48,26 +59,6 @@ void LoopInvariantCodeMotion::traverse_loop(Loop* loop)
     }
 }
 
-std::unordered_set<Value*> LoopInvariantCodeMotion::collect_loop_store_vars(Loop* loop)
-{
-	// 可能用到
-	// FuncInfo::store_ptr, FuncInfo::get_stores
-	std::unordered_set<Value*> ret;
-	for(auto bb : loop->get_blocks()){
-		for(auto inst: bb->get_instructions()){
-			if(inst->is_store()){
-				auto ptr = FuncInfo::store_ptr(inst->as<StoreInst>());
-				ret.emplace(ptr);
-			}
-			else if(inst->is_call()){
-				auto ptrd =  func_info_->get_stores(inst->as<CallInst>());
-				for(auto i : ptrd) ret.emplace(i);
-			}
-		}
-	}
-	return ret;
-}
-
 std::vector<Instruction*> LoopInvariantCodeMotion::collect_insts(Loop* loop)
 {
 	std::vector<Instruction*> ret;
@@ -91,8 +82,14 @@ enum InstructionType: std::uint8_t
  */
 void LoopInvariantCodeMotion::run_on_loop(Loop* loop)
 {
-    // 循环 store 过的变量
-    std::unordered_set<Value*> loop_stores_var = collect_loop_store_vars(loop);
+    std::unordered_set<BasicBlock*> in_loop(loop->get_blocks().begin(), loop->get_blocks().end());
+    // inst 读取的 ptr 是否可能在循环内被修改：MemorySSA 中最近的修改位于循环内（包括循环头的 MemoryPhi）
+    auto clobbered_in_loop = [&](Instruction* inst, Value* ptr, bool whole_object) {
+        auto acc = memory_ssa_->get_access(inst);
+        if (acc == nullptr) return true;
+        auto clobber = memory_ssa_->get_clobbering_access(acc, ptr, whole_object);
+        return !clobber->is_live_on_entry() && in_loop.count(clobber->get_block()) != 0;
+    };
     // 循环中的所有指令
     std::vector<Instruction*> instructions = collect_insts(loop);
     int insts_count = static_cast<int>(instructions.size());
@@ -102,8 +99,8 @@ void LoopInvariantCodeMotion::run_on_loop(Loop* loop)
 
     // 遍历后是不是还有指令不知道 InstructionType
     bool have_inst_can_not_decide;
-    // 是否存在 invariant
-    bool have_invariant = false;
+    // 按判定顺序记录的 invariant，操作数总在使用者之前（基本块的排列顺序不一定符合支配关系）
+    std::vector<Instruction*> invariants;
     do
     {
         have_inst_can_not_decide = false;
@@ -127,10 +124,9 @@ if(inst->is_store() || inst->is_ret() || inst->is_br() || inst->is_phi()){
 					auto stores = func_info_->get_stores(ca);
 					if(!stores.empty()) wrong = true;
 					else  {
-					auto l = func_info_->get_loads(ca);
-					for(auto a : l)
+					for(auto a : func_info_->get_loads(ca))
 					{
-						if(loop_stores_var.count(a)){
+						if(clobbered_in_loop(inst, a, true)){
 							wrong = true;
 							break;
 						}
@@ -144,7 +140,7 @@ if(inst->is_store() || inst->is_ret() || inst->is_br() || inst->is_phi()){
 			}
 			if(inst->is_load())
 			{
-				if(loop_stores_var.count(FuncInfo::load_ptr(inst->as<LoadInst>())))
+				if(clobbered_in_loop(inst, inst->get_operand(0), false))
 				{
 					inst_type[inst] = VARIANT;
 					continue;
@@ -170,13 +166,54 @@ if(inst->is_store() || inst->is_ret() || inst->is_br() || inst->is_phi()){
 			}
 			else {
 				inst_type[inst] = INVARIANT;
-				have_invariant = true;
+				invariants.emplace_back(inst);
 			}
         }
     }
     while (have_inst_can_not_decide);
 
-    if (!have_invariant) return;
+    // 循环中被 store 的变量，若满足条件可以整体提升为 phi 承载的标量
+    auto is_invariant = [&](Value* val) {
+        auto it = inst_type.find(val);
+        return it == inst_type.end() || it->second == INVARIANT;
+    };
+    auto promotions = collect_promotable_vars(loop, is_invariant);
+
+    if (invariants.empty() && promotions.empty()) return;
+
+    auto preheader = insert_preheader(loop);
+
+    auto terminator = preheader->get_instructions().back();
+    preheader->get_instructions().pop_back();
+
+    // 可以使用 Function::check_for_block_relation_error 检查基本块间的关系是否正确维护
+
+	for(auto inst : invariants)
+	{
+		auto parent = inst->get_parent();
+		parent->remove_instr(inst);
+		preheader->add_instruction(inst);
+		inst->set_parent(preheader);
+	}
+
+    preheader->add_instruction(terminator);
+
+    // 外提完成后地址都已在循环外，此时再做标量提升
+    for (auto& candidate : promotions) promote_scalar(loop, candidate);
+    // 提升改变了循环内的 load/store，重新构建 MemorySSA
+    if (!promotions.empty()) memory_ssa_->run();
+
+    std::cerr << "licm done\n";
+}
+
+/**
+ * @brief 为循环插入 preheader（若已有唯一且只跳向 header 的前驱则直接使用它）
+ * @param loop 要处理的循环
+ * @return 循环的 preheader
+ */
+BasicBlock* LoopInvariantCodeMotion::insert_preheader(Loop* loop)
+{
+    if (loop->get_preheader() != nullptr) return loop->get_preheader();
 
     auto header = loop->get_header();
 
@@ -224,36 +261,214 @@ if(inst->is_store() || inst->is_ret() || inst->is_br() || inst->is_phi()){
 
         BranchInst::create_br(header, bb);
 
-        // 若你想维护 LoopDetection 在 LICM 后保持正确
-        // auto loop2 = loop->get_parent();
-        // while (loop2 != nullptr)
-        // {
-        //      loop2->add_block(bb);
-        //     loop2 = loop2->get_parent();
-        // }
+        // 维护 LoopDetection 在 LICM 后保持正确
+        auto loop2 = loop->get_parent();
+        while (loop2 != nullptr)
+        {
+            loop2->add_block(bb);
+            loop2 = loop2->get_parent();
+        }
     }
     else loop->set_preheader(header->get_pre_basic_blocks().front());
 
-    // insert preheader
-    auto preheader = loop->get_preheader();
+    return loop->get_preheader();
+}
 
-    auto terminator = preheader->get_instructions().back();
-    preheader->get_instructions().pop_back();
+/**
+ * @brief 找出循环中可以提升为标量的内存位置
+ * @param loop 当前循环
+ * @param is_invariant 判断值在外提后是否位于循环外
+ * @return 候选位置列表
+ *
+ * 一个位置可以提升，需要满足：
+ * 1. 循环内对它的访问都使用同一个循环不变的地址，且至少有一次 store
+ * 2. 循环内没有通过其它可能重叠的地址访问同一块内存
+ * 3. 循环内的函数调用不会 load/store 这块内存（依据 FuncInfo）
+ * 对象和地址之间是否重叠由 AliasAnalysis 判断
+ */
+std::vector<LoopInvariantCodeMotion::PromotionCandidate> LoopInvariantCodeMotion::collect_promotable_vars(
+    Loop* loop, const std::function<bool(Value*)>& is_invariant)
+{
+    // 基址 -> 循环内对它的 load/store
+    std::unordered_map<Value*, std::vector<Instruction*>> base_accesses;
+    // 循环内函数调用间接访问的基址
+    std::unordered_set<Value*> call_bases;
+    for (auto bb : loop->get_blocks())
+    {
+        for (auto inst : bb->get_instructions())
+        {
+            if (inst->is_load())
+                base_accesses[FuncInfo::load_ptr(inst->as<LoadInst>())].emplace_back(inst);
+            else if (inst->is_store())
+                base_accesses[FuncInfo::store_ptr(inst->as<StoreInst>())].emplace_back(inst);
+            else if (inst->is_call())
+            {
+                for (auto i : func_info_->get_stores(inst->as<CallInst>())) call_bases.emplace(i);
+                for (auto i : func_info_->get_loads(inst->as<CallInst>())) call_bases.emplace(i);
+            }
+        }
+    }
 
-    // 可以使用 Function::check_for_block_relation_error 检查基本块间的关系是否正确维护
+    auto address_of = [](Instruction* inst) { return inst->is_load() ? inst->get_operand(0) : inst->get_operand(1); };
 
-	for(auto inst : instructions)
-	{
-		if(inst_type[inst] == INVARIANT)
-		{
-			auto parent = inst->get_parent();
-			parent->remove_instr(inst);
-			preheader->add_instruction(inst);
-			inst->set_parent(preheader);
-		}
-	}
+    std::vector<PromotionCandidate> ret;
+    for (auto& [base, accesses] : base_accesses)
+    {
+        bool clobbered = false;
+        for (auto i : call_bases)
+            if (alias_analysis_->may_alias_object(base, i)) clobbered = true;
+        for (auto& [other, other_accesses] : base_accesses)
+            if (other != base && alias_analysis_->may_alias_object(base, other)) clobbered = true;
+        if (clobbered) continue;
+
+        // 按地址分组
+        std::vector<PromotionCandidate> groups;
+        for (auto inst : accesses)
+        {
+            auto addr = address_of(inst);
+            auto it = std::find_if(groups.begin(), groups.end(),
+                                   [&](const PromotionCandidate& c) {
+                                       return alias_analysis_->alias(c.addr_, addr) == AliasAnalysis::MustAlias;
+                                   });
+            if (it == groups.end()) groups.push_back({addr, {inst}});
+            else it->accesses_.emplace_back(inst);
+        }
+        for (auto& group : groups)
+        {
+            if (!is_invariant(group.addr_)) continue;
+            if (std::none_of(group.accesses_.begin(), group.accesses_.end(), [](Instruction* i) { return i->is_store(); }))
+                continue;
+            bool ok = true;
+            for (auto& other : groups)
+                if (&other != &group && alias_analysis_->alias(group.addr_, other.addr_) != AliasAnalysis::NoAlias)
+                    ok = false;
+            // 同组的 gep 可能不止一条，统一使用第一个循环不变的地址
+            for (auto inst : group.accesses_)
+                if (!is_invariant(address_of(inst))) ok = false;
+            if (ok) ret.emplace_back(std::move(group));
+        }
+    }
+    return ret;
+}
+
+/**
+ * @brief 将循环内对某个内存位置的 load/store 替换为标量
+ * @param loop 当前循环（preheader 已插入，不变式已外提）
+ * @param candidate 要提升的内存位置
+ *
+ * 在 preheader 中 load 初值，循环内用 phi 承载当前值，并在每条出口边上 store 回内存。
+ * phi 先放在 header 和循环内所有汇合点上，重命名后再删除平凡的 phi。
+ */
+void LoopInvariantCodeMotion::promote_scalar(Loop* loop, const PromotionCandidate& candidate)
+{
+    auto addr = candidate.addr_;
+    auto ty = addr->get_type()->get_pointer_element_type();
+    auto header = loop->get_header();
+    auto preheader = loop->get_preheader();
+    auto func = header->get_parent();
+    std::unordered_set<BasicBlock*> in_loop(loop->get_blocks().begin(), loop->get_blocks().end());
+    std::unordered_set<Instruction*> accesses(candidate.accesses_.begin(), candidate.accesses_.end());
 
+    // 在 preheader 中加载初值
+    auto terminator = preheader->get_terminator();
+    preheader->remove_instr(terminator);
+    Value* init = LoadInst::create_load(addr, preheader);
     preheader->add_instruction(terminator);
 
-    std::cerr << "licm done\n";
+    std::unordered_map<BasicBlock*, PhiInst*> phis;
+    for (auto bb : loop->get_blocks())
+    {
+        if (bb == header || bb->get_pre_basic_blocks().size() > 1)
+            phis[bb] = PhiInst::create_phi(ty, bb);
+    }
+
+    // 基本块出口处的值；无 phi 的块只有一个循环内的前驱，沿前驱链总能走到某个 phi
+    std::unordered_map<BasicBlock*, Value*> out_val;
+    std::function<Value*(BasicBlock*)> get_out = [&](BasicBlock* bb) -> Value* {
+        auto it = out_val.find(bb);
+        if (it != out_val.end()) return it->second;
+        Value* cur = phis.count(bb) ? phis[bb] : get_out(bb->get_pre_basic_blocks().front());
+        std::set<Instruction*> erased;
+        for (auto inst : bb->get_instructions())
+        {
+            if (!accesses.count(inst)) continue;
+            if (inst->is_load()) inst->replace_all_use_with(cur);
+            else cur = inst->get_operand(0);
+            erased.emplace(inst);
+        }
+        bb->erase_instrs(erased);
+        out_val[bb] = cur;
+        return cur;
+    };
+    for (auto bb : loop->get_blocks()) get_out(bb);
+
+    for (auto [bb, phi] : phis)
+    {
+        for (auto pre : bb->get_pre_basic_blocks())
+            phi->add_phi_pair_operand(in_loop.count(pre) ? get_out(pre) : init, pre);
+    }
+
+    // 在每条出口边上写回内存，出口块有其它前驱时拆分这条边
+    for (auto bb : loop->get_blocks())
+    {
+        auto succs = bb->get_succ_basic_blocks();
+        for (auto succ : succs)
+        {
+            if (in_loop.count(succ)) continue;
+            if (succ->get_pre_basic_blocks().size() == 1)
+            {
+                auto succ_terminator = succ->get_terminator();
+                succ->remove_instr(succ_terminator);
+                auto st = StoreInst::create_store(get_out(bb), addr, succ);
+                succ->remove_instr(st);
+                succ->add_instruction(succ_terminator);
+                succ->add_instr_begin(st);
+                continue;
+            }
+            auto exit = BasicBlock::create(m_, "", func);
+            bb->get_terminator()->as<BranchInst>()->replace_all_bb_match(succ, exit);
+            for (auto inst : succ->get_instructions())
+            {
+                if (!inst->is_phi()) break;
+                for (unsigned i = 1; i < inst->get_num_operand(); i += 2)
+                    if (inst->get_operand(i) == bb) inst->set_operand(i, exit);
+            }
+            StoreInst::create_store(get_out(bb), addr, exit);
+            BranchInst::create_br(succ, exit);
+            // exit 属于同时包含 succ 的外层循环
+            for (auto outer = loop->get_parent(); outer != nullptr; outer = outer->get_parent())
+            {
+                auto& blocks = outer->get_blocks();
+                if (std::find(blocks.begin(), blocks.end(), succ) != blocks.end()) outer->add_block(exit);
+            }
+        }
+    }
+
+    // 删除平凡的 phi：除自身外只有一个来源值
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (auto it = phis.begin(); it != phis.end();)
+        {
+            auto phi = it->second;
+            Value* same = nullptr;
+            bool trivial = true;
+            for (auto [val, pre] : phi->get_phi_pairs())
+            {
+                if (val == phi || val == same) continue;
+                if (same != nullptr) trivial = false;
+                same = val;
+            }
+            if (!trivial || same == nullptr)
+            {
+                ++it;
+                continue;
+            }
+            phi->replace_all_use_with(same);
+            it->first->erase_instr(phi);
+            it = phis.erase(it);
+            changed = true;
+        }
+    }
 }
@@ -0,0 +1,190 @@
+#include "LoopUnswitch.hpp"
+
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "BasicBlock.hpp"
+#include "Cloner.hpp"
+#include "DeadCode.hpp"
+#include "Function.hpp"
+#include "Instruction.hpp"
+
+void LoopUnswitch::run()
+{
+    for (auto func : m_->get_functions())
+    {
+        if (func->is_declaration()) continue;
+        int budget = UNSWITCH_BUDGET;
+        // 变换后循环结构改变，每次成功后重新检测
+        bool changed;
+        do
+        {
+            changed = false;
+            auto loop_detection = new LoopDetection(func);
+            loop_detection->run();
+            for (auto loop : loop_detection->get_loops())
+            {
+                if (loop->get_parent() == nullptr && traverse_loop(loop, budget))
+                {
+                    // 固定后的分支留下不可达的基本块，重新检测循环前先删除
+                    DeadCode::clear_basic_blocks(func);
+                    changed = true;
+                    break;
+                }
+            }
+            delete loop_detection;
+        }
+        while (changed);
+    }
+}
+
+bool LoopUnswitch::traverse_loop(Loop* loop, int& budget)
+{
+    if (unswitch(loop, budget)) return true;
+    for (auto sub_loop : loop->get_sub_loops())
+    {
+        if (traverse_loop(sub_loop, budget)) return true;
+    }
+    return false;
+}
+
+// 把 bb 的条件跳转固定为走 taken 一侧
+static void fold_branch(BasicBlock* bb, bool taken)
+{
+    auto br = bb->get_terminator()->as<BranchInst>();
+    auto keep = br->get_operand(taken ? 1 : 2)->as<BasicBlock>();
+    auto drop = br->get_operand(taken ? 2 : 1)->as<BasicBlock>();
+    if (keep != drop)
+    {
+        for (auto inst : drop->get_instructions())
+        {
+            if (!inst->is_phi()) break;
+            int opc = static_cast<int>(inst->get_num_operand());
+            for (int i = opc - 1; i >= 0; i -= 2)
+            {
+                if (inst->get_operand(i) == bb)
+                {
+                    inst->remove_operand(i);
+                    inst->remove_operand(i - 1);
+                }
+            }
+        }
+    }
+    bb->erase_instr(br);
+    BranchInst::create_br(keep, bb);
+}
+
+bool LoopUnswitch::unswitch(Loop* loop, int& budget)
+{
+    auto& blocks = loop->get_blocks();
+    std::unordered_set<BasicBlock*> in_loop(blocks.begin(), blocks.end());
+    int size = 0;
+    for (auto bb : blocks) size += bb->get_num_of_instr();
+    if (size > UNSWITCH_LOOP_SIZE || size > budget) return false;
+
+    // 唯一的循环外前驱，且只跳向 header
+    auto header = loop->get_header();
+    BasicBlock* preheader = nullptr;
+    for (auto pre : header->get_pre_basic_blocks())
+    {
+        if (in_loop.count(pre)) continue;
+        if (preheader != nullptr) return false;
+        preheader = pre;
+    }
+    if (preheader == nullptr || preheader->get_succ_basic_blocks().size() != 1) return false;
+
+    // 唯一的出口块，且前驱都在循环内
+    BasicBlock* exit = nullptr;
+    for (auto bb : blocks)
+    {
+        for (auto succ : bb->get_succ_basic_blocks())
+        {
+            if (in_loop.count(succ) || succ == exit) continue;
+            if (exit != nullptr) return false;
+            exit = succ;
+        }
+    }
+    if (exit == nullptr) return false;
+    for (auto pre : exit->get_pre_basic_blocks())
+    {
+        if (!in_loop.count(pre)) return false;
+    }
+
+    // 条件在循环外定义的分支
+    Value* cond = nullptr;
+    for (auto bb : blocks)
+    {
+        auto br = dynamic_cast<BranchInst*>(bb->get_terminator());
+        if (br == nullptr || !br->is_cond_br() || br->get_operand(1) == br->get_operand(2)) continue;
+        auto val = br->get_condition();
+        if (dynamic_cast<Constant*>(val) != nullptr) continue;
+        auto inst = dynamic_cast<Instruction*>(val);
+        if (inst != nullptr && in_loop.count(inst->get_parent())) continue;
+        cond = val;
+        break;
+    }
+    if (cond == nullptr) return false;
+
+    auto func = header->get_parent();
+    Cloner cloner;
+    auto new_blocks = cloner.clone_blocks(blocks, func);
+    std::unordered_set<BasicBlock*> in_clone(new_blocks.begin(), new_blocks.end());
+
+    // 出口块的 phi 加上来自副本的取值
+    std::vector<PhiInst*> exit_phis;
+    for (auto inst : exit->get_instructions())
+    {
+        if (!inst->is_phi()) break;
+        exit_phis.emplace_back(inst->as<PhiInst>());
+    }
+    for (auto phi : exit_phis)
+    {
+        for (auto [val, pre] : phi->get_phi_pairs())
+        {
+            if (in_loop.count(pre)) phi->add_phi_pair_operand(cloner.lookup(val), cloner.lookup(pre));
+        }
+    }
+
+    // 循环中定义、循环外使用的值，在出口块用 phi 合并两份循环的值
+    std::unordered_set<Instruction*> exit_phi_set(exit_phis.begin(), exit_phis.end());
+    for (auto bb : blocks)
+    {
+        for (auto inst : bb->get_instructions())
+        {
+            std::vector<std::pair<User*, unsigned>> outside_uses;
+            for (auto& use : inst->get_use_list())
+            {
+                auto user = dynamic_cast<Instruction*>(use.val_);
+                if (user == nullptr || exit_phi_set.count(user)) continue;
+                auto parent = user->get_parent();
+                if (in_loop.count(parent) || in_clone.count(parent)) continue;
+                outside_uses.emplace_back(use.val_, use.arg_no_);
+            }
+            if (outside_uses.empty()) continue;
+            auto phi = PhiInst::create_phi(inst->get_type(), exit);
+            for (auto pre : exit->get_pre_basic_blocks())
+            {
+                if (in_loop.count(pre)) phi->add_phi_pair_operand(inst, pre);
+                else phi->add_phi_pair_operand(cloner.lookup(inst), pre);
+            }
+            for (auto [user, arg_no] : outside_uses) user->set_operand(arg_no, phi);
+        }
+    }
+
+    // 原循环固定走真分支，副本固定走假分支
+    for (auto bb : blocks)
+    {
+        auto br = dynamic_cast<BranchInst*>(bb->get_terminator());
+        if (br == nullptr || !br->is_cond_br() || br->get_condition() != cond) continue;
+        fold_branch(cloner.lookup(bb)->as<BasicBlock>(), false);
+        fold_branch(bb, true);
+    }
+
+    // preheader 中按条件进入其中一份循环
+    preheader->erase_instr(preheader->get_terminator());
+    BranchInst::create_cond_br(cond, header, cloner.lookup(header)->as<BasicBlock>(), preheader);
+
+    budget -= size;
+    return true;
+}
@@ -0,0 +1,232 @@
+#include "MemorySSA.hpp"
+
+#include "BasicBlock.hpp"
+#include "Function.hpp"
+#include "Instruction.hpp"
+
+void MemorySSA::run()
+{
+    accesses_.clear();
+    inst_access_.clear();
+    phis_.clear();
+    back_edges_.clear();
+    next_id_ = 0;
+    live_on_entry_ = create_access(MemoryAccess::LiveOnEntry, nullptr, nullptr);
+
+    // 创建 Def/Use，记录含有 Def 的基本块
+    std::vector<BasicBlock*> def_blocks;
+    for (auto bb : f_->get_basic_blocks())
+    {
+        bool has_def = false;
+        for (auto inst : bb->get_instructions())
+        {
+            if (inst->is_store()) has_def = true;
+            else if (inst->is_call())
+            {
+                auto call = inst->as<CallInst>();
+                if (!func_info_->get_stores(call).empty()) has_def = true;
+                else if (func_info_->get_loads(call).empty()) continue;
+                else
+                {
+                    create_access(MemoryAccess::Use, bb, inst);
+                    continue;
+                }
+            }
+            else if (inst->is_load())
+            {
+                create_access(MemoryAccess::Use, bb, inst);
+                continue;
+            }
+            else continue;
+            create_access(MemoryAccess::Def, bb, inst);
+        }
+        if (has_def) def_blocks.emplace_back(bb);
+    }
+
+    // 在迭代支配边界上放置 MemoryPhi
+    auto dominators = new Dominators(f_);
+    dominators->run();
+    std::vector<BasicBlock*> worklist(def_blocks.begin(), def_blocks.end());
+    while (!worklist.empty())
+    {
+        auto bb = worklist.back();
+        worklist.pop_back();
+        for (auto frontier : dominators->get_dominance_frontier(bb))
+        {
+            if (phis_.count(frontier)) continue;
+            phis_[frontier] = create_access(MemoryAccess::Phi, frontier, nullptr);
+            worklist.emplace_back(frontier);
+        }
+    }
+
+    rename(dominators, f_->get_entry_block(), live_on_entry_);
+    delete dominators;
+}
+
+MemoryAccess* MemorySSA::create_access(MemoryAccess::Kind kind, BasicBlock* bb, Instruction* inst)
+{
+    // Use 不被其它访问引用，不需要编号
+    unsigned id = kind == MemoryAccess::Use ? 0 : next_id_++;
+    accesses_.emplace_back(std::make_unique<MemoryAccess>(kind, id, bb, inst));
+    auto acc = accesses_.back().get();
+    if (inst != nullptr) inst_access_[inst] = acc;
+    return acc;
+}
+
+void MemorySSA::rename(Dominators* dominators, BasicBlock* bb, MemoryAccess* incoming)
+{
+    auto cur = incoming;
+    auto phi = get_phi(bb);
+    if (phi != nullptr) cur = phi;
+    for (auto inst : bb->get_instructions())
+    {
+        auto acc = get_access(inst);
+        if (acc == nullptr) continue;
+        acc->defining_ = cur;
+        if (acc->is_def()) cur = acc;
+    }
+    for (auto succ : bb->get_succ_basic_blocks())
+    {
+        auto succ_phi = get_phi(succ);
+        if (succ_phi == nullptr) continue;
+        succ_phi->incoming_.emplace_back(cur, bb);
+        if (dominators->is_dominate(succ, bb)) back_edges_.insert({succ_phi, bb});
+    }
+    for (auto child : dominators->get_dom_tree_succ_blocks(bb)) rename(dominators, child, cur);
+}
+
+MemoryAccess* MemorySSA::get_access(Instruction* inst) const
+{
+    auto it = inst_access_.find(inst);
+    return it == inst_access_.end() ? nullptr : it->second;
+}
+
+MemoryAccess* MemorySSA::get_phi(BasicBlock* bb) const
+{
+    auto it = phis_.find(bb);
+    return it == phis_.end() ? nullptr : it->second;
+}
+
+bool MemorySSA::clobbers(MemoryAccess* def, Value* ptr, bool whole_object, bool crossed) const
+{
+    auto inst = def->get_instruction();
+    if (inst->is_store())
+    {
+        auto addr = inst->get_operand(1);
+        if (whole_object) return alias_analysis_->may_alias_object(addr, ptr);
+        auto result = crossed ? alias_analysis_->alias_across_iterations(addr, ptr) : alias_analysis_->alias(addr, ptr);
+        return result != AliasAnalysis::NoAlias;
+    }
+    return alias_analysis_->may_mod(inst->as<CallInst>(), ptr);
+}
+
+bool MemorySSA::is_back_edge(MemoryAccess* phi, BasicBlock* pre) const
+{
+    return back_edges_.count({phi, pre}) != 0;
+}
+
+MemoryAccess* MemorySSA::walk(MemoryAccess* acc, Value* ptr, bool whole_object, bool crossed,
+                              std::map<std::pair<MemoryAccess*, bool>, MemoryAccess*>& visited)
+{
+    while (acc->is_def())
+    {
+        if (clobbers(acc, ptr, whole_object, crossed)) return acc;
+        acc = acc->defining_;
+    }
+    if (acc->is_live_on_entry()) return acc;
+    // 回到正在查找的 Phi 时返回 nullptr：这条路径上的 Def 都已检查过
+    auto it = visited.find({acc, crossed});
+    if (it != visited.end()) return it->second;
+    visited[{acc, crossed}] = nullptr;
+    MemoryAccess* result = nullptr;
+    for (auto [incoming, pre] : acc->incoming_)
+    {
+        auto clobber = walk(incoming, ptr, whole_object, crossed || is_back_edge(acc, pre), visited);
+        if (clobber == nullptr || clobber == result) continue;
+        if (result != nullptr)
+        {
+            result = acc;
+            break;
+        }
+        result = clobber;
+    }
+    // 所有路径都回到正在查找的 Phi 时结果为 nullptr，由上层的 Phi 汇总
+    visited[{acc, crossed}] = result;
+    return result;
+}
+
+MemoryAccess* MemorySSA::get_clobbering_access(MemoryAccess* start, Value* ptr, bool whole_object)
+{
+    std::map<std::pair<MemoryAccess*, bool>, MemoryAccess*> visited;
+    auto from = start->is_phi() ? start : start->defining_;
+    if (start->is_phi()) visited[{start, false}] = nullptr;
+    if (!start->is_phi())
+    {
+        auto clobber = walk(from, ptr, whole_object, false, visited);
+        return clobber == nullptr ? from : clobber;
+    }
+    // 从 Phi 开始时直接查找各前驱
+    MemoryAccess* result = nullptr;
+    for (auto [incoming, pre] : start->incoming_)
+    {
+        auto clobber = walk(incoming, ptr, whole_object, is_back_edge(start, pre), visited);
+        if (clobber == nullptr || clobber == result) continue;
+        if (result != nullptr) return start;
+        result = clobber;
+    }
+    return result == nullptr ? start : result;
+}
+
+MemoryAccess* MemorySSA::get_clobbering_access(MemoryAccess* use)
+{
+    auto inst = use->get_instruction();
+    if (inst->is_load()) return get_clobbering_access(use, inst->get_operand(0), false);
+    MemoryAccess* result = nullptr;
+    for (auto obj : func_info_->get_loads(inst->as<CallInst>()))
+    {
+        auto clobber = get_clobbering_access(use, obj, true);
+        if (result != nullptr && clobber != result) return use->defining_;
+        result = clobber;
+    }
+    return result == nullptr ? use->defining_ : result;
+}
+
+std::string MemorySSA::print_access(const MemoryAccess* acc)
+{
+    return acc->is_live_on_entry() ? "liveOnEntry" : std::to_string(acc->get_id());
+}
+
+std::string MemorySSA::print() const
+{
+    f_->get_parent()->set_print_name();
+    std::string ret = "MemorySSA for " + f_->get_name() + ":\n";
+    for (auto bb : f_->get_basic_blocks())
+    {
+        ret += bb->get_name() + ":\n";
+        auto phi = get_phi(bb);
+        if (phi != nullptr)
+        {
+            ret += "  ; " + print_access(phi) + " = MemoryPhi(";
+            bool first = true;
+            for (auto [incoming, pre] : phi->get_incoming())
+            {
+                if (!first) ret += ", ";
+                first = false;
+                ret += "{" + pre->get_name() + ", " + print_access(incoming) + "}";
+            }
+            ret += ")\n";
+        }
+        for (auto inst : bb->get_instructions())
+        {
+            auto acc = get_access(inst);
+            if (acc != nullptr)
+            {
+                if (acc->is_def())
+                    ret += "  ; " + print_access(acc) + " = MemoryDef(" + print_access(acc->get_defining_access()) + ")\n";
+                else ret += "  ; MemoryUse(" + print_access(acc->get_defining_access()) + ")\n";
+            }
+            ret += "  " + inst->print() + "\n";
+        }
+    }
+    return ret;
+}
@@ -0,0 +1,184 @@
+#include "PostDominators.hpp"
+
+#include <functional>
+
+#include "Function.hpp"
+
+// 与 Dominators 相同的 Cooper-Harvey-Kennedy 迭代算法，只是在以虚拟出口（nullptr）为根的反向 CFG 上进行
+
+/**
+ * @brief 对单个函数执行后必经关系分析
+ *
+ * 1. 从虚拟出口出发在反向 CFG 上 DFS，得到逆后序；不能到达 ret 的基本块作为额外的根
+ * 2. 计算直接后必经节点(ipdom)
+ * 3. 计算后必经边界，即控制依赖
+ * 4. 创建后必经树的DFS序
+ */
+void PostDominators::run() {
+    reversed_post_order_vec_.clear();
+    reversed_post_order_.clear();
+    ipdom_.clear();
+    post_dom_frontier_.clear();
+    post_dom_tree_succ_blocks_.clear();
+    reach_exit_.clear();
+    exit_roots_.clear();
+    post_dom_tree_L_.clear();
+    post_dom_tree_R_.clear();
+    for (auto bb : f_->get_basic_blocks()) {
+        ipdom_.insert({ bb, nullptr });
+        post_dom_frontier_.insert({ bb, {} });
+        post_dom_tree_succ_blocks_.insert({ bb, {} });
+    }
+    post_dom_tree_succ_blocks_[nullptr] = {};
+    create_reverse_post_order();
+    create_ipdom();
+    create_post_dominance_frontier();
+    create_post_dom_dfs_order();
+}
+
+std::vector<BasicBlock*> PostDominators::reverse_preds(BasicBlock* bb) const
+{
+    std::vector<BasicBlock*> ret(bb->get_succ_basic_blocks().begin(), bb->get_succ_basic_blocks().end());
+    if ((bb->is_terminated() && bb->get_terminator()->is_ret()) || exit_roots_.count(bb)) ret.emplace_back(nullptr);
+    return ret;
+}
+
+void PostDominators::dfs(BasicBlock *bb, std::set<BasicBlock *> &visited) {
+    visited.insert(bb);
+    if (bb == nullptr) {
+        for (auto b : f_->get_basic_blocks()) {
+            if ((b->is_terminated() && b->get_terminator()->is_ret()) || exit_roots_.count(b)) {
+                if (!visited.count(b)) dfs(b, visited);
+            }
+        }
+    }
+    else {
+        for (auto pre : bb->get_pre_basic_blocks()) {
+            if (!visited.count(pre)) dfs(pre, visited);
+        }
+    }
+    reversed_post_order_vec_.push_back(bb);
+    reversed_post_order_.insert({bb, reversed_post_order_.size()});
+}
+
+/**
+ * @brief 创建反向 CFG 的逆后序
+ *
+ * 先只从 ret 块出发，记录能到达 ret 的基本块；其余基本块按函数中的顺序依次作为额外的根，
+ * 每加入一个根就重新计算，直到所有基本块都被访问。
+ */
+void PostDominators::create_reverse_post_order() {
+    std::set<BasicBlock*> visited;
+    dfs(nullptr, visited);
+    for (auto bb : visited)
+        if (bb != nullptr) reach_exit_.insert(bb);
+    for (auto bb : f_->get_basic_blocks()) {
+        if (visited.count(bb)) continue;
+        exit_roots_.insert(bb);
+        reversed_post_order_vec_.clear();
+        reversed_post_order_.clear();
+        visited.clear();
+        dfs(nullptr, visited);
+    }
+    int size = static_cast<int>(reversed_post_order_vec_.size()) - 1;
+    for (auto& it : reversed_post_order_)
+    {
+        it.second = size - it.second;
+        reversed_post_order_vec_[it.second] = it.first;
+    }
+}
+
+BasicBlock *PostDominators::intersect(BasicBlock *b1, BasicBlock *b2) const
+{
+    while (b1 != b2) {
+        while (reversed_post_order_.at(b1) > reversed_post_order_.at(b2)) {
+            b1 = ipdom_.at(b1);
+        }
+        while (reversed_post_order_.at(b2) > reversed_post_order_.at(b1)) {
+            b2 = ipdom_.at(b2);
+        }
+    }
+    return b1;
+}
+
+/**
+ * @brief 计算所有基本块的直接后必经节点
+ *
+ * 虚拟出口是根；计算过程中用 done 标记已经有结果的节点（ipdom_ 中 nullptr 本身是合法结果）
+ */
+void PostDominators::create_ipdom() {
+    std::set<BasicBlock*> done;
+    done.insert(nullptr);
+    int bb_count = static_cast<int>(reversed_post_order_vec_.size());
+    bool changed;
+    do
+    {
+        changed = false;
+        for (int i = 1; i < bb_count; i++)
+        {
+            auto bb = reversed_post_order_vec_[i];
+            BasicBlock* d = nullptr;
+            bool found = false;
+            for (auto succ : reverse_preds(bb)) {
+                if (!done.count(succ)) continue;
+                if (!found) {
+                    d = succ;
+                    found = true;
+                }
+                else {
+                    d = intersect(d, succ);
+                }
+            }
+            if (found && (!done.count(bb) || d != ipdom_[bb]))
+            {
+                ipdom_[bb] = d;
+                done.insert(bb);
+                changed = true;
+            }
+        }
+    } while (changed);
+}
+
+/**
+ * @brief 计算所有基本块的后必经边界
+ *
+ * 对于每个有多个后继的基本块B：
+ * 从每个后继S开始，沿着后必经树向上遍历直到遇到B的直接后必经节点，
+ * 将B加入路径上所有节点的后必经边界中。
+ */
+void PostDominators::create_post_dominance_frontier() {
+    for (auto bb : f_->get_basic_blocks())
+    {
+        auto succs = reverse_preds(bb);
+        if (succs.size() < 2) continue;
+        for (auto runner : succs) {
+            while (runner != ipdom_[bb]) {
+                post_dom_frontier_[runner].emplace(bb);
+                runner = ipdom_[runner];
+            }
+        }
+    }
+}
+
+void PostDominators::create_post_dom_dfs_order() {
+    for (auto [bb, ipdom] : ipdom_) post_dom_tree_succ_blocks_[ipdom].insert(bb);
+    unsigned int order = 0;
+    std::function<void(BasicBlock *)> dfs = [&](BasicBlock *bb) {
+        post_dom_tree_L_[bb] = ++ order;
+        for (auto succ : post_dom_tree_succ_blocks_[bb]) {
+            dfs(succ);
+        }
+        post_dom_tree_R_[bb] = order;
+    };
+    dfs(nullptr);
+}
+
+void PostDominators::print_ipdom() const
+{
+    f_->get_parent()->set_print_name();
+    printf("Immediate post dominance of function %s:\n", f_->get_name().c_str());
+    for (auto bb : f_->get_basic_blocks()) {
+        auto ipdom = get_ipdom(bb);
+        printf("%s: %s\n", bb->get_name().c_str(), ipdom == nullptr ? "exit" : ipdom->get_name().c_str());
+    }
+}
@@ -0,0 +1,77 @@
+#include "RangeFolding.hpp"
+
+#include <vector>
+
+#include "BasicBlock.hpp"
+#include "Constant.hpp"
+#include "Function.hpp"
+#include "Instruction.hpp"
+#include "ValueRange.hpp"
+#include "logging.hpp"
+
+void RangeFolding::run()
+{
+    for (auto func : m_->get_functions())
+    {
+        if (func->is_declaration()) continue;
+        run_on_function(func);
+    }
+    LOG_INFO << "range folding: " << folded_values_ << " values, " << folded_branches_ << " branches folded";
+}
+
+void RangeFolding::run_on_function(Function* func)
+{
+    auto value_range = new ValueRangeAnalysis(func);
+    value_range->run();
+
+    // 先收集再替换，替换不影响已经求出的区间
+    std::vector<std::pair<Instruction*, Constant*>> replaces;
+    for (auto bb : func->get_basic_blocks())
+    {
+        for (auto inst : bb->get_instructions())
+        {
+            if (inst->get_use_list().empty()) continue;
+            auto range = value_range->get_range(inst);
+            if (range.is_empty() || !range.is_single()) continue;
+            Constant* c;
+            if (inst->get_type()->is_int1_type()) c = ConstantInt::get(range.lo_ != 0, m_);
+            else c = ConstantInt::get(static_cast<int>(range.lo_), m_);
+            replaces.emplace_back(inst, c);
+        }
+    }
+    delete value_range;
+    for (auto [inst, c] : replaces)
+    {
+        inst->replace_all_use_with(c);
+        folded_values_++;
+    }
+
+    // 条件为常量的跳转改为无条件跳转
+    for (auto bb : func->get_basic_blocks())
+    {
+        auto br = dynamic_cast<BranchInst*>(bb->get_terminator());
+        if (br == nullptr || !br->is_cond_br()) continue;
+        auto cond = dynamic_cast<ConstantInt*>(br->get_condition());
+        if (cond == nullptr) continue;
+        auto keep = br->get_operand(cond->get_value() != 0 ? 1 : 2)->as<BasicBlock>();
+        auto drop = br->get_operand(cond->get_value() != 0 ? 2 : 1)->as<BasicBlock>();
+        if (keep != drop)
+        {
+            for (auto inst : drop->get_instructions())
+            {
+                if (!inst->is_phi()) break;
+                for (int i = static_cast<int>(inst->get_num_operand()) - 1; i > 0; i -= 2)
+                {
+                    if (inst->get_operand(i) == bb)
+                    {
+                        inst->remove_operand(i);
+                        inst->remove_operand(i - 1);
+                    }
+                }
+            }
+        }
+        bb->erase_instr(br);
+        BranchInst::create_br(keep, bb);
+        folded_branches_++;
+    }
+}
@@ -0,0 +1,290 @@
+#include "Reassociate.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_set>
+
+#include "BasicBlock.hpp"
+#include "Constant.hpp"
+#include "Function.hpp"
+#include "Instruction.hpp"
+#include "LoopDetection.hpp"
+
+void Reassociate::run()
+{
+    for (auto func : m_->get_functions())
+    {
+        if (func->is_declaration()) continue;
+        run_on_function(func);
+    }
+}
+
+Instruction* Reassociate::create_before(Instruction::OpID op, Value* lhs, Value* rhs, Instruction* pos)
+{
+    auto bb = pos->get_parent();
+    auto& insts = bb->get_instructions();
+    auto terminator = insts.back();
+    insts.pop_back();
+    Instruction* inst = nullptr;
+    switch (op)
+    {
+        case Instruction::add: inst = IBinaryInst::create_add(lhs, rhs, bb); break;
+        case Instruction::sub: inst = IBinaryInst::create_sub(lhs, rhs, bb); break;
+        case Instruction::mul: inst = IBinaryInst::create_mul(lhs, rhs, bb); break;
+        case Instruction::fadd: inst = FBinaryInst::create_fadd(lhs, rhs, bb); break;
+        case Instruction::fsub: inst = FBinaryInst::create_fsub(lhs, rhs, bb); break;
+        case Instruction::fmul: inst = FBinaryInst::create_fmul(lhs, rhs, bb); break;
+        default: assert(false && "not a reassociable operator");
+    }
+    insts.pop_back();
+    insts.push_back(terminator);
+    insts.insert(std::find(insts.begin(), insts.end(), pos), inst);
+    // 新指令与 pos 同秩
+    rank_[inst] = rank_.at(pos);
+    return inst;
+}
+
+void Reassociate::run_on_function(Function* func)
+{
+    // 循环深度
+    std::unordered_map<BasicBlock*, long long> depth;
+    auto loop_detection = new LoopDetection(func);
+    loop_detection->run();
+    for (auto loop : loop_detection->get_loops())
+    {
+        for (auto bb : loop->get_blocks()) depth[bb]++;
+    }
+    delete loop_detection;
+
+    // 逆后序
+    std::vector<BasicBlock*> post_order;
+    std::unordered_set<BasicBlock*> visited;
+    std::vector<std::pair<BasicBlock*, std::list<BasicBlock*>::iterator>> stack;
+    visited.emplace(func->get_entry_block());
+    stack.emplace_back(func->get_entry_block(), func->get_entry_block()->get_succ_basic_blocks().begin());
+    while (!stack.empty())
+    {
+        auto& [bb, it] = stack.back();
+        if (it == bb->get_succ_basic_blocks().end())
+        {
+            post_order.emplace_back(bb);
+            stack.pop_back();
+            continue;
+        }
+        auto succ = *it++;
+        if (visited.emplace(succ).second) stack.emplace_back(succ, succ->get_succ_basic_blocks().begin());
+    }
+    std::vector<BasicBlock*> rpo(post_order.rbegin(), post_order.rend());
+
+    rank_.clear();
+    std::vector<Instruction*> insts;
+    long long bb_index = 0;
+    for (auto bb : rpo)
+    {
+        bb_index++;
+        long long inst_index = 0;
+        for (auto inst : bb->get_instructions())
+        {
+            rank_[inst] = (depth[bb] << 40) + (bb_index << 20) + inst_index++;
+            insts.emplace_back(inst);
+        }
+    }
+
+    for (auto inst : insts)
+    {
+        if (inst->get_use_list().empty() || !is_root(inst)) continue;
+        bool is_add = is_add_family(inst);
+        bool is_float = inst->get_type()->is_float_type();
+        std::vector<Operand> ops;
+        int nodes = linearize(inst, 1, ops);
+        // 单个节点只在可以提取公因子时改写
+        if (nodes < 2 && !(is_add && factor(ops, inst, is_float))) continue;
+        auto val = is_add ? build_add(ops, inst, is_float) : build_mul(ops, inst, is_float);
+        if (val != nullptr) inst->replace_all_use_with(val);
+    }
+}
+
+long long Reassociate::get_rank(Value* val) const
+{
+    if (dynamic_cast<Constant*>(val) != nullptr) return 0;
+    if (auto arg = dynamic_cast<Argument*>(val)) return 1 + arg->get_arg_no();
+    auto it = rank_.find(val);
+    return it == rank_.end() ? 1 : it->second;
+}
+
+bool Reassociate::is_add_family(const Value* val) const
+{
+    auto inst = dynamic_cast<const Instruction*>(val);
+    if (inst == nullptr) return false;
+    if (inst->is_add() || inst->is_sub()) return true;
+    return fast_math_ && (inst->is_fadd() || inst->is_fsub());
+}
+
+bool Reassociate::is_mul_family(const Value* val) const
+{
+    auto inst = dynamic_cast<const Instruction*>(val);
+    if (inst == nullptr) return false;
+    return inst->is_mul() || (fast_math_ && inst->is_fmul());
+}
+
+bool Reassociate::is_root(Instruction* inst) const
+{
+    bool is_add = is_add_family(inst);
+    if (!is_add && !is_mul_family(inst)) return false;
+    auto& uses = inst->get_use_list();
+    if (uses.size() != 1) return true;
+    auto user = dynamic_cast<Instruction*>(uses.front().val_);
+    if (user == nullptr || user->get_parent() != inst->get_parent()) return true;
+    return is_add ? !is_add_family(user) : !is_mul_family(user);
+}
+
+int Reassociate::linearize(Instruction* inst, int sign, std::vector<Operand>& ops) const
+{
+    bool is_add = is_add_family(inst);
+    int nodes = 1;
+    for (unsigned i = 0; i < 2; i++)
+    {
+        auto val = inst->get_operand(i);
+        int val_sign = (inst->is_sub() || inst->is_fsub()) && i == 1 ? -sign : sign;
+        auto child = dynamic_cast<Instruction*>(val);
+        bool same_family = is_add ? is_add_family(child) : is_mul_family(child);
+        if (same_family && child->get_parent() == inst->get_parent() && child->get_use_list().size() == 1)
+            nodes += linearize(child, val_sign, ops);
+        else ops.push_back({ val, val_sign });
+    }
+    return nodes;
+}
+
+bool Reassociate::factor(std::vector<Operand>& ops, Instruction* pos, bool is_float)
+{
+    // 公因子 -> 含有它的乘法叶子
+    std::vector<std::pair<Value*, std::vector<int>>> factors;
+    auto add_factor = [&](Value* val, int idx) {
+        for (auto& [f, idxs] : factors)
+        {
+            if (f == val)
+            {
+                idxs.emplace_back(idx);
+                return;
+            }
+        }
+        factors.push_back({ val, { idx } });
+    };
+    for (int i = 0; i < static_cast<int>(ops.size()); i++)
+    {
+        auto mul = dynamic_cast<Instruction*>(ops[i].val_);
+        if (!is_mul_family(mul) || mul->get_parent() != pos->get_parent() || mul->get_use_list().size() != 1) continue;
+        add_factor(mul->get_operand(0), i);
+        if (mul->get_operand(1) != mul->get_operand(0)) add_factor(mul->get_operand(1), i);
+    }
+    Value* common = nullptr;
+    std::vector<int> group;
+    for (auto& [f, idxs] : factors)
+    {
+        if (idxs.size() >= 2 && idxs.size() > group.size())
+        {
+            common = f;
+            group = idxs;
+        }
+    }
+    if (common == nullptr) return false;
+
+    // a*f + b*f - c*f 变为 (a + b - c)*f
+    std::vector<Operand> inner;
+    std::vector<Operand> rest;
+    for (int i = 0; i < static_cast<int>(ops.size()); i++)
+    {
+        if (std::find(group.begin(), group.end(), i) == group.end())
+        {
+            rest.emplace_back(ops[i]);
+            continue;
+        }
+        auto mul = ops[i].val_->as<Instruction>();
+        auto other = mul->get_operand(0) == common ? mul->get_operand(1) : mul->get_operand(0);
+        inner.push_back({ other, ops[i].sign_ });
+    }
+    auto sum = build_add(inner, pos, is_float);
+    if (sum == nullptr) return false;
+    auto product = create_before(is_float ? Instruction::fmul : Instruction::mul, sum, common, pos);
+    rest.push_back({ product, 1 });
+    ops = std::move(rest);
+    return true;
+}
+
+Value* Reassociate::build_add(std::vector<Operand> ops, Instruction* pos, bool is_float)
+{
+    while (factor(ops, pos, is_float)) {}
+
+    auto m = pos->get_module();
+    // 合并常量
+    unsigned int_sum = 0;
+    float float_sum = 0;
+    std::vector<Operand> others;
+    for (auto& op : ops)
+    {
+        if (auto c = dynamic_cast<ConstantInt*>(op.val_))
+            int_sum += op.sign_ * static_cast<unsigned>(c->get_value());
+        else if (auto c = dynamic_cast<ConstantFP*>(op.val_))
+            float_sum += static_cast<float>(op.sign_) * c->get_value();
+        else others.emplace_back(op);
+    }
+    // 负零和 NaN 在常量池中无法区分
+    if (std::isnan(float_sum)) return nullptr;
+    if (float_sum == 0) float_sum = 0;
+    Constant* sum = is_float ? static_cast<Constant*>(ConstantFP::get(float_sum, m))
+                             : static_cast<Constant*>(ConstantInt::get(static_cast<int>(int_sum), m));
+    bool sum_is_zero = is_float ? float_sum == 0 : int_sum == 0;
+    if (others.empty()) return sum;
+
+    std::stable_sort(others.begin(), others.end(),
+                     [this](const Operand& a, const Operand& b) { return get_rank(a.val_) < get_rank(b.val_); });
+    auto add_op = is_float ? Instruction::fadd : Instruction::add;
+    auto sub_op = is_float ? Instruction::fsub : Instruction::sub;
+    // 常量紧跟在秩最小的操作数之后，与其它循环不变量一起被结合
+    Value* acc;
+    if (others[0].sign_ > 0)
+    {
+        acc = others[0].val_;
+        if (!sum_is_zero) acc = create_before(add_op, acc, sum, pos);
+    }
+    else acc = create_before(sub_op, sum, others[0].val_, pos);
+    for (unsigned i = 1; i < others.size(); i++)
+    {
+        acc = create_before(others[i].sign_ > 0 ? add_op : sub_op, acc, others[i].val_, pos);
+    }
+    return acc;
+}
+
+Value* Reassociate::build_mul(std::vector<Operand> ops, Instruction* pos, bool is_float)
+{
+    auto m = pos->get_module();
+    unsigned int_product = 1;
+    float float_product = 1;
+    std::vector<Operand> others;
+    for (auto& op : ops)
+    {
+        if (auto c = dynamic_cast<ConstantInt*>(op.val_))
+            int_product *= static_cast<unsigned>(c->get_value());
+        else if (auto c = dynamic_cast<ConstantFP*>(op.val_))
+            float_product *= c->get_value();
+        else others.emplace_back(op);
+    }
+    if (std::isnan(float_product)) return nullptr;
+    if (float_product == 0) float_product = 0;
+    Constant* product = is_float ? static_cast<Constant*>(ConstantFP::get(float_product, m))
+                                 : static_cast<Constant*>(ConstantInt::get(static_cast<int>(int_product), m));
+    bool product_is_zero = is_float ? float_product == 0 : int_product == 0;
+    bool product_is_one = is_float ? float_product == 1 : int_product == 1;
+    if (others.empty() || product_is_zero) return product;
+
+    std::stable_sort(others.begin(), others.end(),
+                     [this](const Operand& a, const Operand& b) { return get_rank(a.val_) < get_rank(b.val_); });
+    auto mul_op = is_float ? Instruction::fmul : Instruction::mul;
+    Value* acc = others[0].val_;
+    if (!product_is_one) acc = create_before(mul_op, acc, product, pos);
+    for (unsigned i = 1; i < others.size(); i++)
+    {
+        acc = create_before(mul_op, acc, others[i].val_, pos);
+    }
+    return acc;
+}
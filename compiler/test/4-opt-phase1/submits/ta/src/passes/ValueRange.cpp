@@ -0,0 +1,314 @@
+#include "ValueRange.hpp"
+
+#include <algorithm>
+#include <unordered_set>
+
+#include "BasicBlock.hpp"
+#include "Constant.hpp"
+#include "Dominators.hpp"
+#include "Function.hpp"
+#include "LoopDetection.hpp"
+
+ValueRange ValueRange::unite(const ValueRange& other) const
+{
+    if (is_empty()) return other;
+    if (other.is_empty()) return *this;
+    return { std::min(lo_, other.lo_), std::max(hi_, other.hi_) };
+}
+
+ValueRange ValueRange::intersect(const ValueRange& other) const
+{
+    if (is_empty() || other.is_empty()) return empty();
+    return { std::max(lo_, other.lo_), std::min(hi_, other.hi_) };
+}
+
+// 比较结果可能的大小关系：第 0 位为小于，第 1 位为等于，第 2 位为大于
+static int cmp_mask(Instruction::OpID op)
+{
+    switch (op)
+    {
+        case Instruction::lt: return 1;
+        case Instruction::eq: return 2;
+        case Instruction::le: return 3;
+        case Instruction::gt: return 4;
+        case Instruction::ne: return 5;
+        case Instruction::ge: return 6;
+        default: assert(false && "not an integer compare"); return 0;
+    }
+}
+
+// 交换两个操作数后大小关系中的小于和大于互换
+static int swap_mask(int mask)
+{
+    return (mask & 2) | ((mask & 1) << 2) | ((mask & 4) >> 2);
+}
+
+static bool is_tracked(const Value* val)
+{
+    return val->get_type()->is_int32_type() || val->get_type()->is_int1_type();
+}
+
+// 区间运算结果超出 32 位时会回绕，此时只能取全集
+static ValueRange clamp(long long lo, long long hi)
+{
+    if (lo < INT_MIN || hi > INT_MAX) return { INT_MIN, INT_MAX };
+    return { lo, hi };
+}
+
+static ValueRange divide(const ValueRange& a, const ValueRange& b)
+{
+    ValueRange result = ValueRange::empty();
+    // 除数为 0 是未定义行为，按符号把除数分成两段，每段上商对两个操作数都单调
+    for (auto part : { ValueRange{ b.lo_, -1 }, ValueRange{ 1, b.hi_ } })
+    {
+        part = part.intersect(b);
+        if (part.is_empty()) continue;
+        // INT_MIN / -1 溢出
+        if (a.contains(INT_MIN) && part.contains(-1)) return { INT_MIN, INT_MAX };
+        long long lo = LLONG_MAX, hi = LLONG_MIN;
+        for (auto x : { a.lo_, a.hi_ })
+        {
+            for (auto y : { part.lo_, part.hi_ })
+            {
+                lo = std::min(lo, x / y);
+                hi = std::max(hi, x / y);
+            }
+        }
+        result = result.unite({ lo, hi });
+    }
+    return result;
+}
+
+void ValueRangeAnalysis::run()
+{
+    ranges_.clear();
+    facts_.clear();
+    auto dominators = new Dominators(f_);
+    dominators->run();
+    compute_facts(dominators);
+
+    std::unordered_set<BasicBlock*> headers;
+    auto loop_detection = new LoopDetection(f_);
+    loop_detection->run();
+    for (auto loop : loop_detection->get_loops()) headers.emplace(loop->get_header());
+    delete loop_detection;
+
+    // 支配树先序中定义先于（phi 以外的）使用
+    auto& order = dominators->get_dom_dfs_order();
+    std::unordered_map<Instruction*, int> grow_count;
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (auto bb : order)
+        {
+            for (auto inst : bb->get_instructions())
+            {
+                if (!is_tracked(inst)) continue;
+                auto& old = ranges_.emplace(inst, ValueRange::empty()).first->second;
+                auto range = old.unite(evaluate(inst, facts_[bb]));
+                if (range == old) continue;
+                if (inst->is_phi() && headers.count(bb) && !old.is_empty() && ++grow_count[inst] > WIDEN_THRESHOLD)
+                {
+                    auto full = ValueRange::full(inst->get_type());
+                    if (range.lo_ < old.lo_) range.lo_ = full.lo_;
+                    if (range.hi_ > old.hi_) range.hi_ = full.hi_;
+                }
+                old = range;
+                changed = true;
+            }
+        }
+    }
+
+    // 从不动点出发重新求值只会使区间变小，且结果仍然正确
+    for (int round = 0; round < NARROW_ROUNDS; round++)
+    {
+        for (auto bb : order)
+        {
+            for (auto inst : bb->get_instructions())
+            {
+                if (is_tracked(inst)) ranges_[inst] = evaluate(inst, facts_[bb]);
+            }
+        }
+    }
+    delete dominators;
+}
+
+ValueRange ValueRangeAnalysis::get_range(Value* val) const
+{
+    if (auto c = dynamic_cast<ConstantInt*>(val)) return ValueRange::single(c->get_value());
+    if (!is_tracked(val)) return ValueRange::empty();
+    if (dynamic_cast<Instruction*>(val) == nullptr) return ValueRange::full(val->get_type());
+    auto it = ranges_.find(val);
+    return it == ranges_.end() ? ValueRange::empty() : it->second;
+}
+
+void ValueRangeAnalysis::collect_facts(Value* cond, bool truth, std::vector<Fact>& facts)
+{
+    auto cmp = dynamic_cast<ICmpInst*>(cond);
+    if (cmp == nullptr) return;
+    facts.push_back({ cmp, truth });
+    // 前端把比较结果 zext 后再与 0 比较
+    auto zero = dynamic_cast<ConstantInt*>(cmp->get_operand(1));
+    auto zext = dynamic_cast<ZextInst*>(cmp->get_operand(0));
+    if (zero == nullptr || zero->get_value() != 0 || zext == nullptr) return;
+    if (cmp->get_instr_type() == Instruction::ne) collect_facts(zext->get_operand(0), truth, facts);
+    else if (cmp->get_instr_type() == Instruction::eq) collect_facts(zext->get_operand(0), !truth, facts);
+}
+
+void ValueRangeAnalysis::edge_facts(BasicBlock* pre, BasicBlock* succ, std::vector<Fact>& facts)
+{
+    auto br = dynamic_cast<BranchInst*>(pre->get_terminator());
+    if (br == nullptr || !br->is_cond_br() || br->get_operand(1) == br->get_operand(2)) return;
+    collect_facts(br->get_condition(), br->get_operand(1) == succ, facts);
+}
+
+void ValueRangeAnalysis::compute_facts(Dominators* dominators)
+{
+    for (auto bb : dominators->get_dom_dfs_order())
+    {
+        auto& facts = facts_[bb];
+        auto idom = dominators->get_idom(bb);
+        if (idom == nullptr || idom == bb) continue;
+        facts = facts_[idom];
+        // 只有一个前驱时该边支配 bb
+        if (bb->get_pre_basic_blocks().size() == 1) edge_facts(bb->get_pre_basic_blocks().front(), bb, facts);
+    }
+}
+
+ValueRange ValueRangeAnalysis::range_under(Value* val, const std::vector<Fact>& facts) const
+{
+    auto range = get_range(val);
+    for (auto [cmp, truth] : facts)
+    {
+        if (range.is_empty()) break;
+        int mask;
+        Value* other;
+        if (cmp->get_operand(0) == val)
+        {
+            mask = cmp_mask(cmp->get_instr_type());
+            other = cmp->get_operand(1);
+        }
+        else if (cmp->get_operand(1) == val)
+        {
+            mask = swap_mask(cmp_mask(cmp->get_instr_type()));
+            other = cmp->get_operand(0);
+        }
+        else continue;
+        if (!truth) mask ^= 7;
+        auto bound = get_range(other);
+        if (bound.is_empty()) continue;
+        // val 与 other 满足 mask 中的某一种大小关系
+        ValueRange allowed = ValueRange::empty();
+        if (mask & 1) allowed = allowed.unite({ LLONG_MIN, bound.hi_ - 1 });
+        if (mask & 2) allowed = allowed.unite(bound);
+        if (mask & 4) allowed = allowed.unite({ bound.lo_ + 1, LLONG_MAX });
+        // 不等于单点时去掉恰好在端点上的值
+        if (mask == 5 && bound.is_single())
+        {
+            if (range.lo_ == bound.lo_) range.lo_++;
+            if (range.hi_ == bound.hi_) range.hi_--;
+            continue;
+        }
+        range = range.intersect(allowed);
+    }
+    return range;
+}
+
+ValueRange ValueRangeAnalysis::evaluate_cmp(Instruction* inst, const std::vector<Fact>& facts) const
+{
+    auto lhs = inst->get_operand(0);
+    auto rhs = inst->get_operand(1);
+    auto a = range_under(lhs, facts);
+    auto b = range_under(rhs, facts);
+    if (a.is_empty() || b.is_empty()) return ValueRange::empty();
+    // 可能的大小关系
+    int possible = 0;
+    if (a.lo_ < b.hi_) possible |= 1;
+    if (!a.intersect(b).is_empty()) possible |= 2;
+    if (a.hi_ > b.lo_) possible |= 4;
+    if (lhs == rhs) possible &= 2;
+    // 同一对操作数上已经成立的比较
+    for (auto [cmp, truth] : facts)
+    {
+        int mask;
+        if (cmp->get_operand(0) == lhs && cmp->get_operand(1) == rhs) mask = cmp_mask(cmp->get_instr_type());
+        else if (cmp->get_operand(0) == rhs && cmp->get_operand(1) == lhs)
+            mask = swap_mask(cmp_mask(cmp->get_instr_type()));
+        else continue;
+        possible &= truth ? mask : mask ^ 7;
+    }
+    if (possible == 0) return ValueRange::empty();
+    int mask = cmp_mask(inst->get_instr_type());
+    if ((possible & mask) == possible) return ValueRange::single(1);
+    if ((possible & mask) == 0) return ValueRange::single(0);
+    return { 0, 1 };
+}
+
+ValueRange ValueRangeAnalysis::evaluate_phi(PhiInst* phi) const
+{
+    auto bb = phi->get_parent();
+    ValueRange range = ValueRange::empty();
+    for (auto [val, pre] : phi->get_phi_pairs())
+    {
+        auto facts = facts_.at(pre);
+        edge_facts(pre, bb, facts);
+        range = range.unite(range_under(val, facts));
+    }
+    return range;
+}
+
+ValueRange ValueRangeAnalysis::evaluate(Instruction* inst, const std::vector<Fact>& facts) const
+{
+    auto full = ValueRange::full(inst->get_type());
+    switch (inst->get_instr_type())
+    {
+        case Instruction::add:
+        case Instruction::sub:
+        case Instruction::mul:
+        case Instruction::sdiv:
+        {
+            auto a = range_under(inst->get_operand(0), facts);
+            auto b = range_under(inst->get_operand(1), facts);
+            if (a.is_empty() || b.is_empty()) return ValueRange::empty();
+            if (inst->is_add()) return clamp(a.lo_ + b.lo_, a.hi_ + b.hi_);
+            if (inst->is_sub()) return clamp(a.lo_ - b.hi_, a.hi_ - b.lo_);
+            if (inst->is_div()) return divide(a, b);
+            // 平方非负
+            if (inst->get_operand(0) == inst->get_operand(1))
+            {
+                long long lo = a.contains(0) ? 0 : std::min(a.lo_ * a.lo_, a.hi_ * a.hi_);
+                return clamp(lo, std::max(a.lo_ * a.lo_, a.hi_ * a.hi_));
+            }
+            // |端点| 不超过 2^31，乘积不会超出 long long
+            long long products[] = { a.lo_ * b.lo_, a.lo_ * b.hi_, a.hi_ * b.lo_, a.hi_ * b.hi_ };
+            return clamp(*std::min_element(std::begin(products), std::end(products)),
+                         *std::max_element(std::begin(products), std::end(products)));
+        }
+        case Instruction::ge:
+        case Instruction::gt:
+        case Instruction::le:
+        case Instruction::lt:
+        case Instruction::eq:
+        case Instruction::ne:
+            return evaluate_cmp(inst, facts);
+        case Instruction::zext:
+        {
+            auto range = range_under(inst->get_operand(0), facts);
+            return range.intersect(ValueRange::full(inst->get_operand(0)->get_type()));
+        }
+        case Instruction::select:
+        {
+            auto cond = range_under(inst->get_operand(0), facts);
+            if (cond.is_empty()) return ValueRange::empty();
+            auto range = ValueRange::empty();
+            if (cond.contains(1)) range = range.unite(range_under(inst->get_operand(1), facts));
+            if (cond.contains(0)) range = range.unite(range_under(inst->get_operand(2), facts));
+            return range;
+        }
+        case Instruction::phi:
+            return evaluate_phi(inst->as<PhiInst>());
+        default:
+            return full;
+    }
+}
@@ -0,0 +1,14 @@
+# 比较 -print-memssa 的输出与期望的结果
+# 用法：cmake -DCMINUSFC=<cminusfc> -DINPUT=<x.cminus> -DEXPECTED=<x.memssa> -DOUTPUT=<x.ll> -P check_memssa.cmake
+execute_process(
+    COMMAND ${CMINUSFC} -emit-llvm -mem2reg -print-memssa ${INPUT} -o ${OUTPUT}
+    RESULT_VARIABLE result
+    ERROR_VARIABLE dump
+)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "cminusfc failed on ${INPUT}")
+endif()
+file(READ ${EXPECTED} expected)
+if(NOT dump STREQUAL expected)
+    message(FATAL_ERROR "MemorySSA of ${INPUT} differs from ${EXPECTED}:\n${dump}")
+endif()
@@ -0,0 +1,200 @@
+// 由 CodeGen::gen_div_by_const 生成除以常量的指令序列，在主机上按龙芯的语义逐条执行，检查结果与 div.w 一致
+//
+// 用法：div_magic_test [--exhaustive] [除数...]
+// 默认检查一组常用除数，被除数取边界附近、除数倍数附近和伪随机的值；--exhaustive 时穷举所有 32 位被除数
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "CodeGen.hpp"
+#include "CodeGenUtil.hpp"
+#include "MachineIR.hpp"
+
+using Op = MachineInstr::Opcode;
+
+namespace
+{
+// 预先解码的指令，寄存器为编号
+struct Decoded
+{
+    Op op;
+    unsigned rd;
+    unsigned rj;
+    unsigned rk;
+    int64_t imm;
+};
+
+int64_t sext32(uint64_t x) { return static_cast<int32_t>(static_cast<uint32_t>(x)); }
+
+bool decode(MachineInstr* instr, Decoded& out)
+{
+    auto& ops = instr->get_operands();
+    out = {instr->get_opcode(), ops.at(0).get_reg().id, 0, 0, 0};
+    switch (instr->get_opcode())
+    {
+        case Op::ADD_W:
+        case Op::SUB_W:
+        case Op::MULH_W:
+            out.rj = ops.at(1).get_reg().id;
+            out.rk = ops.at(2).get_reg().id;
+            return true;
+        case Op::ADDI_W:
+        case Op::ORI:
+        case Op::SRAI_W:
+        case Op::SRLI_W:
+            out.rj = ops.at(1).get_reg().id;
+            out.imm = ops.at(2).get_imm();
+            return true;
+        case Op::LU12I_W:
+            out.imm = ops.at(1).get_imm();
+            return true;
+        default:
+            return false;
+    }
+}
+
+// 被除数在 $t0 中，返回 $t2 的低 32 位
+int32_t execute(const std::vector<Decoded>& code, int32_t n)
+{
+    int64_t regs[32] = {};
+    regs[Reg::t(0).id] = n;
+    for (auto& inst : code)
+    {
+        int64_t rj = regs[inst.rj];
+        int64_t rk = regs[inst.rk];
+        int64_t val = 0;
+        switch (inst.op)
+        {
+            case Op::ADD_W: val = sext32(rj + rk); break;
+            case Op::SUB_W: val = sext32(rj - rk); break;
+            case Op::MULH_W: val = sext32(static_cast<uint64_t>((sext32(rj) * sext32(rk)) >> 32)); break;
+            case Op::ADDI_W: val = sext32(rj + inst.imm); break;
+            case Op::ORI: val = rj | (inst.imm & LOW_12_MASK); break;
+            case Op::SRAI_W: val = static_cast<int32_t>(rj) >> inst.imm; break;
+            case Op::SRLI_W: val = sext32(static_cast<uint32_t>(rj) >> inst.imm); break;
+            case Op::LU12I_W: val = sext32(static_cast<uint64_t>(inst.imm) << 12); break;
+            default: break;
+        }
+        if (inst.rd != 0) regs[inst.rd] = val;
+    }
+    return static_cast<int32_t>(regs[Reg::t(2).id]);
+}
+
+std::vector<int32_t> quick_dividends(int32_t d)
+{
+    std::vector<int32_t> ns;
+    for (int64_t n = -65536; n <= 65536; n++) ns.push_back(static_cast<int32_t>(n));
+    for (int64_t i = 0; i < 65536; i++)
+    {
+        ns.push_back(static_cast<int32_t>(INT32_MIN + i));
+        ns.push_back(static_cast<int32_t>(INT32_MAX - i));
+    }
+    // 除数的倍数附近，商在这里变化
+    int64_t ad = d < 0 ? -static_cast<int64_t>(d) : d;
+    for (int64_t q = -4096; q <= 4096; q++)
+    {
+        for (int64_t m : {q * ad, (INT32_MAX / ad + q) * ad, (INT32_MIN / ad - q) * ad})
+        {
+            for (int64_t delta = -1; delta <= 1; delta++)
+            {
+                if (m + delta >= INT32_MIN and m + delta <= INT32_MAX) ns.push_back(static_cast<int32_t>(m + delta));
+            }
+        }
+    }
+    uint32_t x = 2463534242u;
+    for (int i = 0; i < (1 << 20); i++)
+    {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        ns.push_back(static_cast<int32_t>(x));
+    }
+    return ns;
+}
+
+// 返回是否通过
+bool check_divisor(CodeGen& codegen, MachineFunction& func, int32_t d, bool exhaustive)
+{
+    auto* bb = MachineBasicBlock::create("div_" + std::to_string(d), &func);
+    bool use_mul = codegen.gen_div_by_const(bb, d);
+    std::vector<Decoded> code;
+    for (auto* instr : bb->get_instructions())
+    {
+        if (instr->is_comment()) continue;
+        Decoded inst{};
+        if (not decode(instr, inst))
+        {
+            std::printf("d = %d: unexpected instruction %s\n", d, instr->print().c_str());
+            return false;
+        }
+        code.push_back(inst);
+    }
+    // 代价按是否用了乘法统计，与 DIV_LOG2 的判断一致
+    bool expect_mul = d != 1 and d != -1 and DIV_LOG2(d) <= 0;
+    if (use_mul != expect_mul)
+    {
+        std::printf("d = %d: gen_div_by_const reports use_mul = %d\n", d, use_mul);
+        return false;
+    }
+
+    auto check = [&](int32_t n) {
+        // INT32_MIN / -1 溢出，div.w 的结果没有定义
+        if (n == INT32_MIN and d == -1) return true;
+        auto got = execute(code, n);
+        if (got == n / d) return true;
+        std::printf("FAIL: %d / %d = %d, got %d\n", n, d, n / d, got);
+        return false;
+    };
+    bool ok = true;
+    if (exhaustive)
+    {
+        for (int64_t n = INT32_MIN; n <= INT32_MAX and ok; n++) ok = check(static_cast<int32_t>(n));
+    }
+    else
+    {
+        for (auto n : quick_dividends(d))
+        {
+            if (not (ok = check(n))) break;
+        }
+    }
+    std::printf("d = %d: %zu instructions, %s\n", d, code.size(), ok ? "ok" : "failed");
+    return ok;
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    bool exhaustive = false;
+    std::vector<int32_t> divisors;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--exhaustive") == 0)
+            exhaustive = true;
+        else
+            divisors.push_back(static_cast<int32_t>(std::strtol(argv[i], nullptr, 0)));
+    }
+    if (divisors.empty())
+    {
+        divisors = {
+            1, -1, 2, -2, 3, -3, 4, 5, -5, 6, 7, -7, 8, 10, 11, 12, 13, 16, 25, 100, 125, 641, 1000,
+            -1000, 4096, 65536, 1 << 30, -(1 << 30), 1000000007, 2147483647, -2147483647,
+        };
+    }
+
+    Module module;
+    CodeGen codegen(&module);
+    MachineFunction func(nullptr);
+    int failures = 0;
+    for (auto d : divisors)
+    {
+        if (d == 0 or d == INT32_MIN)
+        {
+            std::printf("d = %d: not lowered by gen_div_by_const, skipped\n", d);
+            continue;
+        }
+        if (not check_divisor(codegen, func, d, exhaustive)) failures++;
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -3,6 +3,7 @@
 #include <complex>
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
@@ -31,6 +32,11 @@ static enum test_type : uint8_t
     debug, test
 } TYPE;
 
+static enum target : uint8_t
+{
+    loongarch64, x86_64, interp
+} TARGET;
+
 struct cmd_result
 {
     string out_str;
@@ -405,15 +411,37 @@ static void makeDir(const string& dirPath)
     }
 }
 
-static const char* ERR_LOG = R"(Usage: ./eval_lab4.sh [test-stage] [path-to-testcases] [type]
+static const char* ERR_LOG = R"(Usage: ./eval_lab4.sh [test-stage] [path-to-testcases] [type] [target]
 test-stage: 'raw' or 'licm' or 'mem2reg' or 'all'
 path-to-testcases: './testcases/functional-cases' or '../testcases_general' or 'self made cases'
 type: 'debug' or 'test', debug will output .ll file
+target: 'loongarch64' (default, runs under qemu-loongarch64) or 'x86_64' (runs natively)
+        or 'interp' (runs the IR with cminusfc -run, no external tools needed)
 )";
 
+// 编译、汇编链接和运行测例的命令，随目标平台变化
+static string cminusfc_cmd()
+{
+    return TARGET == x86_64 ? "cminusfc -S -target x86_64 " : "cminusfc -S ";
+}
+
+static string gcc_cmd()
+{
+    string debug_flag = TYPE == debug ? "-g " : "";
+    if (TARGET == x86_64) return "gcc " + debug_flag;
+    return "loongarch64-unknown-linux-gnu-gcc " + debug_flag + "-static ";
+}
+
+// interp 目标没有汇编和链接，直接解释执行源文件
+static string run_cmd(const string& exe_file, const string& flags, const string& cminus_file)
+{
+    if (TARGET == interp) return "cminusfc -run " + flags + cminus_file;
+    return TARGET == x86_64 ? exe_file : "qemu-loongarch64 " + exe_file;
+}
+
 static int parseCmd(int argc, char* argv[])
 {
-    if (argc != 4)
+    if (argc != 4 && argc != 5)
     {
         out(ERR_LOG, true);
         return -1;
@@ -464,6 +492,17 @@ static int parseCmd(int argc, char* argv[])
         out2(ERR_LOG);
         return -1;
     }
+    if (argc == 4 || std::strcmp(argv[4], "loongarch64") == 0)
+        TARGET = loongarch64;
+    else if (std::strcmp(argv[4], "x86_64") == 0)
+        TARGET = x86_64;
+    else if (std::strcmp(argv[4], "interp") == 0)
+        TARGET = interp;
+    else
+    {
+        out2(ERR_LOG);
+        return -1;
+    }
     return 0;
 }
 
@@ -517,28 +556,17 @@ static int allmain(int argc, char* argv[])
                 false);
             cout.flush();
             ost.flush();
-            auto cmd2 = runCommandMix("cminusfc -S " + arg + line + " -o " + asm_file);
-            out(cmd2.str, false);
-            if (cmd2.ret_val)
-            {
-                out2e("CE: cminusfc compiler .cminus error\n");
-                continue;
-            }
-            if (TYPE == debug)
+            cmd_result_mix cmd2;
+            if (TARGET != interp)
             {
-                cmd2 = runCommandMix(
-                    "loongarch64-unknown-linux-gnu-gcc -g -static " + asm_file + " " + io_c + " -o " + exe_file);
+                cmd2 = runCommandMix(cminusfc_cmd() + arg + line + " -o " + asm_file);
                 out(cmd2.str, false);
                 if (cmd2.ret_val)
                 {
-                    out2e("CE: gcc compiler .s error\n");
+                    out2e("CE: cminusfc compiler .cminus error\n");
                     continue;
                 }
-            }
-            else
-            {
-                cmd2 = runCommandMix(
-                    "loongarch64-unknown-linux-gnu-gcc -static " + asm_file + " " + io_c + " -o " + exe_file);
+                cmd2 = runCommandMix(gcc_cmd() + asm_file + " " + io_c + " -o " + exe_file);
                 out(cmd2.str, false);
                 if (cmd2.ret_val)
                 {
@@ -548,8 +576,8 @@ static int allmain(int argc, char* argv[])
             }
             cmd_result ret;
             if (filesystem::exists(in_file))
-                ret = runCommand("qemu-loongarch64 " + exe_file + " >" + out_file + " <" + in_file);
-            else ret = runCommand("qemu-loongarch64 " + exe_file + " >" + out_file);
+                ret = runCommand(run_cmd(exe_file, arg, line) + " >" + out_file + " <" + in_file);
+            else ret = runCommand(run_cmd(exe_file, arg, line) + " >" + out_file);
             auto o = readFile(out_file);
             writeFile(o + to_string(ret.ret_val) + "\n", out_file);
             writeFile(ret.err_str, eval_file);
@@ -628,28 +656,17 @@ int main(int argc, char* argv[])
             false);
         cout.flush();
         ost.flush();
-        auto cmd2 = runCommandMix("cminusfc -S " + flags + line + " -o " + asm_file);
-        out(cmd2.str, false);
-        if (cmd2.ret_val)
-        {
-            out2e("CE: cminusfc compiler .cminus error\n");
-            continue;
-        }
-        if (TYPE == debug)
+        cmd_result_mix cmd2;
+        if (TARGET != interp)
         {
-            cmd2 = runCommandMix(
-                "loongarch64-unknown-linux-gnu-gcc -g -static " + asm_file + " " + io_c + " -o " + exe_file);
+            cmd2 = runCommandMix(cminusfc_cmd() + flags + line + " -o " + asm_file);
             out(cmd2.str, false);
             if (cmd2.ret_val)
             {
-                out2e("CE: gcc compiler .s error\n");
+                out2e("CE: cminusfc compiler .cminus error\n");
                 continue;
             }
-        }
-        else
-        {
-            cmd2 = runCommandMix(
-                "loongarch64-unknown-linux-gnu-gcc -static " + asm_file + " " + io_c + " -o " + exe_file);
+            cmd2 = runCommandMix(gcc_cmd() + asm_file + " " + io_c + " -o " + exe_file);
             out(cmd2.str, false);
             if (cmd2.ret_val)
             {
@@ -659,8 +676,8 @@ int main(int argc, char* argv[])
         }
         cmd_result ret;
         if (filesystem::exists(in_file))
-            ret = runCommand("qemu-loongarch64 " + exe_file + " >" + out_file + " <" + in_file);
-        else ret = runCommand("qemu-loongarch64 " + exe_file + " >" + out_file);
+            ret = runCommand(run_cmd(exe_file, flags, line) + " >" + out_file + " <" + in_file);
+        else ret = runCommand(run_cmd(exe_file, flags, line) + " >" + out_file);
         auto o = readFile(out_file);
         writeFile(o + to_string(ret.ret_val) + "\n", out_file);
         writeFile(ret.err_str, eval_file);
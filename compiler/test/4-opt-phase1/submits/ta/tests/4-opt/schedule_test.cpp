@@ -0,0 +1,118 @@
+// 在手工构造的机器基本块上运行 InstrScheduler，比较流水线模型估计的周期数，并检查依赖没有被打破
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <list>
+
+#include "InstrScheduler.hpp"
+#include "MachineIR.hpp"
+
+using Op = MachineInstr::Opcode;
+
+static MachineOperand fi(int index) { return MachineOperand::create_frame_index(index); }
+static MachineOperand imm(int64_t val) { return MachineOperand::create_imm(val); }
+
+static int failures = 0;
+
+static void check(bool cond, const char* what)
+{
+    std::printf("%s: %s\n", what, cond ? "ok" : "FAIL");
+    if (not cond) failures++;
+}
+
+// 写 $t8 之后、读 $t8 之前没有引用栈帧对象的指令：布局时这些指令可能借用 $t8 计算地址
+static bool scratch_intact(MachineBasicBlock* bb)
+{
+    MachineOperand scratch = Reg::t(8);
+    bool pending = false;
+    for (auto* instr : bb->get_instructions())
+    {
+        if (instr->is_comment()) continue;
+        if (pending and instr->has_frame_index()) return false;
+        for (auto& use : instr->get_uses())
+        {
+            if (use == scratch) pending = false;
+        }
+        for (auto& def : instr->get_defs())
+        {
+            if (def == scratch) pending = true;
+        }
+    }
+    return true;
+}
+
+static long position(MachineBasicBlock* bb, MachineInstr* instr)
+{
+    auto& instrs = bb->get_instructions();
+    return std::distance(instrs.begin(), std::find(instrs.begin(), instrs.end(), instr));
+}
+
+int main()
+{
+    MachineFunction func(nullptr);
+    for (int i = 0; i < 9; i++) func.create_frame_object(4, 4);
+    auto* bb = MachineBasicBlock::create("bb", &func);
+
+    // 除法和浮点乘法的结果紧接着被存储
+    MachineInstr::create(Op::LD_W, {Reg::t(0), fi(0), imm(0)}, bb);
+    MachineInstr::create(Op::LD_W, {Reg::t(1), fi(1), imm(0)}, bb);
+    MachineInstr::create(Op::DIV_W, {Reg::t(2), Reg::t(0), Reg::t(1)}, bb);
+    auto* store_q = MachineInstr::create(Op::ST_W, {Reg::t(2), fi(2), imm(0)}, bb);
+    MachineInstr::create(Op::FLD_S, {FReg::ft(0), fi(3), imm(0)}, bb);
+    MachineInstr::create(Op::FLD_S, {FReg::ft(1), fi(4), imm(0)}, bb);
+    MachineInstr::create(Op::FMUL_S, {FReg::ft(2), FReg::ft(0), FReg::ft(1)}, bb);
+    MachineInstr::create(Op::FST_S, {FReg::ft(2), fi(5), imm(0)}, bb);
+    auto* load_q = MachineInstr::create(Op::LD_W, {Reg::t(3), fi(2), imm(0)}, bb);
+    MachineInstr::create(Op::ADDI_W, {Reg::t(3), Reg::t(3), imm(1)}, bb);
+    MachineInstr::create(Op::ST_W, {Reg::t(3), fi(6), imm(0)}, bb);
+    // fi#7 的地址被取出，经指针的存储之后读 fi#7 不能提前；fi#0 只能直接访问，读出后还要做乘法，应当提前
+    MachineInstr::create(Op::ADDI_D, {Reg::t(5), fi(7), imm(0)}, bb);
+    auto* ptr_store = MachineInstr::create(Op::ST_W, {Reg::t(6), Reg::t(5), imm(0)}, bb);
+    auto* load_aliased = MachineInstr::create(Op::LD_W, {Reg::t(7), fi(7), imm(0)}, bb);
+    auto* load_private = MachineInstr::create(Op::LD_W, {Reg::a(1), fi(0), imm(0)}, bb);
+    MachineInstr::create(Op::MUL_W, {Reg::a(2), Reg::a(1), Reg::a(1)}, bb);
+    MachineInstr::create(Op::ST_W, {Reg::a(2), fi(8), imm(0)}, bb);
+    auto* call = MachineInstr::create(Op::BL, {MachineOperand::create_symbol("output")}, bb);
+    auto* after_call = MachineInstr::create(Op::ADDI_W, {Reg::t(0), Reg::zero(), imm(0)}, bb);
+    auto* branch = MachineInstr::create(Op::B, {bb}, bb);
+
+    // s * 1.5 + x * 2.75：浮点常量经 $t8 装入，栈帧对象的读写不能插到 $t8 的写和读之间
+    auto* consts = MachineBasicBlock::create("consts", &func);
+    MachineInstr::create(Op::LU12I_W, {Reg::t(8), imm(261120)}, consts);
+    MachineInstr::create(Op::MOVGR2FR_W, {FReg::ft(1), Reg::t(8)}, consts);
+    MachineInstr::create(Op::FLD_S, {FReg::ft(0), fi(3), imm(0)}, consts);
+    MachineInstr::create(Op::FMUL_S, {FReg::ft(2), FReg::ft(0), FReg::ft(1)}, consts);
+    MachineInstr::create(Op::LU12I_W, {Reg::t(8), imm(262912)}, consts);
+    MachineInstr::create(Op::ORI, {Reg::t(8), Reg::t(8), imm(16)}, consts);
+    MachineInstr::create(Op::MOVGR2FR_W, {FReg::ft(4), Reg::t(8)}, consts);
+    MachineInstr::create(Op::FLD_S, {FReg::ft(3), fi(4), imm(0)}, consts);
+    MachineInstr::create(Op::FMUL_S, {FReg::ft(5), FReg::ft(3), FReg::ft(4)}, consts);
+    MachineInstr::create(Op::FADD_S, {FReg::ft(6), FReg::ft(2), FReg::ft(5)}, consts);
+    MachineInstr::create(Op::FST_S, {FReg::ft(6), fi(5), imm(0)}, consts);
+    MachineInstr::create(Op::LA_LOCAL, {Reg::t(8), MachineOperand::create_symbol(".LCF")}, consts);
+    MachineInstr::create(Op::FLD_S, {FReg::ft(7), Reg::t(8), imm(0)}, consts);
+    MachineInstr::create(Op::FLD_S, {FReg::ft(8), fi(6), imm(0)}, consts);
+    MachineInstr::create(Op::FADD_S, {FReg::ft(9), FReg::ft(7), FReg::ft(8)}, consts);
+    MachineInstr::create(Op::FST_S, {FReg::ft(9), fi(6), imm(0)}, consts);
+    auto consts_before = InstrScheduler::estimate_cycles(consts->get_instructions());
+
+    auto num_instrs = bb->get_instructions().size();
+    auto before = InstrScheduler::estimate_cycles(bb->get_instructions());
+    std::list<MachineFunction*> funcs{&func};
+    InstrScheduler(funcs).run();
+    auto after = InstrScheduler::estimate_cycles(bb->get_instructions());
+    auto consts_after = InstrScheduler::estimate_cycles(consts->get_instructions());
+
+    std::printf("estimated cycles: %u -> %u, %u -> %u\n", before, after, consts_before, consts_after);
+    check(after < before, "fewer cycles");
+    check(bb->get_instructions().size() == num_instrs, "same instructions");
+    check(position(bb, store_q) < position(bb, load_q), "load after store to the same slot");
+    check(position(bb, ptr_store) < position(bb, load_aliased), "address-taken slot after pointer store");
+    check(position(bb, load_private) < position(bb, ptr_store), "private slot moved above pointer store");
+    check(position(bb, load_private) < position(bb, call) and position(bb, call) < position(bb, after_call),
+          "call stays a barrier");
+    check(bb->get_instructions().back() == branch, "branch stays last");
+    check(consts_after < consts_before, "float constants scheduled");
+    check(scratch_intact(consts), "frame accesses stay out of $t8 live ranges");
+    return failures == 0 ? 0 : 1;
+}